@@ -0,0 +1,190 @@
+// benchmarks/pipeline_benchmark.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "image_utilities.h"
+#include "linear_light.h"
+#include "noise_layer.h"
+#include "png_encoder.h"
+#include "theme.h"
+
+namespace {
+
+    constexpr int kIterations = 9;
+    constexpr double kBlurRadius = 25.0;
+    const glass_surf::RGB_Tint kTint = { 200, 180, 255 };
+
+    // Runs `body` kIterations times and returns the median wall time in milliseconds
+    double MedianMilliseconds(const std::function<void()>& body) {
+        std::vector<double> samples;
+
+        for (int i = 0; i < kIterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto end = std::chrono::steady_clock::now();
+
+            samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    void Report(const std::string& name, const cv::Size& size, double milliseconds, double baseline) {
+        std::cout << std::left << std::setw(36) << name
+            << std::setw(12) << (std::to_string(size.width) + "x" + std::to_string(size.height))
+            << std::right << std::fixed << std::setprecision(2) << std::setw(10) << milliseconds << " ms"
+            << std::setw(8) << milliseconds / baseline << "x" << std::endl;
+    }
+
+    // Random noise smoothed a little, so the input looks more like a photo than white noise
+    cv::Mat SyntheticWallpaper(const cv::Size& size) {
+        cv::Mat wallpaper(size, CV_8UC3);
+        cv::RNG rng(0x6c617373);
+        rng.fill(wallpaper, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+
+        return glass_surf::GausianBlur(wallpaper, 2.0);
+    }
+
+    void BenchmarkLinearLight(const cv::Size& size) {
+        cv::Mat wallpaper = SyntheticWallpaper(size);
+
+        double srgb = MedianMilliseconds([&] {
+            cv::Mat tinted = glass_surf::ApplyTintBlend(wallpaper, kTint);
+            cv::Mat blurred = glass_surf::GausianBlur(tinted, kBlurRadius);
+        });
+
+        double linear = MedianMilliseconds([&] {
+            cv::Mat tinted = glass_surf::ApplyTintBlendLinear(glass_surf::ToLinearLight(wallpaper), kTint);
+            cv::Mat blurred = glass_surf::FromLinearLight(glass_surf::GausianBlur(tinted, kBlurRadius));
+        });
+
+        Report("tint+blur (8-bit sRGB)", size, srgb, srgb);
+        Report("tint+blur (16-bit linear light)", size, linear, srgb);
+    }
+
+    // Each theme's material after the current tint+blur path, and its kernel alone
+    void BenchmarkThemes(const cv::Size& size) {
+        cv::Mat wallpaper = SyntheticWallpaper(size);
+        cv::Mat tinted, blurred, themed;
+
+        double baseline = MedianMilliseconds([&] {
+            glass_surf::ApplyTintBlend(wallpaper, kTint, tinted);
+            glass_surf::GausianBlur(tinted, kBlurRadius, blurred);
+        });
+        Report("tint+blur", size, baseline, baseline);
+
+        const std::pair<glass_surf::Themes, std::string> themes[] = {
+            { glass_surf::Themes::ACRYLIC, "acrylic" },
+            { glass_surf::Themes::DARK, "dark" },
+            { glass_surf::Themes::LIGHT, "light" },
+        };
+
+        for (const auto& [theme, name] : themes) {
+            double kernel = MedianMilliseconds([&] {
+                glass_surf::ApplyTheme(blurred, theme, themed);
+            });
+            double total = MedianMilliseconds([&] {
+                glass_surf::ApplyTintBlend(wallpaper, kTint, tinted);
+                glass_surf::GausianBlur(tinted, kBlurRadius, blurred);
+                glass_surf::ApplyTheme(blurred, theme, blurred);
+            });
+
+            Report("theme " + name + " (kernel)", size, kernel, baseline);
+            Report("tint+blur+theme " + name, size, total, baseline);
+        }
+    }
+
+    // The grain composite on a blurred surface, per frame and per megapixel
+    void BenchmarkNoise(const cv::Size& size) {
+        cv::Mat surface = glass_surf::GausianBlur(SyntheticWallpaper(size), kBlurRadius);
+
+        glass_surf::NoiseLayer noise;
+        double prepare = MedianMilliseconds([&] {
+            noise = glass_surf::NoiseLayer();
+            noise.Prepare(1, glass_surf::GetThemePreset(glass_surf::Themes::ACRYLIC).noise_amplitude, size.width);
+        });
+
+        double composite = MedianMilliseconds([&] {
+            noise.Composite(surface);
+        });
+
+        double megapixels = size.area() / 1e6;
+        Report("noise tile + strips (once)", size, prepare, composite);
+        Report("noise composite", size, composite, composite);
+        std::cout << "  " << std::fixed << std::setprecision(3) << composite / megapixels << " ms per megapixel" << std::endl;
+    }
+
+    // A blurred surface crop is what /bg/ encodes; compares the stripe encoder with OpenCV
+    void BenchmarkPngEncode(const cv::Size& size) {
+        cv::Mat surface = glass_surf::GausianBlur(SyntheticWallpaper(size), kBlurRadius);
+
+        std::vector<uchar> opencv_png;
+        const std::vector<int> params = { cv::IMWRITE_PNG_COMPRESSION, 1 };
+        double imencode = MedianMilliseconds([&] {
+            cv::imencode(".png", surface, opencv_png, params);
+        });
+        Report("png (cv::imencode)", size, imencode, imencode);
+
+        std::string png;
+        auto sink = [&png](const uint8_t* data, size_t size) {
+            png.append(reinterpret_cast<const char*>(data), size);
+        };
+
+        for (int stripes = 1; stripes <= std::max(cv::getNumThreads(), 1); stripes *= 2) {
+            double striped = MedianMilliseconds([&] {
+                png.clear();
+                glass_surf::EncodePngStriped(surface, sink, 1, stripes);
+            });
+            Report("png (" + std::to_string(stripes) + " stripes)", size, striped, imencode);
+        }
+
+        std::cout << "  size: cv::imencode " << opencv_png.size() << " bytes, striped " << png.size()
+            << " bytes" << std::endl;
+    }
+
+} // namespace
+
+int main() {
+    const std::vector<cv::Size> resolutions = { cv::Size(1920, 1080), cv::Size(3840, 2160) };
+
+    std::cout << "Median of " << kIterations << " runs, relative to the 8-bit path" << std::endl;
+
+    for (const cv::Size& size : resolutions) {
+        BenchmarkLinearLight(size);
+    }
+
+    std::cout << std::endl << "Themes, relative to tint+blur" << std::endl;
+
+    for (const cv::Size& size : resolutions) {
+        BenchmarkThemes(size);
+    }
+
+    std::cout << std::endl << "Noise, relative to the composite" << std::endl;
+
+    for (const cv::Size& size : resolutions) {
+        BenchmarkNoise(size);
+    }
+
+    std::cout << std::endl << "PNG encode, relative to cv::imencode (" << cv::getNumThreads()
+        << " threads)" << std::endl;
+
+    for (const cv::Size& size : resolutions) {
+        BenchmarkPngEncode(size);
+    }
+
+    return 0;
+}
@@ -1 +1,4 @@
-conan install . --output-folder=build -s compiler.cppstd=17
\ No newline at end of file
+conan install . --output-folder=build -s compiler.cppstd=17 -s build_type=Release
+cmake -S . -B build -DCMAKE_TOOLCHAIN_FILE=build/conan_toolchain.cmake -DCMAKE_BUILD_TYPE=Release
+cmake --build build --config Release
+ctest --test-dir build -C Release --output-on-failure
@@ -0,0 +1,279 @@
+// allocation_counter.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "allocation_counter.h"
+
+#ifdef GLASSSURF_COUNT_ALLOCATIONS
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include <opencv2/opencv.hpp>
+
+namespace {
+
+    // Constant-initialized and trivially destructible, so usable from operator new on any thread
+    thread_local glass_surf::AllocationCounts thread_counts;
+
+    std::atomic<uint64_t> process_allocations{ 0 };
+    std::atomic<uint64_t> process_bytes{ 0 };
+    std::atomic<uint64_t> process_mat_allocations{ 0 };
+    std::atomic<uint64_t> process_mat_bytes{ 0 };
+
+    // Fixed storage, so recording a scope never allocates
+    constexpr size_t kMaxScopes = 64;
+
+    std::mutex scopes_mutex;
+    glass_surf::AllocationScopeStats scopes[kMaxScopes];
+    size_t scope_count = 0;
+
+    void CountAllocation(size_t size) {
+        ++thread_counts.allocations;
+        thread_counts.bytes += size;
+        process_allocations.fetch_add(1, std::memory_order_relaxed);
+        process_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void CountMatAllocation(size_t size) {
+        ++thread_counts.mat_allocations;
+        thread_counts.mat_bytes += size;
+        process_mat_allocations.fetch_add(1, std::memory_order_relaxed);
+        process_mat_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void* Allocate(size_t size) {
+        CountAllocation(size);
+        return std::malloc(size > 0 ? size : 1);
+    }
+
+    void* AllocateAligned(size_t size, std::align_val_t alignment) {
+        CountAllocation(size);
+
+        size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+        return _aligned_malloc(size > 0 ? size : 1, align);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        return std::aligned_alloc(align, std::max<size_t>((size + align - 1) / align * align, align));
+#endif
+    }
+
+    void FreeAligned(void* pointer) {
+#ifdef _WIN32
+        _aligned_free(pointer);
+#else
+        std::free(pointer);
+#endif
+    }
+
+    void RecordScope(const char* name, const glass_surf::AllocationCounts& counts) {
+        std::lock_guard<std::mutex> lock(scopes_mutex);
+
+        glass_surf::AllocationScopeStats* stats = nullptr;
+        for (size_t i = 0; i < scope_count; ++i) {
+            if (scopes[i].name == name || std::strcmp(scopes[i].name, name) == 0) {
+                stats = &scopes[i];
+                break;
+            }
+        }
+
+        if (!stats) {
+            if (scope_count == kMaxScopes) {
+                return;
+            }
+            stats = &scopes[scope_count++];
+            stats->name = name;
+        }
+
+        if (stats->calls == 0 || counts.total_allocations() > stats->max.total_allocations()) {
+            stats->max = counts;
+        }
+        ++stats->calls;
+        stats->last = counts;
+        stats->total.allocations += counts.allocations;
+        stats->total.bytes += counts.bytes;
+        stats->total.mat_allocations += counts.mat_allocations;
+        stats->total.mat_bytes += counts.mat_bytes;
+    }
+
+    // Counts Mat buffers and leaves the work to OpenCV's default allocator, which
+    // also becomes the buffers' allocator for deallocation
+    class CountingMatAllocator : public cv::MatAllocator {
+    public:
+        cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+            cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+            cv::UMatData* u = cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage);
+            if (u && !data) {
+                CountMatAllocation(u->size);
+            }
+            return u;
+        }
+
+        bool allocate(cv::UMatData* data, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+            return cv::Mat::getStdAllocator()->allocate(data, flags, usage);
+        }
+
+        void deallocate(cv::UMatData* data) const override {
+            cv::Mat::getStdAllocator()->deallocate(data);
+        }
+    };
+
+} // namespace
+
+bool glass_surf::AllocationCountingEnabled() {
+    return true;
+}
+
+void glass_surf::InstallMatAllocationHook() {
+    static CountingMatAllocator allocator;
+    cv::Mat::setDefaultAllocator(&allocator);
+}
+
+glass_surf::AllocationCounts glass_surf::ThreadAllocationCounts() {
+    return thread_counts;
+}
+
+glass_surf::AllocationCounts glass_surf::ProcessAllocationCounts() {
+    return AllocationCounts{ process_allocations.load(std::memory_order_relaxed), process_bytes.load(std::memory_order_relaxed),
+        process_mat_allocations.load(std::memory_order_relaxed), process_mat_bytes.load(std::memory_order_relaxed) };
+}
+
+std::vector<glass_surf::AllocationScopeStats> glass_surf::AllocationScopeSnapshot() {
+    std::lock_guard<std::mutex> lock(scopes_mutex);
+    return std::vector<AllocationScopeStats>(scopes, scopes + scope_count);
+}
+
+glass_surf::AllocationScope::AllocationScope(const char* name) : name_(name), start_(thread_counts) {}
+
+glass_surf::AllocationScope::~AllocationScope() {
+    if (name_) {
+        RecordScope(name_, counts());
+    }
+}
+
+glass_surf::AllocationCounts glass_surf::AllocationScope::counts() const {
+    return thread_counts - start_;
+}
+
+// Replacements of the global allocation functions, counting every form of new
+
+void* operator new(std::size_t size) {
+    void* pointer = Allocate(size);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    void* pointer = AllocateAligned(size, alignment);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    FreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    FreeAligned(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    FreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+    FreeAligned(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    FreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    FreeAligned(pointer);
+}
+
+#else
+
+bool glass_surf::AllocationCountingEnabled() {
+    return false;
+}
+
+void glass_surf::InstallMatAllocationHook() {}
+
+glass_surf::AllocationCounts glass_surf::ThreadAllocationCounts() {
+    return AllocationCounts();
+}
+
+glass_surf::AllocationCounts glass_surf::ProcessAllocationCounts() {
+    return AllocationCounts();
+}
+
+std::vector<glass_surf::AllocationScopeStats> glass_surf::AllocationScopeSnapshot() {
+    return std::vector<AllocationScopeStats>();
+}
+
+#endif // GLASSSURF_COUNT_ALLOCATIONS
@@ -0,0 +1,114 @@
+// allocation_counter.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace glass_surf {
+
+	/**
+	 * @brief Heap allocations through operator new, and cv::Mat buffers (which
+	 * OpenCV allocates with its own aligned malloc).
+	 */
+	struct AllocationCounts {
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+		uint64_t mat_allocations = 0;
+		uint64_t mat_bytes = 0;
+
+		uint64_t total_allocations() const { return allocations + mat_allocations; }
+
+		AllocationCounts operator-(const AllocationCounts& other) const {
+			return AllocationCounts{ allocations - other.allocations, bytes - other.bytes,
+				mat_allocations - other.mat_allocations, mat_bytes - other.mat_bytes };
+		}
+	};
+
+	/**
+	 * @brief Returns true if the build counts allocations (GLASSSURF_COUNT_ALLOCATIONS).
+	 *
+	 * Otherwise every count below stays zero and AllocationScope compiles to nothing.
+	 */
+	bool AllocationCountingEnabled();
+
+	/**
+	 * @brief Makes OpenCV allocate cv::Mat buffers through the counting allocator.
+	 *
+	 * Call once at startup, before any Mat is created. Does nothing unless counting is enabled.
+	 */
+	void InstallMatAllocationHook();
+
+	/**
+	 * @brief Allocations made by the calling thread so far.
+	 */
+	AllocationCounts ThreadAllocationCounts();
+
+	/**
+	 * @brief Allocations made by all threads so far.
+	 */
+	AllocationCounts ProcessAllocationCounts();
+
+	/**
+	 * @brief Accumulated counts of the AllocationScopes with a given name.
+	 */
+	struct AllocationScopeStats {
+		const char* name = nullptr;
+		uint64_t calls = 0;
+		AllocationCounts last;
+		AllocationCounts max; // Of the scope with the most allocations
+		AllocationCounts total;
+	};
+
+	/**
+	 * @brief Returns the stats of every named scope that has ended so far.
+	 */
+	std::vector<AllocationScopeStats> AllocationScopeSnapshot();
+
+	/**
+	 * @brief Counts the allocations the calling thread makes during its lifetime.
+	 *
+	 * Work a scope hands to other threads (OpenCV's parallel loops) is not
+	 * included. A named scope adds its counts to the AllocationScopeSnapshot when
+	 * it ends; recording them allocates nothing, and the name must be a string
+	 * literal. Scopes of the same name are expected to measure the same work,
+	 * e.g. one route or one pipeline stage.
+	 */
+#ifdef GLASSSURF_COUNT_ALLOCATIONS
+	class AllocationScope {
+	public:
+		explicit AllocationScope(const char* name = nullptr);
+		~AllocationScope();
+
+		AllocationScope(const AllocationScope&) = delete;
+		AllocationScope& operator=(const AllocationScope&) = delete;
+
+		/**
+		 * @brief Allocations of this thread since the scope started.
+		 */
+		AllocationCounts counts() const;
+
+	private:
+		const char* name_;
+		AllocationCounts start_;
+	};
+#else
+	class AllocationScope {
+	public:
+		explicit AllocationScope(const char* = nullptr) {}
+
+		AllocationScope(const AllocationScope&) = delete;
+		AllocationScope& operator=(const AllocationScope&) = delete;
+
+		AllocationCounts counts() const { return AllocationCounts(); }
+	};
+#endif
+
+} // namespace glass_surf
+
+#endif // !ALLOCATION_COUNTER_H_
@@ -6,6 +6,160 @@
 
 #include "arguments.h"
 
+#include <algorithm>
+#include <iostream>
+
+argparse::ArgumentParser& glass_surf::arguments::RenderCommand() {
+    // Subparsers are referenced by the parent parser, so this one lives for the whole program
+    static argparse::ArgumentParser render_command("render");
+    return render_command;
+}
+
+argparse::ArgumentParser& glass_surf::arguments::ReplayCommand() {
+    static argparse::ArgumentParser replay_command("replay");
+    return replay_command;
+}
+
+argparse::ArgumentParser& glass_surf::arguments::DaemonCommand() {
+    static argparse::ArgumentParser daemon_command("daemon");
+    return daemon_command;
+}
+
+argparse::ArgumentParser& glass_surf::arguments::AgentCommand() {
+    static argparse::ArgumentParser agent_command("agent");
+    return agent_command;
+}
+
 void glass_surf::arguments::RegistryArguments(argparse::ArgumentParser &argv_parser) {
     argv_parser.add_argument("-c", "--config").help("Path to config (SETTINGS) file");
+    argv_parser.add_argument("--record-trace")
+        .help("Record window geometry and request arrivals to this trace file")
+        .default_value(std::string(""));
+    argv_parser.add_argument("--pushed-geometry")
+        .help("Take the browser window geometry from /geometry/ requests (always the case outside Windows)")
+        .default_value(false)
+        .implicit_value(true);
+    argv_parser.add_argument("--trace-events")
+        .help("Record pipeline and request spans and write them to this file on exit (Chrome trace-event JSON)")
+        .default_value(std::string(""));
+    argv_parser.add_argument("--screen")
+        .help("Screen resolution as WIDTHxHEIGHT where it cannot be read from the desktop")
+        .default_value(std::string("1920x1080"));
+
+    argparse::ArgumentParser& render_command = RenderCommand();
+    render_command.add_description("Render processed wallpapers offline instead of starting the server");
+    render_command.add_argument("inputs")
+        .help("Wallpaper images, or directories of images")
+        .nargs(argparse::nargs_pattern::at_least_one);
+    render_command.add_argument("-r", "--resolution")
+        .help("Output resolutions as WIDTHxHEIGHT")
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .default_value(std::vector<std::string>{ "1920x1080" });
+    render_command.add_argument("-p", "--profile")
+        .help("Settings files to render with (default: the --config file)")
+        .nargs(argparse::nargs_pattern::at_least_one);
+    render_command.add_argument("-o", "--output")
+        .help("Output directory")
+        .default_value(std::string("rendered"));
+    render_command.add_argument("--report")
+        .help("Path of the CSV timing report (default: <output>/report.csv)")
+        .default_value(std::string(""));
+    render_command.add_argument("-j", "--jobs")
+        .help("Worker threads (default: one per hardware thread)")
+        .default_value(0)
+        .scan<'i', int>();
+
+    argv_parser.add_subparser(render_command);
+
+    argparse::ArgumentParser& replay_command = ReplayCommand();
+    replay_command.add_description("Replay a recorded geometry trace against a running server and report latencies");
+    replay_command.add_argument("trace")
+        .help("Trace file written with --record-trace");
+    replay_command.add_argument("--host")
+        .help("Address of the server")
+        .default_value(std::string("127.0.0.1"));
+    replay_command.add_argument("-n", "--connections")
+        .help("Concurrent request connections")
+        .default_value(4)
+        .scan<'i', int>();
+    replay_command.add_argument("-s", "--speed")
+        .help("Replay speed relative to the recording")
+        .default_value(1.0)
+        .scan<'g', double>();
+    replay_command.add_argument("--server-pid")
+        .help("Process ID of the server, to report its CPU time (Linux)")
+        .default_value(0)
+        .scan<'i', int>();
+
+    argv_parser.add_subparser(replay_command);
+
+    argparse::ArgumentParser& daemon_command = DaemonCommand();
+    daemon_command.add_description("Serve many user sessions from one process, sharing surfaces between identical configurations");
+    daemon_command.add_argument("--cache-entries")
+        .help("Encoded images kept per surface, for sessions whose windows differ")
+        .default_value(4)
+        .scan<'i', int>();
+    daemon_command.add_argument("--allow-root")
+        .help("Directory every session may take wallpapers and settings files from (sessions may always use their own files)")
+        .append()
+        .default_value(std::vector<std::string>{});
+
+    argv_parser.add_subparser(daemon_command);
+
+    argparse::ArgumentParser& agent_command = AgentCommand();
+    agent_command.add_description("Register this user's session with a running daemon and push its browser window geometry");
+    agent_command.add_argument("--host")
+        .help("Address of the daemon")
+        .default_value(std::string("127.0.0.1"));
+
+    argv_parser.add_subparser(agent_command);
+}
+
+bool glass_surf::arguments::ReadRenderOptions(const std::string& default_profile, BatchRenderOptions& options) {
+    const argparse::ArgumentParser& render_command = RenderCommand();
+
+    options.inputs = render_command.get<std::vector<std::string>>("inputs");
+
+    options.resolutions.clear();
+    for (const std::string& text : render_command.get<std::vector<std::string>>("--resolution")) {
+        cv::Size resolution;
+        if (!glass_surf::ParseResolution(text, resolution)) {
+            std::cerr << "[ERROR]: Invalid resolution " << text << ", expected WIDTHxHEIGHT" << std::endl;
+            return false;
+        }
+        options.resolutions.push_back(resolution);
+    }
+
+    options.profiles = render_command.is_used("--profile")
+        ? render_command.get<std::vector<std::string>>("--profile")
+        : std::vector<std::string>{ default_profile };
+
+    options.output_directory = render_command.get<std::string>("--output");
+    options.report_path = render_command.get<std::string>("--report");
+    options.jobs = static_cast<size_t>(std::max(render_command.get<int>("--jobs"), 0));
+
+    return true;
+}
+
+void glass_surf::arguments::ReadReplayOptions(TraceReplayOptions& options) {
+    const argparse::ArgumentParser& replay_command = ReplayCommand();
+
+    options.trace_path = replay_command.get<std::string>("trace");
+    options.host = replay_command.get<std::string>("--host");
+    options.connections = static_cast<size_t>(std::max(replay_command.get<int>("--connections"), 1));
+    options.speed = replay_command.get<double>("--speed");
+    options.server_pid = replay_command.get<int>("--server-pid");
+}
+
+void glass_surf::arguments::ReadDaemonOptions(SessionDaemonOptions& options) {
+    const argparse::ArgumentParser& daemon_command = DaemonCommand();
+
+    options.cache_entries = static_cast<size_t>(std::max(daemon_command.get<int>("--cache-entries"), 1));
+    options.allowed_roots = daemon_command.get<std::vector<std::string>>("--allow-root");
+}
+
+void glass_surf::arguments::ReadAgentOptions(SessionAgentOptions& options) {
+    const argparse::ArgumentParser& agent_command = AgentCommand();
+
+    options.host = agent_command.get<std::string>("--host");
 }
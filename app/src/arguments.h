@@ -9,9 +9,58 @@
 
 #include <argparse/argparse.hpp>
 
+#include "batch_render.h"
+#include "session_agent.h"
+#include "session_daemon.h"
+#include "trace_replay.h"
+
 namespace glass_surf::arguments {
         void RegistryArguments(argparse::ArgumentParser& argv_parser);
 
+        /**
+         * @brief The `render` subcommand, registered on the parser by RegistryArguments.
+         */
+        argparse::ArgumentParser& RenderCommand();
+
+        /**
+         * @brief Reads the options of a parsed `render` subcommand.
+         *
+         * @param default_profile Profile used when no --profile is given (the --config file).
+         * @param options Receives the options.
+         * @return False if a resolution is malformed.
+         */
+        bool ReadRenderOptions(const std::string& default_profile, BatchRenderOptions& options);
+
+        /**
+         * @brief The `replay` subcommand, registered on the parser by RegistryArguments.
+         */
+        argparse::ArgumentParser& ReplayCommand();
+
+        /**
+         * @brief Reads the options of a parsed `replay` subcommand; the ports are left to the caller.
+         */
+        void ReadReplayOptions(TraceReplayOptions& options);
+
+        /**
+         * @brief The `daemon` subcommand, registered on the parser by RegistryArguments.
+         */
+        argparse::ArgumentParser& DaemonCommand();
+
+        /**
+         * @brief Reads the options of a parsed `daemon` subcommand; the config path and ports are left to the caller.
+         */
+        void ReadDaemonOptions(SessionDaemonOptions& options);
+
+        /**
+         * @brief The `agent` subcommand, registered on the parser by RegistryArguments.
+         */
+        argparse::ArgumentParser& AgentCommand();
+
+        /**
+         * @brief Reads the options of a parsed `agent` subcommand; the config path, port and screen are left to the caller.
+         */
+        void ReadAgentOptions(SessionAgentOptions& options);
+
 } // namespace glass_surf::arguments
 
 
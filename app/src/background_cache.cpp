@@ -0,0 +1,218 @@
+// background_cache.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "background_cache.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tracer.h"
+
+glass_surf::BackgroundCache::BackgroundCache(const SurfaceSwapChain& swap_chain, size_t entries)
+    : BackgroundCache([&swap_chain]() { return swap_chain.Current(); }, nullptr, entries) {}
+
+glass_surf::BackgroundCache::BackgroundCache(SurfaceProvider surface_provider, GenerationProvider generation_provider,
+    size_t entries)
+    : surface_provider_(std::move(surface_provider)), generation_provider_(std::move(generation_provider)),
+    entries_(std::max<size_t>(entries, 1)), last_served_(&entries_.front()) {
+    if (!generation_provider_) {
+        generation_provider_ = [this]() {
+            std::shared_ptr<const Surface> surface = surface_provider_();
+            return surface ? surface->generation : 0;
+        };
+    }
+}
+
+bool glass_surf::BackgroundCache::IsStale(const WindowGeometry& geometry) {
+    if (!geometry.visible()) {
+        return false;
+    }
+
+    // 0 while there is no surface yet: nothing newer to serve
+    uint64_t generation = generation_provider_();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !last_served_->geometry.SameRectangle(geometry) || (generation != 0 && generation != last_served_->generation);
+}
+
+bool glass_surf::BackgroundCache::Get(const WindowGeometry& geometry, std::string& png, uint64_t* generation) {
+    std::shared_ptr<const Surface> surface;
+    bool encode = false;
+    std::shared_ptr<EncodedImage> image = Select(geometry, generation, surface, encode);
+
+    if (encode) {
+        Encode(*image, surface.get(), geometry, nullptr);
+    }
+
+    GLASSSURF_TRACE_SCOPE("copy body");
+    png.clear();
+    return image->Forward([&png](const uint8_t* data, size_t size) {
+        png.append(reinterpret_cast<const char*>(data), size);
+    });
+}
+
+bool glass_surf::BackgroundCache::Stream(const WindowGeometry& geometry, const PngSink& sink, uint64_t* generation) {
+    std::shared_ptr<const Surface> surface;
+    bool encode = false;
+    std::shared_ptr<EncodedImage> image = Select(geometry, generation, surface, encode);
+
+    if (encode) {
+        return Encode(*image, surface.get(), geometry, sink);
+    }
+    return image->Forward(sink);
+}
+
+std::shared_ptr<glass_surf::BackgroundCache::EncodedImage> glass_surf::BackgroundCache::Select(
+    const WindowGeometry& geometry, uint64_t* generation, std::shared_ptr<const Surface>& surface, bool& encode) {
+    // Keep the surface alive while cropping, even if a new frame is published meanwhile
+    surface = surface_provider_();
+    uint64_t surface_generation = surface ? surface->generation : 0;
+
+    // Requests queue up here only while another one picks its entry
+    GLASSSURF_TRACE_SCOPE("queue");
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Entry* entry = nullptr;
+    if (!geometry.visible() && entries_.size() == 1 && last_served_->image && !last_served_->image->Failed()) {
+        // Nobody sees the window: the image served last, whatever it shows, will
+        // do. Only for a single client: with several entries, the image served
+        // last may be another window's crop.
+        entry = last_served_;
+    }
+    else {
+        for (Entry& candidate : entries_) {
+            if (candidate.last_used != 0 && candidate.geometry.SameRectangle(geometry)
+                && candidate.generation == surface_generation && !candidate.image->Failed()) {
+                entry = &candidate;
+                break;
+            }
+        }
+    }
+
+    encode = !entry;
+    if (encode) {
+        // The least recently used entry is replaced; its buffers are reused
+        // unless a request is still reading them
+        entry = &*std::min_element(entries_.begin(), entries_.end(),
+            [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+
+        entry->geometry = geometry;
+        entry->generation = surface_generation;
+        if (entry->image && entry->image.use_count() == 1) {
+            entry->image->Reset();
+        }
+        else {
+            entry->image = std::make_shared<EncodedImage>();
+        }
+    }
+
+    entry->last_used = ++uses_;
+    last_served_ = entry;
+    if (generation) {
+        *generation = entry->generation;
+    }
+
+    return entry->image;
+}
+
+bool glass_surf::BackgroundCache::Encode(EncodedImage& image, const Surface* surface, const WindowGeometry& geometry,
+    const PngSink& sink) {
+    // A view into a full surface, which the encoder reads in place; compact
+    // surfaces are converted into crop_buffers, freed again after the encode
+    SurfaceCropBuffers crop_buffers;
+    cv::Mat crop;
+    if (surface) {
+        GLASSSURF_TRACE_SCOPE("crop");
+        crop = surface->Crop(cv::Rect(geometry.x, geometry.y, geometry.width, geometry.height), crop_buffers);
+    }
+
+    if (on_crop && !crop.empty()) {
+        on_crop(crop, geometry);
+    }
+
+    GLASSSURF_TRACE_SCOPE("encode");
+
+    bool encoded;
+    if (!sink) {
+        // Readers wait for the whole image, which is encoded straight into its buffer
+        std::string& png = image.Spare();
+        encoded = glass_surf::EncodePng(crop, png);
+        if (encoded) {
+            image.Publish();
+        }
+    }
+    else {
+        // Streaming favours the first byte over the total: a single stripe emits
+        // IDAT chunks as deflate fills them instead of after all stripes are done
+        encoded = glass_surf::EncodePngStriped(crop, [&image, &sink](const uint8_t* data, size_t size) {
+            image.Spare().assign(reinterpret_cast<const char*>(data), size);
+            image.Publish();
+            sink(data, size);
+        }, 1, 1);
+    }
+
+    image.Finish(encoded);
+
+    if (encoded && on_encoded) {
+        on_encoded(*surface);
+    }
+
+    return encoded;
+}
+
+void glass_surf::BackgroundCache::EncodedImage::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    published = 0;
+    complete = false;
+    encoded = false;
+}
+
+bool glass_surf::BackgroundCache::EncodedImage::Failed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return complete && !encoded;
+}
+
+std::string& glass_surf::BackgroundCache::EncodedImage::Spare() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (published == chunks.size()) {
+        chunks.emplace_back();
+    }
+    // Unseen by readers until published, so the encoder fills it unlocked
+    return chunks[published];
+}
+
+void glass_surf::BackgroundCache::EncodedImage::Publish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++published;
+    }
+    grown.notify_all();
+}
+
+void glass_surf::BackgroundCache::EncodedImage::Finish(bool succeeded) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        complete = true;
+        encoded = succeeded && published != 0;
+    }
+    grown.notify_all();
+}
+
+bool glass_surf::BackgroundCache::EncodedImage::Forward(const PngSink& sink) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (size_t forwarded = 0;; ++forwarded) {
+        grown.wait(lock, [this, forwarded]() { return forwarded < published || complete; });
+        if (forwarded == published) {
+            return encoded;
+        }
+
+        const std::string& chunk = chunks[forwarded];
+        lock.unlock();
+        sink(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size());
+        lock.lock();
+    }
+}
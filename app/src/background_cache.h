@@ -0,0 +1,147 @@
+// background_cache.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef BACKGROUND_CACHE_H_
+#define BACKGROUND_CACHE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "geometry_source.h"
+#include "png_encoder.h"
+#include "surface.h"
+
+namespace glass_surf {
+
+	/**
+	 * @brief The encoded /bg/ image: the crop of the published surface behind the
+	 * browser window, re-encoded only when the window or the surface changed.
+	 *
+	 * A hit (same rectangle, same surface generation) copies or forwards the
+	 * cached bytes and allocates nothing itself. With a single entry (a single
+	 * client), the image served last counts as a hit while the window cannot be
+	 * seen, so nothing is cropped or encoded until it becomes visible again. With
+	 * more than one entry, the images of several windows over the same surface
+	 * are kept, the least recently used one being replaced on a miss; a hidden
+	 * window is then served its own crop, as the image served last may belong to
+	 * another window. Every method may be called from any thread. The
+	 * cache is locked only to pick the entry: the request that missed crops and
+	 * encodes on its own, and requests for the same image meanwhile follow its
+	 * bytes as they are encoded, so nobody writes to a socket with a lock held.
+	 */
+	class BackgroundCache {
+	public:
+		/**
+		 * @brief Returns the surface to crop from; called on every request.
+		 */
+		using SurfaceProvider = std::function<std::shared_ptr<const Surface>()>;
+
+		/**
+		 * @brief Returns the generation of the surface the provider would return, without producing it.
+		 */
+		using GenerationProvider = std::function<uint64_t()>;
+
+		/**
+		 * @brief Serves crops of the surface published on `swap_chain`.
+		 */
+		explicit BackgroundCache(const SurfaceSwapChain& swap_chain, size_t entries = 1);
+
+		/**
+		 * @brief Serves crops of the surface `surface_provider` returns, e.g. one rendered on demand.
+		 *
+		 * @param generation_provider Answers IsStale; without one, IsStale asks `surface_provider` for the surface.
+		 */
+		explicit BackgroundCache(SurfaceProvider surface_provider, GenerationProvider generation_provider = nullptr,
+			size_t entries = 1);
+
+		/**
+		 * @brief Returns true if the image served last is not the one for this
+		 * geometry and the published surface (the /state/ answer of a single
+		 * client); never while the window cannot be seen.
+		 */
+		bool IsStale(const WindowGeometry& geometry);
+
+		/**
+		 * @brief Brings the cached image up to date and copies it into `png`.
+		 *
+		 * @param generation If set, receives the generation of the surface the image was cropped from.
+		 * @return False if there is no image (no surface, window outside the screen, encode failure).
+		 */
+		bool Get(const WindowGeometry& geometry, std::string& png, uint64_t* generation = nullptr);
+
+		/**
+		 * @brief Brings the cached image up to date while forwarding its bytes.
+		 *
+		 * On a miss the bytes go to `sink` while they are encoded, in a single
+		 * stripe so the first IDAT chunk is out as early as possible; on a hit
+		 * they are forwarded as they are available. `sink` is never called with
+		 * a lock held, so a slow client delays no other request.
+		 *
+		 * @return False as for Get; `sink` may have received part of the image.
+		 */
+		bool Stream(const WindowGeometry& geometry, const PngSink& sink, uint64_t* generation = nullptr);
+
+		/**
+		 * @brief Called on a miss with the fresh crop, before it is encoded; not under the cache lock.
+		 */
+		std::function<void(const cv::Mat& crop, const WindowGeometry& geometry)> on_crop;
+
+		/**
+		 * @brief Called after a miss was encoded successfully, with the surface it was cropped from.
+		 */
+		std::function<void(const Surface& surface)> on_encoded;
+
+	private:
+		// The bytes of one image, appended while it is encoded. Chunks are never
+		// moved, so readers use the published ones without the lock; their buffers
+		// are reused by the next encode once nobody holds the image.
+		struct EncodedImage {
+			std::mutex mutex;
+			std::condition_variable grown;
+			std::deque<std::string> chunks;
+			size_t published = 0; // chunks[0, published) hold the image so far
+			bool complete = false;
+			bool encoded = false;
+
+			void Reset();
+			bool Failed();
+			std::string& Spare();
+			void Publish();
+			void Finish(bool succeeded);
+			bool Forward(const PngSink& sink);
+		};
+
+		struct Entry {
+			WindowGeometry geometry;
+			uint64_t generation = 0; // Surface generation image was cropped from
+			std::shared_ptr<EncodedImage> image;
+			uint64_t last_used = 0;  // 0 while the entry was never filled
+		};
+
+		std::shared_ptr<EncodedImage> Select(const WindowGeometry& geometry, uint64_t* generation,
+			std::shared_ptr<const Surface>& surface, bool& encode);
+		bool Encode(EncodedImage& image, const Surface* surface, const WindowGeometry& geometry, const PngSink& sink);
+
+		SurfaceProvider surface_provider_;
+		GenerationProvider generation_provider_;
+
+		std::mutex mutex_;
+		std::vector<Entry> entries_;
+		Entry* last_served_;
+		uint64_t uses_ = 0;
+	};
+
+} // namespace glass_surf
+
+#endif // !BACKGROUND_CACHE_H_
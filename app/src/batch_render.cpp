@@ -0,0 +1,281 @@
+// batch_render.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "batch_render.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "settings/settings_manager.h"
+#include "frame_source.h"
+#include "image_utilities.h"
+#include "pipeline.h"
+#include "png_encoder.h"
+#include "thread_pool.h"
+
+namespace {
+
+    struct Profile {
+        std::string name;
+        glass_surf::settings::Settings settings;
+    };
+
+    struct JobReport {
+        std::string input;
+        cv::Size resolution;
+        std::string profile;
+        std::string output;
+        double decode_ms = 0.0; // Shared by every job of the same input
+        double pipeline_ms = 0.0;
+        double encode_ms = 0.0;
+        double write_ms = 0.0;
+        size_t bytes = 0;
+        int worker = -1;
+        bool succeeded = false;
+    };
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::string Stem(const std::string& path) {
+        return std::filesystem::path(path).stem().string();
+    }
+
+    // Directories are replaced by the still images they contain
+    std::vector<std::string> ExpandInputs(const std::vector<std::string>& inputs) {
+        std::vector<std::string> images;
+        std::error_code error;
+
+        for (const std::string& input : inputs) {
+            if (std::filesystem::is_directory(input, error)) {
+                std::vector<std::string> directory_images = glass_surf::ListStillImages(input);
+                images.insert(images.end(), directory_images.begin(), directory_images.end());
+            }
+            else {
+                images.push_back(input);
+            }
+        }
+
+        return images;
+    }
+
+    // Renders one (input, resolution, profile) combination into the report
+    void RenderJob(const cv::Mat& frame, const Profile& profile, const std::string& output_directory,
+        JobReport& report) {
+        // Per worker, so consecutive jobs of the same size reuse every buffer
+        thread_local glass_surf::PipelineBuffers buffers;
+        thread_local cv::Mat surface;
+        thread_local std::string png;
+
+        report.worker = glass_surf::WorkStealingPool::CurrentWorker();
+
+        auto start = std::chrono::steady_clock::now();
+        glass_surf::RunPipeline(frame, glass_surf::MakePipelineOptions(profile.settings, report.resolution),
+            buffers, surface);
+        report.pipeline_ms = MillisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        if (!glass_surf::EncodePng(surface, png)) {
+            std::cerr << "[ERROR]: Encoding " << report.output << " failed!" << std::endl;
+            return;
+        }
+        report.encode_ms = MillisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        std::string output_path = (std::filesystem::path(output_directory) / report.output).string();
+        std::ofstream file(output_path, std::ios::binary);
+        file.write(png.data(), static_cast<std::streamsize>(png.size()));
+        file.close();
+        report.write_ms = MillisecondsSince(start);
+
+        if (!file) {
+            std::cerr << "[ERROR]: Writing " << output_path << " failed!" << std::endl;
+            return;
+        }
+
+        report.bytes = png.size();
+        report.succeeded = true;
+    }
+
+    bool WriteReport(const std::string& path, const std::vector<JobReport>& reports) {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "[ERROR]: Writing report " << path << " failed!" << std::endl;
+            return false;
+        }
+
+        file << "input,resolution,profile,output,status,worker,decode_ms,pipeline_ms,encode_ms,write_ms,bytes" << std::endl;
+        file << std::fixed << std::setprecision(2);
+
+        for (const JobReport& report : reports) {
+            file << report.input << ',' << report.resolution.width << 'x' << report.resolution.height << ','
+                << report.profile << ',' << report.output << ',' << (report.succeeded ? "ok" : "failed") << ','
+                << report.worker << ',' << report.decode_ms << ',' << report.pipeline_ms << ','
+                << report.encode_ms << ',' << report.write_ms << ',' << report.bytes << std::endl;
+        }
+
+        return true;
+    }
+
+} // namespace
+
+bool glass_surf::ParseResolution(const std::string& text, cv::Size& resolution) {
+    size_t separator = text.find('x');
+    if (separator == std::string::npos) {
+        return false;
+    }
+
+    int width = 0;
+    int height = 0;
+    auto width_result = std::from_chars(text.data(), text.data() + separator, width);
+    auto height_result = std::from_chars(text.data() + separator + 1, text.data() + text.size(), height);
+
+    if (width_result.ec != std::errc() || width_result.ptr != text.data() + separator
+        || height_result.ec != std::errc() || height_result.ptr != text.data() + text.size()
+        || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    resolution = cv::Size(width, height);
+    return true;
+}
+
+int glass_surf::RunBatchRender(const BatchRenderOptions& options) {
+    std::vector<std::string> images = ExpandInputs(options.inputs);
+    if (images.empty() || options.resolutions.empty() || options.profiles.empty()) {
+        std::cerr << "[ERROR]: Nothing to render: no input images, resolutions or profiles" << std::endl;
+        return 1;
+    }
+
+    std::vector<Profile> profiles;
+    for (const std::string& profile_path : options.profiles) {
+        profiles.push_back(Profile{ Stem(profile_path), settings::ReadSettingsFile(profile_path) });
+    }
+
+    // One report per combination, preallocated so jobs fill them without locking
+    std::vector<JobReport> reports;
+    for (const std::string& image : images) {
+        for (const cv::Size& resolution : options.resolutions) {
+            for (const Profile& profile : profiles) {
+                JobReport report;
+                report.input = image;
+                report.resolution = resolution;
+                report.profile = profile.name;
+                report.output = Stem(image) + "_" + std::to_string(resolution.width) + "x"
+                    + std::to_string(resolution.height) + "_" + profile.name + ".png";
+                reports.push_back(std::move(report));
+            }
+        }
+    }
+
+    // Equal stems of inputs (or profiles) in different directories, or a repeated
+    // resolution, would have jobs overwrite each other's file concurrently.
+    // Compared case-insensitively, as Windows and macOS file systems do.
+    std::map<std::string, const JobReport*> outputs;
+    for (const JobReport& report : reports) {
+        std::string key = report.output;
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        auto [existing, inserted] = outputs.emplace(key, &report);
+        if (!inserted) {
+            std::cerr << "[ERROR]: " << existing->second->input << " (" << existing->second->profile << ") and "
+                << report.input << " (" << report.profile << ") would both be written to " << report.output
+                << "; rename one of them or render them separately" << std::endl;
+            return 1;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(options.output_directory, error);
+    if (error) {
+        std::cerr << "[ERROR]: Creating " << options.output_directory << " failed: " << error.message() << std::endl;
+        return 1;
+    }
+
+    // Workers times OpenCV threads stays within the hardware threads; blur and
+    // resize would otherwise fan out on every worker at once
+    size_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t workers = options.jobs > 0 ? options.jobs : hardware_threads;
+    workers = std::min(workers, images.size() * options.resolutions.size() * profiles.size());
+
+    int previous_opencv_threads = cv::getNumThreads();
+    int opencv_threads = static_cast<int>(std::max<size_t>(hardware_threads / workers, 1));
+    cv::setNumThreads(opencv_threads);
+
+    std::cout << "Rendering " << images.size() << " image(s) x " << options.resolutions.size()
+        << " resolution(s) x " << profiles.size() << " profile(s) on " << workers << " worker(s), "
+        << opencv_threads << " OpenCV thread(s) each" << std::endl;
+
+    const size_t jobs_per_image = options.resolutions.size() * profiles.size();
+    auto start = std::chrono::steady_clock::now();
+
+    {
+        WorkStealingPool pool(workers);
+
+        for (size_t image_index = 0; image_index < images.size(); ++image_index) {
+            pool.Submit([&, image_index]() {
+                auto decode_start = std::chrono::steady_clock::now();
+                auto frame = std::make_shared<const cv::Mat>(glass_surf::ReadImage(images[image_index]));
+                double decode_ms = MillisecondsSince(decode_start);
+
+                JobReport* image_reports = &reports[image_index * jobs_per_image];
+                for (size_t i = 0; i < jobs_per_image; ++i) {
+                    image_reports[i].decode_ms = decode_ms;
+                }
+
+                if (frame->empty()) {
+                    return;
+                }
+
+                // Submitted to this worker's deque: it works through them while idle workers steal
+                for (size_t i = 0; i < jobs_per_image; ++i) {
+                    const Profile& profile = profiles[i % profiles.size()];
+                    pool.Submit([&, frame, report = &image_reports[i]]() {
+                        RenderJob(*frame, profile, options.output_directory, *report);
+                    });
+                }
+            });
+        }
+
+        pool.Wait();
+    }
+
+    double wall_ms = MillisecondsSince(start);
+    cv::setNumThreads(previous_opencv_threads);
+
+    double job_ms = 0.0;
+    size_t succeeded = 0;
+    for (size_t i = 0; i < reports.size(); ++i) {
+        const JobReport& report = reports[i];
+        job_ms += report.pipeline_ms + report.encode_ms + report.write_ms;
+        if (i % jobs_per_image == 0) {
+            job_ms += report.decode_ms;
+        }
+        succeeded += report.succeeded ? 1 : 0;
+    }
+
+    std::string report_path = options.report_path.empty()
+        ? (std::filesystem::path(options.output_directory) / "report.csv").string()
+        : options.report_path;
+    WriteReport(report_path, reports);
+
+    std::cout << std::fixed << std::setprecision(1)
+        << "Rendered " << succeeded << "/" << reports.size() << " job(s) in " << wall_ms << " ms ("
+        << job_ms << " ms of job time, " << (wall_ms > 0.0 ? job_ms / wall_ms : 0.0) << "x parallel)" << std::endl;
+    std::cout << "Timing report: " << report_path << std::endl;
+
+    return succeeded == reports.size() ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+// batch_render.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef BATCH_RENDER_H_
+#define BATCH_RENDER_H_
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief What the `render` subcommand processes.
+	 */
+	struct BatchRenderOptions {
+		std::vector<std::string> inputs;   // Image files or directories of images
+		std::vector<cv::Size> resolutions;
+		std::vector<std::string> profiles; // Settings files (config.json format)
+		std::string output_directory;
+		std::string report_path;           // CSV timing report; empty writes <output>/report.csv
+		size_t jobs = 0;                   // Worker threads; 0 uses one per hardware thread
+	};
+
+	/**
+	 * @brief Renders every input at every resolution with every profile and writes PNGs.
+	 *
+	 * Each input is decoded once by a job that then submits one render job per
+	 * (resolution, profile) to a WorkStealingPool. Outputs are named
+	 * <input>_<width>x<height>_<profile>.png and encoded like /bg/ responses.
+	 * OpenCV's own thread pool is sized so workers times OpenCV threads does not
+	 * exceed the hardware threads.
+	 *
+	 * @return 0 if every job succeeded, 1 otherwise.
+	 */
+	int RunBatchRender(const BatchRenderOptions& options);
+
+	/**
+	 * @brief Parses "WIDTHxHEIGHT".
+	 *
+	 * @return False if the text is not two positive integers separated by 'x'.
+	 */
+	bool ParseResolution(const std::string& text, cv::Size& resolution);
+
+} // namespace glass_surf
+
+#endif // !BATCH_RENDER_H_
@@ -0,0 +1,149 @@
+// frame_source.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "frame_source.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+
+#include "image_utilities.h"
+
+namespace {
+
+    constexpr std::chrono::milliseconds kDefaultFrameInterval(100);
+
+    std::string LowercaseExtension(const std::filesystem::path& path) {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        return extension;
+    }
+
+    bool IsStillImage(const std::filesystem::path& path) {
+        static const std::vector<std::string> extensions = {
+            ".jpg", ".jpeg", ".png", ".bmp", ".webp", ".tif", ".tiff" };
+
+        return std::find(extensions.begin(), extensions.end(), LowercaseExtension(path)) != extensions.end();
+    }
+
+} // namespace
+
+glass_surf::StaticImageSource::StaticImageSource(std::string image_path)
+    : image_path_(std::move(image_path)) {}
+
+bool glass_surf::StaticImageSource::NextFrame(cv::Mat& frame) {
+    if (done_) {
+        return false;
+    }
+
+    done_ = true;
+    frame = glass_surf::ReadImage(image_path_);
+
+    return !frame.empty();
+}
+
+std::chrono::milliseconds glass_surf::StaticImageSource::FrameInterval() const {
+    return std::chrono::milliseconds(0);
+}
+
+std::vector<std::string> glass_surf::ListStillImages(const std::string& directory_path) {
+    std::vector<std::string> image_paths;
+    std::error_code error;
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory_path, error)) {
+        if (entry.is_regular_file() && IsStillImage(entry.path())) {
+            image_paths.push_back(entry.path().string());
+        }
+    }
+
+    if (error) {
+        std::cerr << "[ERROR]: Listing " << directory_path << " failed: " << error.message() << std::endl;
+    }
+
+    std::sort(image_paths.begin(), image_paths.end());
+
+    return image_paths;
+}
+
+bool glass_surf::IsFrameSequence(const std::string& path) {
+    static const std::vector<std::string> extensions = {
+        ".gif", ".mp4", ".webm", ".avi", ".mov", ".mkv" };
+
+    return std::find(extensions.begin(), extensions.end(), LowercaseExtension(path)) != extensions.end();
+}
+
+glass_surf::SlideshowSource::SlideshowSource(const std::string& directory_path, std::chrono::milliseconds interval)
+    : image_paths_(glass_surf::ListStillImages(directory_path)), interval_(interval) {}
+
+bool glass_surf::SlideshowSource::NextFrame(cv::Mat& frame) {
+    // Skip unreadable files, but give up after one full round
+    for (size_t attempt = 0; attempt < image_paths_.size(); ++attempt) {
+        const std::string& image_path = image_paths_[next_index_];
+        next_index_ = (next_index_ + 1) % image_paths_.size();
+
+        frame = glass_surf::ReadImage(image_path);
+        if (!frame.empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::chrono::milliseconds glass_surf::SlideshowSource::FrameInterval() const {
+    // A single image never changes
+    return image_paths_.size() > 1 ? interval_ : std::chrono::milliseconds(0);
+}
+
+glass_surf::FrameSequenceSource::FrameSequenceSource(std::string sequence_path)
+    : sequence_path_(std::move(sequence_path)), capture_(sequence_path_), interval_(kDefaultFrameInterval) {
+    if (!capture_.isOpened()) {
+        std::cerr << "[ERROR]: Opening " << sequence_path_ << " failed!" << std::endl;
+        return;
+    }
+
+    double fps = capture_.get(cv::CAP_PROP_FPS);
+    if (fps > 0.0 && fps <= 240.0) {
+        interval_ = std::chrono::milliseconds(static_cast<int>(1000.0 / fps));
+    }
+}
+
+bool glass_surf::FrameSequenceSource::NextFrame(cv::Mat& frame) {
+    if (!capture_.isOpened()) {
+        return false;
+    }
+
+    if (capture_.read(frame)) {
+        return true;
+    }
+
+    // End of the sequence: rewind and loop
+    capture_.set(cv::CAP_PROP_POS_FRAMES, 0);
+    return capture_.read(frame);
+}
+
+std::chrono::milliseconds glass_surf::FrameSequenceSource::FrameInterval() const {
+    return interval_;
+}
+
+std::unique_ptr<glass_surf::FrameSource> glass_surf::CreateFrameSource(const std::string& wallpaper_path,
+    std::chrono::milliseconds slideshow_interval) {
+    std::error_code error;
+    std::filesystem::path path(wallpaper_path);
+
+    if (std::filesystem::is_directory(path, error)) {
+        return std::make_unique<SlideshowSource>(wallpaper_path, slideshow_interval);
+    }
+
+    if (glass_surf::IsFrameSequence(wallpaper_path)) {
+        return std::make_unique<FrameSequenceSource>(wallpaper_path);
+    }
+
+    return std::make_unique<StaticImageSource>(wallpaper_path);
+}
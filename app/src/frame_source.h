@@ -0,0 +1,113 @@
+// frame_source.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef FRAME_SOURCE_H_
+#define FRAME_SOURCE_H_
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief A source of wallpaper frames fed into the image pipeline.
+	 */
+	class FrameSource {
+	public:
+		virtual ~FrameSource() = default;
+
+		/**
+		 * @brief Decodes the next frame.
+		 *
+		 * @param frame Receives the BGR frame; its buffer is reused when the source allows it.
+		 * @return False if the source has no (more) frames.
+		 */
+		virtual bool NextFrame(cv::Mat& frame) = 0;
+
+		/**
+		 * @brief How long a frame stays on screen before the next one.
+		 *
+		 * @return Zero for sources that only ever produce one frame.
+		 */
+		virtual std::chrono::milliseconds FrameInterval() const = 0;
+	};
+
+	/**
+	 * @brief A single still image, decoded once.
+	 */
+	class StaticImageSource : public FrameSource {
+	public:
+		explicit StaticImageSource(std::string image_path);
+
+		bool NextFrame(cv::Mat& frame) override;
+		std::chrono::milliseconds FrameInterval() const override;
+
+	private:
+		std::string image_path_;
+		bool done_ = false;
+	};
+
+	/**
+	 * @brief The images of a directory, shown in name order and looped.
+	 */
+	class SlideshowSource : public FrameSource {
+	public:
+		SlideshowSource(const std::string& directory_path, std::chrono::milliseconds interval);
+
+		bool NextFrame(cv::Mat& frame) override;
+		std::chrono::milliseconds FrameInterval() const override;
+
+	private:
+		std::vector<std::string> image_paths_;
+		std::chrono::milliseconds interval_;
+		size_t next_index_ = 0;
+	};
+
+	/**
+	 * @brief A decoded frame sequence (GIF or video wallpaper), looped.
+	 */
+	class FrameSequenceSource : public FrameSource {
+	public:
+		explicit FrameSequenceSource(std::string sequence_path);
+
+		bool NextFrame(cv::Mat& frame) override;
+		std::chrono::milliseconds FrameInterval() const override;
+
+	private:
+		std::string sequence_path_;
+		cv::VideoCapture capture_;
+		std::chrono::milliseconds interval_;
+	};
+
+	/**
+	 * @brief Returns the still images (by extension) directly inside a directory, sorted by name.
+	 */
+	std::vector<std::string> ListStillImages(const std::string& directory_path);
+
+	/**
+	 * @brief Returns true if the path names a frame sequence (by extension), such as a GIF or a video.
+	 */
+	bool IsFrameSequence(const std::string& path);
+
+	/**
+	 * @brief Picks a frame source for a wallpaper path.
+	 *
+	 * Directories become a slideshow, .gif and video files a frame sequence, anything else
+	 * a static image.
+	 *
+	 * @param wallpaper_path File or directory of the wallpaper.
+	 * @param slideshow_interval Interval between slideshow images.
+	 */
+	std::unique_ptr<FrameSource> CreateFrameSource(const std::string& wallpaper_path,
+		std::chrono::milliseconds slideshow_interval);
+
+} // namespace glass_surf
+
+#endif // !FRAME_SOURCE_H_
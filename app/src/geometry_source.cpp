@@ -0,0 +1,140 @@
+// geometry_source.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "geometry_source.h"
+
+#include <iterator>
+
+#include "geometry_trace.h"
+
+#ifdef _WIN32
+#include <dwmapi.h>
+#endif
+
+namespace {
+
+    constexpr const char* kVisibilityNames[] = { "visible", "minimized", "cloaked", "occluded", "off-screen" };
+
+#ifdef _WIN32
+    bool IsCloaked(HWND window) {
+        DWORD cloaked = 0;
+        return SUCCEEDED(DwmGetWindowAttribute(window, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))) && cloaked != 0;
+    }
+
+    // The visible frame, without the invisible resize borders GetWindowRect includes
+    bool GetFrameRect(HWND window, RECT& rect) {
+        return SUCCEEDED(DwmGetWindowAttribute(window, DWMWA_EXTENDED_FRAME_BOUNDS, &rect, sizeof(rect)))
+            || GetWindowRect(window, &rect);
+    }
+
+    // True if the windows above `window` in the z-order cover all of `rect`
+    bool IsCovered(HWND window, const RECT& rect) {
+        HRGN uncovered = CreateRectRgnIndirect(&rect);
+        HRGN above_region = CreateRectRgn(0, 0, 0, 0);
+        bool covered = false;
+
+        for (HWND above = GetWindow(window, GW_HWNDPREV); above; above = GetWindow(above, GW_HWNDPREV)) {
+            LONG_PTR ex_style = GetWindowLongPtr(above, GWL_EXSTYLE);
+            if ((ex_style & WS_EX_TOOLWINDOW) || ((ex_style & WS_EX_LAYERED) && (ex_style & WS_EX_TRANSPARENT))) {
+                continue;
+            }
+
+            RECT above_rect;
+            if (!IsWindowVisible(above) || IsIconic(above) || IsCloaked(above) || !GetFrameRect(above, above_rect)) {
+                continue;
+            }
+
+            SetRectRgn(above_region, above_rect.left, above_rect.top, above_rect.right, above_rect.bottom);
+            if (CombineRgn(uncovered, uncovered, above_region, RGN_DIFF) == NULLREGION) {
+                covered = true;
+                break;
+            }
+        }
+
+        DeleteObject(above_region);
+        DeleteObject(uncovered);
+        return covered;
+    }
+
+    glass_surf::WindowVisibility FindVisibility(HWND window) {
+        if (IsIconic(window)) {
+            return glass_surf::WindowVisibility::MINIMIZED;
+        }
+        if (!IsWindowVisible(window) || IsCloaked(window)) {
+            return glass_surf::WindowVisibility::CLOAKED;
+        }
+
+        RECT rect;
+        HMONITOR monitor;
+        MONITORINFO monitor_info = { sizeof(MONITORINFO) };
+        if (!GetFrameRect(window, rect) || !(monitor = MonitorFromRect(&rect, MONITOR_DEFAULTTONULL))
+            || !GetMonitorInfo(monitor, &monitor_info)) {
+            return glass_surf::WindowVisibility::OFF_SCREEN;
+        }
+
+        // Only the part on the monitor can be seen
+        RECT visible_rect;
+        if (!IntersectRect(&visible_rect, &rect, &monitor_info.rcMonitor)) {
+            return glass_surf::WindowVisibility::OFF_SCREEN;
+        }
+
+        return IsCovered(window, visible_rect) ? glass_surf::WindowVisibility::OCCLUDED : glass_surf::WindowVisibility::VISIBLE;
+    }
+#endif
+
+} // namespace
+
+const char* glass_surf::VisibilityName(WindowVisibility visibility) {
+    size_t index = static_cast<size_t>(visibility);
+    return index < std::size(kVisibilityNames) ? kVisibilityNames[index] : "unknown";
+}
+
+bool glass_surf::ParseVisibility(const std::string& name, WindowVisibility& visibility) {
+    for (size_t i = 0; i < std::size(kVisibilityNames); ++i) {
+        if (name == kVisibilityNames[i]) {
+            visibility = static_cast<WindowVisibility>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string glass_surf::GeometryTarget(const WindowGeometry& geometry) {
+    return "/geometry/?x=" + std::to_string(geometry.x) + "&y=" + std::to_string(geometry.y)
+        + "&width=" + std::to_string(geometry.width) + "&height=" + std::to_string(geometry.height)
+        + "&visibility=" + VisibilityName(geometry.visibility);
+}
+
+void glass_surf::PushedGeometrySource::Push(const WindowGeometry& geometry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    geometry_ = geometry;
+}
+
+glass_surf::WindowGeometry glass_surf::PushedGeometrySource::Current() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return geometry_;
+}
+
+glass_surf::RecordingGeometrySource::RecordingGeometrySource(GeometrySource& source, GeometryTraceWriter& writer)
+    : source_(source), writer_(writer) {}
+
+glass_surf::WindowGeometry glass_surf::RecordingGeometrySource::Current() {
+    WindowGeometry geometry = source_.Current();
+    writer_.RecordGeometry(geometry);
+    return geometry;
+}
+
+#ifdef _WIN32
+
+glass_surf::BrowserWindowGeometrySource::BrowserWindowGeometrySource(HWND window) : window_(window) {}
+
+glass_surf::WindowGeometry glass_surf::BrowserWindowGeometrySource::Current() {
+    win::WINDOW_INFO window_info = win::FindWindowInfoByHWND(window_);
+    return WindowGeometry{ window_info.position_x, window_info.position_y, window_info.width, window_info.height,
+        FindVisibility(window_) };
+}
+
+#endif
@@ -0,0 +1,137 @@
+// geometry_source.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef GEOMETRY_SOURCE_H_
+#define GEOMETRY_SOURCE_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include "windows/window_utilities.h"
+#endif
+
+namespace glass_surf {
+
+	class GeometryTraceWriter;
+
+	/**
+	 * @brief Whether anybody can see the browser window, and if not, why.
+	 */
+	enum class WindowVisibility : uint8_t {
+		VISIBLE = 0,
+		MINIMIZED = 1,
+		CLOAKED = 2,    // Hidden by the window manager, e.g. on another virtual desktop
+		OCCLUDED = 3,   // Fully covered by other windows
+		OFF_SCREEN = 4  // Outside every monitor
+	};
+
+	/**
+	 * @brief Returns the name used for `visibility` in the /geometry/ route and logs.
+	 */
+	const char* VisibilityName(WindowVisibility visibility);
+
+	/**
+	 * @brief Parses a name returned by VisibilityName.
+	 *
+	 * @return False if `name` is not one.
+	 */
+	bool ParseVisibility(const std::string& name, WindowVisibility& visibility);
+
+	/**
+	 * @brief Position and size of the browser window, in screen coordinates, and its visibility.
+	 */
+	struct WindowGeometry {
+		int x = 0;
+		int y = 0;
+		int width = 0;
+		int height = 0;
+		WindowVisibility visibility = WindowVisibility::VISIBLE;
+
+		bool operator==(const WindowGeometry& other) const = default;
+
+		bool visible() const {
+			return visibility == WindowVisibility::VISIBLE;
+		}
+
+		/**
+		 * @brief True if both cover the same rectangle, whatever their visibility.
+		 */
+		bool SameRectangle(const WindowGeometry& other) const {
+			return x == other.x && y == other.y && width == other.width && height == other.height;
+		}
+	};
+
+	/**
+	 * @brief Returns the /geometry/ request target that sets `geometry`.
+	 */
+	std::string GeometryTarget(const WindowGeometry& geometry);
+
+	/**
+	 * @brief Where the server learns the browser window geometry from.
+	 */
+	class GeometrySource {
+	public:
+		virtual ~GeometrySource() = default;
+
+		/**
+		 * @brief Returns the current geometry. Called from request threads.
+		 */
+		virtual WindowGeometry Current() = 0;
+	};
+
+	/**
+	 * @brief Geometry set from outside, e.g. by the /geometry/ route while a trace
+	 * is replayed, or to fake any visibility on a platform without a window source.
+	 */
+	class PushedGeometrySource : public GeometrySource {
+	public:
+		void Push(const WindowGeometry& geometry);
+
+		WindowGeometry Current() override;
+
+	private:
+		std::mutex mutex_;
+		WindowGeometry geometry_;
+	};
+
+	/**
+	 * @brief Passes another source through and records every change of its geometry.
+	 */
+	class RecordingGeometrySource : public GeometrySource {
+	public:
+		RecordingGeometrySource(GeometrySource& source, GeometryTraceWriter& writer);
+
+		WindowGeometry Current() override;
+
+	private:
+		GeometrySource& source_;
+		GeometryTraceWriter& writer_;
+	};
+
+#ifdef _WIN32
+	/**
+	 * @brief The rectangle and visibility of a top-level window, read on every call.
+	 *
+	 * Occlusion is found by subtracting the windows above it in the z-order from
+	 * its rectangle, clipped to its monitor; layered click-through overlays and
+	 * tool windows do not count as covering it.
+	 */
+	class BrowserWindowGeometrySource : public GeometrySource {
+	public:
+		explicit BrowserWindowGeometrySource(HWND window);
+
+		WindowGeometry Current() override;
+
+	private:
+		HWND window_;
+	};
+#endif
+
+} // namespace glass_surf
+
+#endif // !GEOMETRY_SOURCE_H_
@@ -0,0 +1,217 @@
+// geometry_trace.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "geometry_trace.h"
+
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+    constexpr char kMagic[4] = { 'G', 'S', 'G', 'T' };
+    constexpr uint8_t kVersion = 2;
+    constexpr uint8_t kVersionWithoutVisibility = 1;
+
+    // Buffered records are written once this many bytes or this much time have accumulated
+    constexpr size_t kFlushBytes = 64 * 1024;
+    constexpr auto kFlushInterval = std::chrono::seconds(1);
+
+    void AppendVarint(std::string& buffer, uint64_t value) {
+        while (value >= 0x80) {
+            buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    void AppendSigned(std::string& buffer, int64_t value) {
+        AppendVarint(buffer, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    bool ReadVarint(const std::string& data, size_t& offset, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && offset < data.size(); shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(data[offset++]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ReadSigned(const std::string& data, size_t& offset, int64_t& value) {
+        uint64_t encoded;
+        if (!ReadVarint(data, offset, encoded)) {
+            return false;
+        }
+        value = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+        return true;
+    }
+
+} // namespace
+
+glass_surf::GeometryTraceWriter::~GeometryTraceWriter() {
+    Close();
+}
+
+bool glass_surf::GeometryTraceWriter::Open(const std::string& path, int screen_width, int screen_height) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open()) {
+        std::cerr << "[ERROR]: Creating trace file " << path << " failed!" << std::endl;
+        return false;
+    }
+
+    buffer_.assign(kMagic, sizeof(kMagic));
+    buffer_.push_back(static_cast<char>(kVersion));
+    AppendVarint(buffer_, static_cast<uint64_t>(screen_width));
+    AppendVarint(buffer_, static_cast<uint64_t>(screen_height));
+
+    start_ = std::chrono::steady_clock::now();
+    last_flush_ = start_;
+    last_time_us_ = 0;
+    last_geometry_ = WindowGeometry();
+
+    return true;
+}
+
+void glass_surf::GeometryTraceWriter::Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_.is_open()) {
+        return;
+    }
+
+    file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    file_.close();
+    buffer_.clear();
+}
+
+bool glass_surf::GeometryTraceWriter::IsOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_.is_open();
+}
+
+void glass_surf::GeometryTraceWriter::RecordGeometry(const WindowGeometry& geometry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_.is_open() || geometry == last_geometry_) {
+        return;
+    }
+
+    AppendHeader(TraceRecord::GEOMETRY);
+    AppendSigned(buffer_, static_cast<int64_t>(geometry.x) - last_geometry_.x);
+    AppendSigned(buffer_, static_cast<int64_t>(geometry.y) - last_geometry_.y);
+    AppendSigned(buffer_, static_cast<int64_t>(geometry.width) - last_geometry_.width);
+    AppendSigned(buffer_, static_cast<int64_t>(geometry.height) - last_geometry_.height);
+    buffer_.push_back(static_cast<char>(geometry.visibility));
+    last_geometry_ = geometry;
+
+    FlushIfDue();
+}
+
+void glass_surf::GeometryTraceWriter::RecordRequest(TraceRecord request) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_.is_open()) {
+        return;
+    }
+
+    AppendHeader(request);
+    FlushIfDue();
+}
+
+void glass_surf::GeometryTraceWriter::AppendHeader(TraceRecord record) {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t time_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - start_).count());
+
+    // Records are appended under the lock, so time never runs backwards in the file
+    AppendVarint(buffer_, time_us - last_time_us_);
+    buffer_.push_back(static_cast<char>(record));
+    last_time_us_ = time_us;
+}
+
+void glass_surf::GeometryTraceWriter::FlushIfDue() {
+    auto now = std::chrono::steady_clock::now();
+    if (buffer_.size() < kFlushBytes && now - last_flush_ < kFlushInterval) {
+        return;
+    }
+
+    file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    file_.flush();
+    buffer_.clear();
+    last_flush_ = now;
+}
+
+bool glass_surf::ReadGeometryTrace(const std::string& path, GeometryTrace& trace) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "[ERROR]: Opening trace file " << path << " failed!" << std::endl;
+        return false;
+    }
+
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t offset = sizeof(kMagic) + 1;
+    uint64_t screen_width = 0;
+    uint64_t screen_height = 0;
+    uint8_t version = data.size() < offset ? 0 : static_cast<uint8_t>(data[sizeof(kMagic)]);
+    if (data.size() < offset || data.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0
+        || (version != kVersion && version != kVersionWithoutVisibility)
+        || !ReadVarint(data, offset, screen_width) || !ReadVarint(data, offset, screen_height)) {
+        std::cerr << "[ERROR]: " << path << " is not a geometry trace!" << std::endl;
+        return false;
+    }
+
+    trace.screen_width = static_cast<int>(screen_width);
+    trace.screen_height = static_cast<int>(screen_height);
+    trace.events.clear();
+
+    TraceEvent event;
+    while (offset < data.size()) {
+        uint64_t delta_us;
+        if (!ReadVarint(data, offset, delta_us) || offset >= data.size()) {
+            break;
+        }
+
+        uint8_t record = static_cast<uint8_t>(data[offset++]);
+        if (record > static_cast<uint8_t>(TraceRecord::CONTRAST_REQUEST)) {
+            std::cerr << "[ERROR]: Unknown record in trace " << path << ", stopping there" << std::endl;
+            break;
+        }
+
+        event.time_us += delta_us;
+        event.record = static_cast<TraceRecord>(record);
+
+        if (event.record == TraceRecord::GEOMETRY) {
+            int64_t dx, dy, dwidth, dheight;
+            if (!ReadSigned(data, offset, dx) || !ReadSigned(data, offset, dy)
+                || !ReadSigned(data, offset, dwidth) || !ReadSigned(data, offset, dheight)) {
+                break;
+            }
+
+            event.geometry.x += static_cast<int>(dx);
+            event.geometry.y += static_cast<int>(dy);
+            event.geometry.width += static_cast<int>(dwidth);
+            event.geometry.height += static_cast<int>(dheight);
+
+            if (version >= 2) {
+                if (offset >= data.size()) {
+                    break;
+                }
+                uint8_t visibility = static_cast<uint8_t>(data[offset++]);
+                if (visibility > static_cast<uint8_t>(WindowVisibility::OFF_SCREEN)) {
+                    std::cerr << "[ERROR]: Unknown visibility in trace " << path << ", stopping there" << std::endl;
+                    break;
+                }
+                event.geometry.visibility = static_cast<WindowVisibility>(visibility);
+            }
+        }
+
+        trace.events.push_back(event);
+    }
+
+    return true;
+}
@@ -0,0 +1,108 @@
+// geometry_trace.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef GEOMETRY_TRACE_H_
+#define GEOMETRY_TRACE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "geometry_source.h"
+
+namespace glass_surf {
+
+	/**
+	 * @brief What a trace record describes: a new window geometry, or the arrival of a request.
+	 */
+	enum class TraceRecord : uint8_t {
+		GEOMETRY = 0,
+		STATE_REQUEST = 1,
+		BACKGROUND_REQUEST = 2,        // /bg/ on the main port
+		BACKGROUND_STREAM_REQUEST = 3, // /bg/ on the streaming port
+		CONTRAST_REQUEST = 4
+	};
+
+	struct TraceEvent {
+		uint64_t time_us = 0; // Since the recording started
+		TraceRecord record = TraceRecord::GEOMETRY;
+		WindowGeometry geometry; // GEOMETRY records only
+	};
+
+	struct GeometryTrace {
+		int screen_width = 0;
+		int screen_height = 0;
+		std::vector<TraceEvent> events;
+	};
+
+	/**
+	 * @brief Records window geometry changes and request arrivals to a binary trace file.
+	 *
+	 * The file starts with "GSGT", a version byte and the screen resolution; each
+	 * record is the microseconds since the previous record and the record type,
+	 * GEOMETRY records followed by the change of x, y, width and height and the
+	 * visibility byte (version 2; version 1 files have no visibility and are read
+	 * as always visible). Numbers are zigzag LEB128 varints, so a 100 ms poll of
+	 * an unmoved window costs two bytes and a drag step a handful. Every method
+	 * may be called from any thread.
+	 */
+	class GeometryTraceWriter {
+	public:
+		~GeometryTraceWriter();
+
+		/**
+		 * @brief Creates the file and starts the clock.
+		 *
+		 * @return False if the file could not be created.
+		 */
+		bool Open(const std::string& path, int screen_width, int screen_height);
+
+		/**
+		 * @brief Writes buffered records and closes the file.
+		 */
+		void Close();
+
+		bool IsOpen() const;
+
+		/**
+		 * @brief Records the geometry if it differs from the last recorded one.
+		 */
+		void RecordGeometry(const WindowGeometry& geometry);
+
+		/**
+		 * @brief Records the arrival of a request; `request` must not be GEOMETRY.
+		 */
+		void RecordRequest(TraceRecord request);
+
+	private:
+		void AppendHeader(TraceRecord record);
+		void FlushIfDue();
+
+		mutable std::mutex mutex_;
+		std::ofstream file_;
+		std::string buffer_; // Records not yet written to file_
+		std::chrono::steady_clock::time_point start_;
+		std::chrono::steady_clock::time_point last_flush_;
+		uint64_t last_time_us_ = 0;
+		WindowGeometry last_geometry_;
+	};
+
+	/**
+	 * @brief Reads a trace written by GeometryTraceWriter.
+	 *
+	 * A record cut off at the end of the file (the recording process was killed)
+	 * is dropped; the records before it are kept.
+	 *
+	 * @return False if the file cannot be read or is not a geometry trace.
+	 */
+	bool ReadGeometryTrace(const std::string& path, GeometryTrace& trace);
+
+} // namespace glass_surf
+
+#endif // !GEOMETRY_TRACE_H_
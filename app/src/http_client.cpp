@@ -0,0 +1,72 @@
+// http_client.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "http_client.h"
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+
+glass_surf::HttpConnection::HttpConnection(boost::asio::io_context& io_context, const std::string& host, unsigned short port)
+    : host_(host), port_(port), socket_(io_context) {}
+
+unsigned glass_surf::HttpConnection::Send(http::verb method, const std::string& target, std::string& body) {
+    body.clear();
+
+    // A kept-alive connection may have been closed by the server since the last request
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (!socket_.is_open() && !Connect()) {
+            return 0;
+        }
+
+        http::request<http::empty_body> request(method, target, 11);
+        request.set(http::field::host, host_);
+        request.keep_alive(true);
+
+        boost::system::error_code error;
+        http::write(socket_, request, error);
+
+        if (!error) {
+            http::response_parser<http::string_body> parser;
+            parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+            http::read(socket_, buffer_, parser, error);
+
+            if (!error) {
+                http::response<http::string_body> response = parser.release();
+                body = std::move(response.body());
+                if (!response.keep_alive()) {
+                    Close();
+                }
+                return response.result_int();
+            }
+        }
+
+        Close();
+    }
+
+    return 0;
+}
+
+bool glass_surf::HttpConnection::Connect() {
+    boost::system::error_code error;
+    socket_.connect(tcp::endpoint(boost::asio::ip::make_address(host_, error), port_), error);
+    if (error) {
+        Close();
+        return false;
+    }
+
+    socket_.set_option(tcp::no_delay(true), error);
+    return true;
+}
+
+void glass_surf::HttpConnection::Close() {
+    boost::system::error_code error;
+    socket_.close(error);
+    buffer_.clear();
+}
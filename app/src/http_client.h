@@ -0,0 +1,49 @@
+// http_client.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef HTTP_CLIENT_H_
+#define HTTP_CLIENT_H_
+
+#include <string>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief A blocking HTTP/1.1 client on one keep-alive connection, reopened
+	 * after failures. Used by one thread at a time.
+	 */
+	class HttpConnection {
+	public:
+		/**
+		 * @param host IP address of the server.
+		 */
+		HttpConnection(boost::asio::io_context& io_context, const std::string& host, unsigned short port);
+
+		/**
+		 * @brief Sends a request without a body and reads the whole response.
+		 *
+		 * @param body Receives the response body.
+		 * @return The response status, or 0 if the server could not be reached.
+		 */
+		unsigned Send(boost::beast::http::verb method, const std::string& target, std::string& body);
+
+	private:
+		bool Connect();
+		void Close();
+
+		std::string host_;
+		unsigned short port_;
+		boost::asio::ip::tcp::socket socket_;
+		boost::beast::flat_buffer buffer_;
+	};
+
+} // namespace glass_surf
+
+#endif // !HTTP_CLIENT_H_
@@ -0,0 +1,40 @@
+// http_utilities.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "http_utilities.h"
+
+#include <charconv>
+
+void glass_surf::SetCorsHeaders(beauty::response& res) {
+    res.set_header(boost::beast::http::field::access_control_allow_origin, "*");
+    res.set_header(boost::beast::http::field::access_control_allow_methods, "GET, OPTIONS");
+    res.set_header(boost::beast::http::field::access_control_allow_headers, "Content-Type");
+    res.set_header(boost::beast::http::field::access_control_max_age, "3600");
+    res.set_header(boost::beast::http::field::access_control_expose_headers, kPollIntervalHeader);
+}
+
+bool glass_surf::IsLoopbackHost(const beauty::request& req) {
+    return IsLoopbackHost(std::string_view(req[boost::beast::http::field::host].data(),
+        req[boost::beast::http::field::host].size()));
+}
+
+bool glass_surf::IsLoopbackHost(std::string_view host) {
+    host = host.substr(0, host.rfind(':'));
+    return host == "localhost" || host == "127.0.0.1";
+}
+
+int glass_surf::GetIntegerParameter(const beauty::request& req, const std::string& name, int default_value) {
+    const std::string& value = req.a(name).as_string();
+
+    // The whole value must be a number: "12abc" is malformed, not 12
+    int result;
+    auto parsed = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (parsed.ec != std::errc() || parsed.ptr != value.data() + value.size()) {
+        return default_value;
+    }
+
+    return result;
+}
@@ -0,0 +1,48 @@
+// http_utilities.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef HTTP_UTILITIES_H_
+#define HTTP_UTILITIES_H_
+
+#include <string>
+#include <string_view>
+
+#include <beauty/beauty.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief Sent with /state/ while nobody can see the browser window: how long
+	 * the extension should wait before polling again, in milliseconds.
+	 */
+	inline const std::string kPollIntervalHeader = "X-GlassSurf-Poll-Interval";
+	inline const std::string kHiddenPollInterval = "1000";
+
+	/**
+	 * @brief Lets the extension call the API from any page (and read kPollIntervalHeader).
+	 */
+	void SetCorsHeaders(beauty::response& res);
+
+	/**
+	 * @brief Returns true if the request was addressed to this machine by name
+	 * (Host localhost or 127.0.0.1), as opposed to a page whose own domain was
+	 * made to resolve to the loopback address (DNS rebinding).
+	 */
+	bool IsLoopbackHost(const beauty::request& req);
+
+	/**
+	 * @brief The same for the value of a Host header.
+	 */
+	bool IsLoopbackHost(std::string_view host);
+
+	/**
+	 * @brief Returns the integer query parameter `name`, or `default_value` if it is missing or malformed.
+	 */
+	int GetIntegerParameter(const beauty::request& req, const std::string& name, int default_value);
+
+} // namespace glass_surf
+
+#endif // !HTTP_UTILITIES_H_
@@ -6,7 +6,10 @@
 
 #include "image_utilities.h"
 
+#include "tracer.h"
+
 cv::Mat glass_surf::ReadImage(const std::string& image_path) {
+  GLASSSURF_TRACE_SCOPE("decode");
   cv::Mat uploaded_image = cv::imread(image_path);
 
   if (uploaded_image.empty()) {
@@ -32,14 +35,30 @@ cv::Mat glass_surf::GausianBlur(cv::Mat image, double radius)
 {
     cv::Mat image_with_effect;
 
-    cv::GaussianBlur(image, image_with_effect, cv::Size(0, 0), radius);
+    GausianBlur(image, radius, image_with_effect);
 
     return image_with_effect;
 }
 
+void glass_surf::GausianBlur(const cv::Mat& image, double radius, cv::Mat& image_with_effect)
+{
+    GLASSSURF_TRACE_SCOPE("blur");
+    cv::GaussianBlur(image, image_with_effect, cv::Size(0, 0), radius);
+}
+
 cv::Mat glass_surf::CalculateLuminosity(cv::Mat& image)
 {
-    cv::Mat image_with_luminosity(image.rows, image.cols, CV_8UC1);
+    cv::Mat image_with_luminosity;
+
+    CalculateLuminosity(image, image_with_luminosity);
+
+    return image_with_luminosity;
+}
+
+void glass_surf::CalculateLuminosity(const cv::Mat& image, cv::Mat& image_with_luminosity)
+{
+    GLASSSURF_TRACE_SCOPE("luminosity");
+    image_with_luminosity.create(image.rows, image.cols, CV_8UC1);
 
     for (int i = 0; i < image.rows; ++i) {
         for (int j = 0; j < image.cols; ++j) {
@@ -51,13 +70,21 @@ cv::Mat glass_surf::CalculateLuminosity(cv::Mat& image)
             image_with_luminosity.at<uchar>(i, j) = luminosity;
         }
     }
-
-    return image_with_luminosity;
 }
 
 cv::Mat glass_surf::ApplyTintBlend(cv::Mat& image, RGB_Tint rgb_tint)
 {
-    cv::Mat tinted_image(image.rows, image.cols, CV_8UC3);
+    cv::Mat tinted_image;
+
+    ApplyTintBlend(image, rgb_tint, tinted_image);
+
+    return tinted_image;
+}
+
+void glass_surf::ApplyTintBlend(const cv::Mat& image, RGB_Tint rgb_tint, cv::Mat& tinted_image)
+{
+    GLASSSURF_TRACE_SCOPE("tint");
+    tinted_image.create(image.rows, image.cols, CV_8UC3);
 
     for (int i = 0; i < image.rows; ++i) {
         for (int j = 0; j < image.cols; ++j) {
@@ -71,8 +98,6 @@ cv::Mat glass_surf::ApplyTintBlend(cv::Mat& image, RGB_Tint rgb_tint)
             tinted_image.at<cv::Vec3b>(i, j) = intensity;
         }
     }
-
-    return tinted_image;
 }
 
 glass_surf::RGB_Tint glass_surf::HexStringToRGBTint(const std::string& hexColor)
@@ -100,47 +125,48 @@ glass_surf::RGB_Tint glass_surf::HexStringToRGBTint(const std::string& hexColor)
 }
 
 cv::Mat glass_surf::CropImage(const cv::Mat& image, int start_pos_x, int start_pos_y, int width, int height) {
+    GLASSSURF_TRACE_SCOPE("crop");
+
+    // Copy the region out of the image, so the crop outlives it
+    return CropImageView(image, start_pos_x, start_pos_y, width, height).clone();
+}
+
+cv::Mat glass_surf::CropImageView(const cv::Mat& image, int start_pos_x, int start_pos_y, int width, int height) {
     // Check if the input image is empty
     if (image.empty()) {
-        // Handle the case of an empty input image (optional)
-        // For example, you can return an empty matrix or throw an exception.
-        // Here, I'm returning an empty matrix.
         return cv::Mat();
     }
 
     // Ensure that the cropping region is within the image bounds
-    int max_width = std::min(width, image.cols - start_pos_x);
-    int max_height = std::min(height, image.rows - start_pos_y);
+    // (windows partly on another monitor can start at negative coordinates)
+    cv::Rect roi = cv::Rect(start_pos_x, start_pos_y, width, height) & cv::Rect(0, 0, image.cols, image.rows);
 
     // Check if the cropping region is valid
-    if (max_width <= 0 || max_height <= 0) {
-        // Handle invalid cropping parameters (optional)
-        // For example, you can return an empty matrix or throw an exception.
-        // Here, I'm returning an empty matrix.
+    if (roi.width <= 0 || roi.height <= 0) {
         return cv::Mat();
     }
 
-    // Create a Rect object representing the cropping region
-    cv::Rect roi(start_pos_x, start_pos_y, max_width, max_height);
+    return image(roi);
+}
 
-    // Crop the image using the region of interest (ROI)
-    cv::Mat croppedImage = image(roi).clone();
+cv::Mat glass_surf::CompressImage(const cv::Mat& image, int newWidth, int newHeight) {
+    cv::Mat compressed_image;
+    CompressImage(image, newWidth, newHeight, compressed_image);
 
-    return croppedImage;
+    return compressed_image;
 }
 
-cv::Mat glass_surf::CompressImage(const cv::Mat& image, int newWidth, int newHeight) {
+void glass_surf::CompressImage(const cv::Mat& image, int newWidth, int newHeight, cv::Mat& compressed_image) {
     // Check if the input image is empty
     if (image.empty()) {
         // Handle the case of an empty input image (optional)
         // For example, you can return an empty matrix or throw an exception.
         // Here, I'm returning an empty matrix.
         std::cerr << "Error: Input image is empty." << std::endl;
-        return cv::Mat();
+        compressed_image.release();
+        return;
     }
 
-    cv::Mat compressed_image;
+    GLASSSURF_TRACE_SCOPE("resize");
     cv::resize(image, compressed_image, cv::Size(newWidth, newHeight));
-
-    return compressed_image;
 }
@@ -45,6 +45,15 @@ namespace glass_surf {
 	 */
 	cv::Mat GausianBlur(cv::Mat image, double Radius);
 
+	/**
+	 * @brief Applies Gaussian blur to an input image, writing into a caller-owned buffer.
+	 *
+	 * @param image The input image.
+	 * @param radius The radius of the Gaussian blur.
+	 * @param image_with_effect The output image; reused if it already has the right size and type.
+	 */
+	void GausianBlur(const cv::Mat& image, double radius, cv::Mat& image_with_effect);
+
 	/**
 	 * @brief Calculates the luminosity of an input image using the formula: 0.299*R + 0.587*G + 0.114*B.
 	 *
@@ -53,6 +62,14 @@ namespace glass_surf {
 	 */
 	cv::Mat CalculateLuminosity(cv::Mat& image);
 
+	/**
+	 * @brief Calculates the luminosity of an input image, writing into a caller-owned buffer.
+	 *
+	 * @param image The input image.
+	 * @param image_with_luminosity The output CV_8UC1 image; reused if it already has the right size.
+	 */
+	void CalculateLuminosity(const cv::Mat& image, cv::Mat& image_with_luminosity);
+
 	/**
 	 * @brief Represents an RGB tint with individual color components.
 	 *
@@ -74,6 +91,15 @@ namespace glass_surf {
 	 */
 	cv::Mat ApplyTintBlend(cv::Mat& image, RGB_Tint rgb_tint);
 
+	/**
+	 * @brief Applies a tint to an input image, writing into a caller-owned buffer.
+	 *
+	 * @param image The input image.
+	 * @param rgb_tint An instance of the RGB_Tint struct containing tint values for red, green, and blue.
+	 * @param tinted_image The output image; reused if it already has the right size. May be `image`.
+	 */
+	void ApplyTintBlend(const cv::Mat& image, RGB_Tint rgb_tint, cv::Mat& tinted_image);
+
 	/**
 	 * @brief Converts a hex color string to an RGB_Tint struct.
 	 *
@@ -95,6 +121,22 @@ namespace glass_surf {
 	cv::Mat CropImage(const cv::Mat& image, 
 		int start_pos_x, int start_pos_y, int width, int height);
 
+	/**
+	 * @brief Returns a view of a region of an input image, without copying.
+	 *
+	 * The region is clipped to the image. The view shares the pixels (and stride) of
+	 * `image`, so it is only valid while `image` is alive and unchanged.
+	 *
+	 * @param image The input image.
+	 * @param start_pos_x The starting x-coordinate of the region.
+	 * @param start_pos_y The starting y-coordinate of the region.
+	 * @param width The width of the region.
+	 * @param height The height of the region.
+	 * @return A cv::Mat header pointing at the region, or an empty matrix if it is outside the image.
+	 */
+	cv::Mat CropImageView(const cv::Mat& image,
+		int start_pos_x, int start_pos_y, int width, int height);
+
 	/**
 	 * @brief Resizes an input image to a new resolution.
 	 *
@@ -104,6 +146,16 @@ namespace glass_surf {
 	 * @return A cv::Mat containing the resized image.
 	 */
 	cv::Mat CompressImage(const cv::Mat& image, int newWidth, int newHeight);
+
+	/**
+	 * @brief Resizes an input image to a new resolution, writing into a caller-owned buffer.
+	 *
+	 * @param image The input image to be resized.
+	 * @param newWidth The new width of the image.
+	 * @param newHeight The new height of the image.
+	 * @param compressed_image The output image; reused if it already has the right size and type.
+	 */
+	void CompressImage(const cv::Mat& image, int newWidth, int newHeight, cv::Mat& compressed_image);
 	
 } // namespace glass_surf
 
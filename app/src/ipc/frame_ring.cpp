@@ -0,0 +1,463 @@
+// ipc/frame_ring.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "frame_ring.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    constexpr size_t kAlignment = 64;
+    constexpr int kAcquireAttempts = 4;
+
+    size_t AlignUp(size_t value) {
+        return (value + kAlignment - 1) / kAlignment * kAlignment;
+    }
+
+    size_t BytesPerPixel(glass_surf::ipc::PixelFormat format) {
+        return format == glass_surf::ipc::PixelFormat::BGRA8 ? 4 : 3;
+    }
+
+    size_t SlotHeaderSize() {
+        return AlignUp(sizeof(glass_surf::ipc::FrameSlotHeader));
+    }
+
+    // True if every slot the header describes lies inside the mapping, so Acquire
+    // cannot read past it; the header comes from another process and may be anything
+    bool LayoutFits(const glass_surf::ipc::FrameRingHeader& header, size_t mapped_size) {
+        constexpr size_t slot_alignment = alignof(glass_surf::ipc::FrameSlotHeader);
+
+        if (header.slot_count == 0 || header.header_size < sizeof(header) || header.header_size > mapped_size
+            || header.header_size % slot_alignment != 0 || header.slot_stride % slot_alignment != 0) {
+            return false;
+        }
+
+        // Subtractions and a division, so huge values cannot overflow
+        if (header.slot_stride < SlotHeaderSize() || header.slot_stride - SlotHeaderSize() < header.slot_capacity) {
+            return false;
+        }
+
+        return (mapped_size - header.header_size) / header.slot_stride >= header.slot_count;
+    }
+
+    std::string PlatformName(const std::string& name) {
+#ifdef _WIN32
+        return name;
+#else
+        return name.empty() || name[0] == '/' ? name : "/" + name;
+#endif
+    }
+
+    uint32_t CurrentProcessId() {
+#ifdef _WIN32
+        return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+        return static_cast<uint32_t>(getpid());
+#endif
+    }
+
+#ifndef _WIN32
+    // True if `name` holds a frame ring whose writer process is gone. Anything else under
+    // that name (a live GlassSurf, another program's memory) must not be unlinked: its
+    // readers would keep the old mapping and never see our frames.
+    bool IsAbandonedRing(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(glass_surf::ipc::FrameRingHeader)) {
+            close(fd);
+            return false;
+        }
+
+        void* view = mmap(nullptr, sizeof(glass_surf::ipc::FrameRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+
+        auto* header = static_cast<const glass_surf::ipc::FrameRingHeader*>(view);
+        bool abandoned = false;
+        if (header->magic == glass_surf::ipc::kFrameRingMagic && header->version == glass_surf::ipc::kFrameRingVersion) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            pid_t owner = static_cast<pid_t>(header->owner_pid);
+            abandoned = owner > 0 && kill(owner, 0) != 0 && errno == ESRCH;
+        }
+        munmap(view, sizeof(glass_surf::ipc::FrameRingHeader));
+
+        return abandoned;
+    }
+#endif
+
+} // namespace
+
+glass_surf::ipc::SharedMemory::~SharedMemory() {
+    Close();
+}
+
+bool glass_surf::ipc::SharedMemory::Create(const std::string& name, size_t size) {
+    Close();
+
+    name_ = PlatformName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), name_.c_str());
+    if (mapping == nullptr) {
+        std::cerr << "Error: CreateFileMapping " << name_ << " failed (" << GetLastError() << ")." << std::endl;
+        return false;
+    }
+    // Named mappings go away with their last handle, so an existing one is in use
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        std::cerr << "Error: " << name_ << " is in use by another process." << std::endl;
+        CloseHandle(mapping);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (view == nullptr) {
+        std::cerr << "Error: MapViewOfFile " << name_ << " failed (" << GetLastError() << ")." << std::endl;
+        CloseHandle(mapping);
+        return false;
+    }
+
+    handle_ = mapping;
+#else
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    int error = errno;
+    if (fd < 0 && error == EEXIST && IsAbandonedRing(name_)) {
+        shm_unlink(name_.c_str());
+        fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        error = errno;
+    }
+    if (fd < 0) {
+        if (error == EEXIST) {
+            std::cerr << "Error: " << name_ << " is in use by another process." << std::endl;
+        }
+        else {
+            std::cerr << "Error: shm_open " << name_ << " failed." << std::endl;
+        }
+        return false;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        std::cerr << "Error: ftruncate " << name_ << " failed." << std::endl;
+        close(fd);
+        shm_unlink(name_.c_str());
+        return false;
+    }
+
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (view == MAP_FAILED) {
+        std::cerr << "Error: mmap " << name_ << " failed." << std::endl;
+        shm_unlink(name_.c_str());
+        return false;
+    }
+#endif
+
+    data_ = static_cast<uint8_t*>(view);
+    size_ = size;
+    owner_ = true;
+
+    return true;
+}
+
+bool glass_surf::ipc::SharedMemory::Open(const std::string& name) {
+    Close();
+
+    name_ = PlatformName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name_.c_str());
+    if (mapping == nullptr) {
+        return false;
+    }
+
+    // Map the header first to learn the full size; its fields are only trusted once the
+    // magic and version say it is a ring, and the size must not overflow
+    auto* header = static_cast<const FrameRingHeader*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(FrameRingHeader)));
+    if (header == nullptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    bool is_ring = header->magic == kFrameRingMagic && header->version == kFrameRingVersion;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t header_size = header->header_size;
+    uint64_t slot_stride = header->slot_stride;
+    uint64_t slot_count = header->slot_count;
+    UnmapViewOfFile(header);
+
+    constexpr uint64_t max_size = std::numeric_limits<size_t>::max();
+    if (!is_ring || slot_count == 0 || header_size > max_size || slot_stride > (max_size - header_size) / slot_count) {
+        CloseHandle(mapping);
+        return false;
+    }
+    size_t size = static_cast<size_t>(header_size + slot_stride * slot_count);
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    handle_ = mapping;
+#else
+    int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(file_stat.st_size);
+
+    void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (view == MAP_FAILED) {
+        return false;
+    }
+#endif
+
+    data_ = static_cast<uint8_t*>(view);
+    size_ = size;
+    owner_ = false;
+
+    return true;
+}
+
+void glass_surf::ipc::SharedMemory::Close() {
+    if (data_ == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(static_cast<HANDLE>(handle_));
+    handle_ = nullptr;
+#else
+    munmap(data_, size_);
+    if (owner_) {
+        shm_unlink(name_.c_str());
+    }
+#endif
+
+    data_ = nullptr;
+    size_ = 0;
+    owner_ = false;
+}
+
+bool glass_surf::ipc::FrameRingWriter::Create(const std::string& name, size_t slot_capacity, uint32_t slot_count) {
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+
+    header_ = nullptr;
+
+    if (slot_count == 0) {
+        return false;
+    }
+
+    size_t header_size = AlignUp(sizeof(FrameRingHeader));
+    size_t slot_stride = SlotHeaderSize() + AlignUp(slot_capacity);
+
+    if (!memory_.Create(name, header_size + slot_stride * slot_count)) {
+        return false;
+    }
+
+    uint8_t* base = memory_.data();
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        auto* slot = new (base + header_size + slot_stride * i) FrameSlotHeader{};
+        slot->sequence.store(0, std::memory_order_relaxed);
+    }
+
+    header_ = new (base) FrameRingHeader{};
+    header_->slot_count = slot_count;
+    header_->header_size = static_cast<uint32_t>(header_size);
+    header_->slot_capacity = slot_capacity;
+    header_->slot_stride = slot_stride;
+    header_->version = kFrameRingVersion;
+    header_->owner_pid = CurrentProcessId();
+    header_->latest_frame_id.store(0, std::memory_order_relaxed);
+
+    // Readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kFrameRingMagic;
+
+    return true;
+}
+
+uint64_t glass_surf::ipc::FrameRingWriter::Publish(const uint8_t* pixels, int width, int height, size_t stride,
+    PixelFormat format, FrameKind kind, int x, int y) {
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+
+    if (header_ == nullptr || pixels == nullptr || width <= 0 || height <= 0) {
+        return 0;
+    }
+
+    size_t row_bytes = static_cast<size_t>(width) * BytesPerPixel(format);
+    if (row_bytes * height > header_->slot_capacity) {
+        return 0;
+    }
+
+    uint64_t frame_id = next_frame_id_++;
+
+    uint8_t* slot_base = memory_.data() + header_->header_size + header_->slot_stride * (frame_id % header_->slot_count);
+    auto* slot = reinterpret_cast<FrameSlotHeader*>(slot_base);
+    uint8_t* slot_pixels = slot_base + SlotHeaderSize();
+
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frame_id = frame_id;
+    slot->timestamp_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    slot->kind = static_cast<uint32_t>(kind);
+    slot->format = static_cast<uint32_t>(format);
+    slot->x = x;
+    slot->y = y;
+    slot->width = width;
+    slot->height = height;
+    slot->stride = static_cast<uint32_t>(row_bytes);
+
+    for (int row = 0; row < height; ++row) {
+        std::memcpy(slot_pixels + row_bytes * row, pixels + stride * row, row_bytes);
+    }
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    header_->latest_frame_id.store(frame_id, std::memory_order_release);
+
+    return frame_id;
+}
+
+bool glass_surf::ipc::FrameRingReader::Open(const std::string& name) {
+    header_ = nullptr;
+
+    if (!memory_.Open(name)) {
+        return false;
+    }
+
+    auto* header = reinterpret_cast<const FrameRingHeader*>(memory_.data());
+    if (memory_.size() < sizeof(FrameRingHeader) || header->magic != kFrameRingMagic
+        || header->version != kFrameRingVersion) {
+        std::cerr << "Error: " << name << " is not a GlassSurf frame ring." << std::endl;
+        memory_.Close();
+        return false;
+    }
+    if (!LayoutFits(*header, memory_.size())) {
+        std::cerr << "Error: " << name << " has an invalid slot layout." << std::endl;
+        memory_.Close();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    header_ = header;
+    return true;
+}
+
+void glass_surf::ipc::FrameRingReader::Close() {
+    header_ = nullptr;
+    memory_.Close();
+}
+
+uint64_t glass_surf::ipc::FrameRingReader::LatestFrameId() const {
+    return header_ == nullptr ? 0 : header_->latest_frame_id.load(std::memory_order_acquire);
+}
+
+bool glass_surf::ipc::FrameRingReader::Acquire(FrameView& frame) const {
+    if (header_ == nullptr) {
+        return false;
+    }
+
+    for (int attempt = 0; attempt < kAcquireAttempts; ++attempt) {
+        uint64_t frame_id = header_->latest_frame_id.load(std::memory_order_acquire);
+        if (frame_id == 0) {
+            return false;
+        }
+
+        const uint8_t* slot_base = memory_.data() + header_->header_size
+            + header_->slot_stride * (frame_id % header_->slot_count);
+        auto* slot = reinterpret_cast<const FrameSlotHeader*>(slot_base);
+
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+
+        frame.pixels = slot_base + SlotHeaderSize();
+        frame.frame_id = slot->frame_id;
+        frame.timestamp_ns = slot->timestamp_ns;
+        frame.kind = static_cast<FrameKind>(slot->kind);
+        frame.format = static_cast<PixelFormat>(slot->format);
+        frame.x = slot->x;
+        frame.y = slot->y;
+        frame.width = slot->width;
+        frame.height = slot->height;
+        frame.stride = slot->stride;
+        frame.slot = slot;
+        frame.sequence = sequence;
+
+        // Fields read while the slot was being rewritten can be garbage; Validate catches
+        // that, but never let them point outside the slot in the meantime
+        if (frame.stride * static_cast<uint64_t>(frame.height) > header_->slot_capacity) {
+            continue;
+        }
+
+        if (Validate(frame)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool glass_surf::ipc::FrameRingReader::Validate(const FrameView& frame) const {
+    if (frame.slot == nullptr) {
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return frame.slot->sequence.load(std::memory_order_relaxed) == frame.sequence;
+}
+
+bool glass_surf::ipc::FrameRingReader::CopyLatest(FrameView& frame, std::vector<uint8_t>& pixels) const {
+    for (int attempt = 0; attempt < kAcquireAttempts; ++attempt) {
+        if (!Acquire(frame)) {
+            return false;
+        }
+
+        pixels.resize(frame.stride * frame.height);
+        std::memcpy(pixels.data(), frame.pixels, pixels.size());
+
+        if (Validate(frame)) {
+            frame.pixels = pixels.data();
+            return true;
+        }
+    }
+
+    return false;
+}
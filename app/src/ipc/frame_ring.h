@@ -0,0 +1,194 @@
+// ipc/frame_ring.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef FRAME_RING_H_
+#define FRAME_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace glass_surf::ipc {
+
+	// Shared memory layout
+	// -----------------------------------------------------
+	// [FrameRingHeader][slot 0][slot 1]...[slot N-1]
+	// Each slot is [FrameSlotHeader][pixels], 64-byte aligned, slot_stride bytes apart.
+	//
+	// Every slot is guarded by a seqlock: the writer makes `sequence` odd, writes the
+	// slot and makes it even again. A reader that sees the same even value before and
+	// after reading got a consistent frame. Frame n lives in slot n % slot_count, so a
+	// zero-copy reader has slot_count - 1 frames of time before its slot is reused.
+
+	constexpr uint32_t kFrameRingMagic = 0x52465347; // "GSFR"
+	constexpr uint32_t kFrameRingVersion = 2;
+
+	enum class PixelFormat : uint32_t {
+		BGR8 = 1,
+		BGRA8 = 2,
+	};
+
+	enum class FrameKind : uint32_t {
+		SURFACE = 1, // The whole processed surface
+		CROP = 2,    // A window-sized crop, x/y are its position on the surface
+	};
+
+	struct FrameRingHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slot_count;
+		uint32_t header_size;
+		uint32_t owner_pid;     // Writer process, so a ring left by a crashed writer can be replaced
+		uint32_t reserved;
+		uint64_t slot_capacity; // Pixel bytes available per slot
+		uint64_t slot_stride;   // Bytes from one slot to the next
+		std::atomic<uint64_t> latest_frame_id; // 0 = nothing published yet
+	};
+
+	struct FrameSlotHeader {
+		std::atomic<uint64_t> sequence;
+		uint64_t frame_id;
+		uint64_t timestamp_ns; // steady clock
+		uint32_t kind;
+		uint32_t format;
+		int32_t x, y;
+		int32_t width, height;
+		uint32_t stride;       // Bytes per pixel row
+		uint32_t reserved;
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free,
+		"the frame ring needs address-free 64-bit atomics");
+
+	/**
+	 * @brief A frame read from the ring.
+	 *
+	 * For FrameRingReader::Acquire, `pixels` points into the shared mapping and stays
+	 * valid only until FrameRingReader::Validate returns false.
+	 */
+	struct FrameView {
+		const uint8_t* pixels = nullptr;
+		uint64_t frame_id = 0;
+		uint64_t timestamp_ns = 0;
+		FrameKind kind = FrameKind::SURFACE;
+		PixelFormat format = PixelFormat::BGR8;
+		int x = 0, y = 0;
+		int width = 0, height = 0;
+		size_t stride = 0;
+
+		const FrameSlotHeader* slot = nullptr;
+		uint64_t sequence = 0;
+	};
+
+	/**
+	 * @brief Owns a named shared memory region and maps it into the process.
+	 */
+	class SharedMemory {
+	public:
+		SharedMemory() = default;
+		~SharedMemory();
+
+		SharedMemory(const SharedMemory&) = delete;
+		SharedMemory& operator=(const SharedMemory&) = delete;
+
+		bool Create(const std::string& name, size_t size);
+		bool Open(const std::string& name);
+		void Close();
+
+		uint8_t* data() const { return data_; }
+		size_t size() const { return size_; }
+
+	private:
+		std::string name_;
+		uint8_t* data_ = nullptr;
+		size_t size_ = 0;
+		bool owner_ = false;
+		void* handle_ = nullptr; // HANDLE on Windows, unused elsewhere
+	};
+
+	/**
+	 * @brief Publishes raw frames into a named shared memory ring.
+	 */
+	class FrameRingWriter {
+	public:
+		/**
+		 * @brief Creates the ring.
+		 *
+		 * Fails if a ring of that name is in use by another process; a ring left behind by
+		 * a writer that exited without removing it is replaced.
+		 *
+		 * @param name Shared memory name; a leading '/' is added on POSIX if missing.
+		 * @param slot_capacity Largest frame in bytes (height * stride) the ring accepts.
+		 * @param slot_count Number of slots.
+		 * @return True if the ring was created and mapped.
+		 */
+		bool Create(const std::string& name, size_t slot_capacity, uint32_t slot_count = 3);
+
+		/**
+		 * @brief Copies a frame into the next slot and publishes it.
+		 *
+		 * @param pixels First pixel row.
+		 * @param stride Bytes between rows in `pixels`.
+		 * @return The frame id, or 0 if the ring is closed or the frame does not fit.
+		 */
+		uint64_t Publish(const uint8_t* pixels, int width, int height, size_t stride,
+			PixelFormat format, FrameKind kind, int x = 0, int y = 0);
+
+		bool IsOpen() const { return header_ != nullptr; }
+
+	private:
+		SharedMemory memory_;
+		FrameRingHeader* header_ = nullptr;
+		uint64_t next_frame_id_ = 1;
+		std::mutex publish_mutex_;
+	};
+
+	/**
+	 * @brief Maps an existing ring and reads the latest frame.
+	 *
+	 * Only depends on the C++ standard library and the OS, so native consumers can
+	 * link it without OpenCV.
+	 */
+	class FrameRingReader {
+	public:
+		bool Open(const std::string& name);
+		void Close();
+
+		/**
+		 * @brief Points `frame` at the latest complete frame without copying.
+		 *
+		 * @return False if nothing was published yet or the writer kept overwriting the slot.
+		 */
+		bool Acquire(FrameView& frame) const;
+
+		/**
+		 * @brief Returns true if the slot behind `frame` was not overwritten since Acquire.
+		 *
+		 * Call it after consuming the pixels; on false, discard what was read.
+		 */
+		bool Validate(const FrameView& frame) const;
+
+		/**
+		 * @brief Copies the latest frame into `pixels` (rows packed with `frame.stride`).
+		 */
+		bool CopyLatest(FrameView& frame, std::vector<uint8_t>& pixels) const;
+
+		/**
+		 * @brief Returns the id of the latest published frame, 0 if none.
+		 */
+		uint64_t LatestFrameId() const;
+
+	private:
+		SharedMemory memory_;
+		const FrameRingHeader* header_ = nullptr;
+	};
+
+} // namespace glass_surf::ipc
+
+#endif // !FRAME_RING_H_
@@ -0,0 +1,125 @@
+// linear_light.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "linear_light.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include "tracer.h"
+
+namespace {
+
+    constexpr int kLinearToSrgbBits = 12;
+    constexpr int kLinearToSrgbShift = 16 - kLinearToSrgbBits;
+
+    double SrgbToLinear(double value) {
+        return value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+    }
+
+    double LinearToSrgb(double value) {
+        return value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+    }
+
+    // 256 x CV_16U, sRGB code -> linear
+    const cv::Mat& SrgbToLinearTable() {
+        static const cv::Mat table = [] {
+            cv::Mat lut(1, 256, CV_16UC1);
+            for (int i = 0; i < 256; ++i) {
+                lut.at<ushort>(0, i) = static_cast<ushort>(std::lround(SrgbToLinear(i / 255.0) * 65535.0));
+            }
+            return lut;
+        }();
+
+        return table;
+    }
+
+    // linear >> 4 -> sRGB code, sampled at the center of each bucket
+    const std::array<uchar, 1 << kLinearToSrgbBits>& LinearToSrgbTable() {
+        static const std::array<uchar, 1 << kLinearToSrgbBits> table = [] {
+            std::array<uchar, 1 << kLinearToSrgbBits> lut{};
+            for (size_t i = 0; i < lut.size(); ++i) {
+                double linear = ((i << kLinearToSrgbShift) + (1 << (kLinearToSrgbShift - 1))) / 65535.0;
+                lut[i] = static_cast<uchar>(std::lround(std::min(LinearToSrgb(linear), 1.0) * 255.0));
+            }
+            return lut;
+        }();
+
+        return table;
+    }
+
+} // namespace
+
+cv::Mat glass_surf::ToLinearLight(const cv::Mat& image) {
+    cv::Mat linear_image;
+    ToLinearLight(image, linear_image);
+
+    return linear_image;
+}
+
+void glass_surf::ToLinearLight(const cv::Mat& image, cv::Mat& linear_image) {
+    GLASSSURF_TRACE_SCOPE("to linear");
+    cv::LUT(image, SrgbToLinearTable(), linear_image);
+}
+
+cv::Mat glass_surf::FromLinearLight(const cv::Mat& linear_image) {
+    cv::Mat srgb_image;
+    FromLinearLight(linear_image, srgb_image);
+
+    return srgb_image;
+}
+
+void glass_surf::FromLinearLight(const cv::Mat& linear_image, cv::Mat& srgb_image) {
+    GLASSSURF_TRACE_SCOPE("from linear");
+    srgb_image.create(linear_image.rows, linear_image.cols, CV_8UC3);
+
+    const auto& lut = LinearToSrgbTable();
+    const int row_length = linear_image.cols * 3;
+
+    for (int i = 0; i < linear_image.rows; ++i) {
+        const ushort* src = linear_image.ptr<ushort>(i);
+        uchar* dst = srgb_image.ptr<uchar>(i);
+
+        for (int j = 0; j < row_length; ++j) {
+            dst[j] = lut[src[j] >> kLinearToSrgbShift];
+        }
+    }
+}
+
+cv::Mat glass_surf::ApplyTintBlendLinear(const cv::Mat& linear_image, RGB_Tint rgb_tint)
+{
+    cv::Mat tinted_image;
+    ApplyTintBlendLinear(linear_image, rgb_tint, tinted_image);
+
+    return tinted_image;
+}
+
+void glass_surf::ApplyTintBlendLinear(const cv::Mat& linear_image, RGB_Tint rgb_tint, cv::Mat& tinted_image)
+{
+    GLASSSURF_TRACE_SCOPE("tint (linear)");
+    tinted_image.create(linear_image.rows, linear_image.cols, CV_16UC3);
+
+    // Linear tint factors in 0..65535, multiplied as (value * factor + round) >> 16
+    const cv::Mat& to_linear = SrgbToLinearTable();
+    const uint32_t factors[3] = {
+        to_linear.at<ushort>(0, rgb_tint.blue),
+        to_linear.at<ushort>(0, rgb_tint.green),
+        to_linear.at<ushort>(0, rgb_tint.red),
+    };
+
+    for (int i = 0; i < linear_image.rows; ++i) {
+        const ushort* src = linear_image.ptr<ushort>(i);
+        ushort* dst = tinted_image.ptr<ushort>(i);
+
+        for (int j = 0; j < linear_image.cols; ++j) {
+            dst[3 * j + 0] = static_cast<ushort>((src[3 * j + 0] * factors[0] + 32768u) >> 16);
+            dst[3 * j + 1] = static_cast<ushort>((src[3 * j + 1] * factors[1] + 32768u) >> 16);
+            dst[3 * j + 2] = static_cast<ushort>((src[3 * j + 2] * factors[2] + 32768u) >> 16);
+        }
+    }
+}
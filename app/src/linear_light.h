@@ -0,0 +1,56 @@
+// linear_light.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef LINEAR_LIGHT_H_
+#define LINEAR_LIGHT_H_
+
+#include <opencv2/opencv.hpp>
+
+#include "image_utilities.h"
+
+namespace glass_surf {
+
+	/**
+	 * @brief Converts an 8-bit sRGB image to 16-bit fixed-point linear light.
+	 *
+	 * The conversion is a single 256-entry table lookup per channel (cv::LUT).
+	 * The overloads taking an output buffer reuse it when it already has the right size.
+	 *
+	 * @param image The input CV_8UC3 image in sRGB.
+	 * @return A CV_16UC3 image where 0..65535 maps to linear 0.0..1.0.
+	 */
+	cv::Mat ToLinearLight(const cv::Mat& image);
+	void ToLinearLight(const cv::Mat& image, cv::Mat& linear_image);
+
+	/**
+	 * @brief Converts a 16-bit linear-light image back to 8-bit sRGB.
+	 *
+	 * Uses a 4096-entry table indexed by the top 12 bits of each value, which
+	 * round-trips every 8-bit sRGB code exactly.
+	 *
+	 * @param linear_image The input CV_16UC3 linear-light image.
+	 * @return A CV_8UC3 image in sRGB.
+	 */
+	cv::Mat FromLinearLight(const cv::Mat& linear_image);
+	void FromLinearLight(const cv::Mat& linear_image, cv::Mat& srgb_image);
+
+	/**
+	 * @brief Applies a multiplicative tint to a linear-light image.
+	 *
+	 * The tint color is converted to linear light as well, so the result matches
+	 * a physically correct multiply. The inner loop is 16x16->32 bit fixed-point
+	 * arithmetic that compilers vectorize.
+	 *
+	 * @param linear_image The input CV_16UC3 linear-light image.
+	 * @param rgb_tint The tint color in sRGB.
+	 * @return A CV_16UC3 image containing the tinted image.
+	 */
+	cv::Mat ApplyTintBlendLinear(const cv::Mat& linear_image, RGB_Tint rgb_tint);
+	void ApplyTintBlendLinear(const cv::Mat& linear_image, RGB_Tint rgb_tint, cv::Mat& tinted_image);
+
+} // namespace glass_surf
+
+#endif // !LINEAR_LIGHT_H_
@@ -0,0 +1,99 @@
+// luminosity_index.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "luminosity_index.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "image_utilities.h"
+
+glass_surf::LuminosityIndex::LuminosityIndex(const cv::Mat& surface, int scale)
+    : scale_(std::max(scale, 1)) {
+    Build(surface);
+}
+
+void glass_surf::LuminosityIndex::Build(const cv::Mat& surface, cv::Size surface_size) {
+    if (surface.empty()) {
+        sum_.release();
+        sqsum_.release();
+        return;
+    }
+
+    surface_size_ = surface_size.empty() ? surface.size() : surface_size;
+
+    cv::resize(surface, reduced_surface_,
+        cv::Size((surface_size_.width + scale_ - 1) / scale_, (surface_size_.height + scale_ - 1) / scale_),
+        0, 0, cv::INTER_AREA);
+
+    glass_surf::CalculateLuminosity(reduced_surface_, luminosity_);
+
+    cv::integral(luminosity_, sum_, sqsum_, CV_32S, CV_64F);
+}
+
+void glass_surf::LuminosityIndex::ReleaseScratch() {
+    reduced_surface_.release();
+    luminosity_.release();
+}
+
+bool glass_surf::LuminosityIndex::empty() const {
+    return sum_.empty();
+}
+
+glass_surf::LuminosityStats glass_surf::LuminosityIndex::Query(const cv::Rect& region) const {
+    if (empty()) {
+        return LuminosityStats{ 0.0, 0.0 };
+    }
+
+    cv::Rect clipped = region & cv::Rect(0, 0, surface_size_.width, surface_size_.height);
+    if (clipped.width <= 0 || clipped.height <= 0) {
+        return LuminosityStats{ 0.0, 0.0 };
+    }
+
+    // Map the rectangle onto the reduced grid, rounding outwards
+    int x0 = clipped.x / scale_;
+    int y0 = clipped.y / scale_;
+    int x1 = std::min((clipped.x + clipped.width + scale_ - 1) / scale_, sum_.cols - 1);
+    int y1 = std::min((clipped.y + clipped.height + scale_ - 1) / scale_, sum_.rows - 1);
+
+    double count = static_cast<double>(x1 - x0) * (y1 - y0);
+
+    double sum = static_cast<double>(sum_.at<int>(y1, x1)) - sum_.at<int>(y0, x1)
+        - sum_.at<int>(y1, x0) + sum_.at<int>(y0, x0);
+    double sqsum = sqsum_.at<double>(y1, x1) - sqsum_.at<double>(y0, x1)
+        - sqsum_.at<double>(y1, x0) + sqsum_.at<double>(y0, x0);
+
+    double mean = sum / count;
+    double variance = std::max(sqsum / count - mean * mean, 0.0);
+
+    return LuminosityStats{ mean, variance };
+}
+
+std::vector<glass_surf::LuminosityStats> glass_surf::LuminosityIndex::QueryGrid(const cv::Rect& region,
+    int rows, int cols) const {
+    std::vector<LuminosityStats> cells;
+
+    if (rows <= 0 || cols <= 0) {
+        return cells;
+    }
+
+    cells.reserve(static_cast<size_t>(rows) * cols);
+
+    // In 64 bits: region.height * rows may not fit an int
+    for (int r = 0; r < rows; ++r) {
+        int cell_y0 = region.y + static_cast<int>(int64_t{ region.height } * r / rows);
+        int cell_y1 = region.y + static_cast<int>(int64_t{ region.height } * (r + 1) / rows);
+
+        for (int c = 0; c < cols; ++c) {
+            int cell_x0 = region.x + static_cast<int>(int64_t{ region.width } * c / cols);
+            int cell_x1 = region.x + static_cast<int>(int64_t{ region.width } * (c + 1) / cols);
+
+            cells.push_back(Query(cv::Rect(cell_x0, cell_y0, cell_x1 - cell_x0, cell_y1 - cell_y0)));
+        }
+    }
+
+    return cells;
+}
@@ -0,0 +1,103 @@
+// luminosity_index.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef LUMINOSITY_INDEX_H_
+#define LUMINOSITY_INDEX_H_
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief Mean and variance of the luminosity (0..255) inside a region.
+	 */
+	struct LuminosityStats {
+		double mean;
+		double variance;
+	};
+
+	/**
+	 * @brief Summed-area tables over the luminosity of a processed surface.
+	 *
+	 * The index stores the integral of the luminosity and of its square, so the
+	 * mean and variance of any rectangle are answered with four lookups each,
+	 * independent of the rectangle size.
+	 *
+	 * The tables are built on a surface reduced by `scale` (INTER_AREA). The
+	 * surface is already blurred, so this loses almost nothing and keeps the
+	 * index small (about 6 MB for a 4K surface at the default scale).
+	 */
+	class LuminosityIndex {
+	public:
+		static constexpr int kDefaultScale = 4;
+
+		LuminosityIndex() = default;
+
+		/**
+		 * @brief Builds the index from a BGR surface.
+		 *
+		 * @param surface The processed (blurred) BGR surface.
+		 * @param scale Reduction factor of the tables relative to the surface.
+		 */
+		explicit LuminosityIndex(const cv::Mat& surface, int scale = kDefaultScale);
+
+		/**
+		 * @brief Rebuilds the index from a new surface, reusing the tables if the size is unchanged.
+		 *
+		 * @param surface The processed (blurred) BGR surface.
+		 * @param surface_size Resolution the surface stands for, if it was rendered
+		 * smaller (SurfaceStorage::HALF); empty means the size of `surface`.
+		 */
+		void Build(const cv::Mat& surface, cv::Size surface_size = cv::Size());
+
+		/**
+		 * @brief Frees the buffers kept for the next Build; the tables stay.
+		 */
+		void ReleaseScratch();
+
+		/**
+		 * @brief Returns true if the index was not built from a surface.
+		 */
+		bool empty() const;
+
+		/**
+		 * @brief Returns the luminosity statistics of a rectangle in surface coordinates.
+		 *
+		 * The rectangle is clipped to the surface; an empty intersection yields {0, 0}.
+		 *
+		 * @param region The rectangle in surface pixel coordinates.
+		 * @return The mean and variance of the luminosity inside the rectangle.
+		 */
+		LuminosityStats Query(const cv::Rect& region) const;
+
+		/**
+		 * @brief Splits a rectangle into a rows x cols grid and queries each cell.
+		 *
+		 * @param region The rectangle in surface pixel coordinates.
+		 * @param rows Number of grid rows.
+		 * @param cols Number of grid columns.
+		 * @return The statistics of each cell in row-major order.
+		 */
+		std::vector<LuminosityStats> QueryGrid(const cv::Rect& region, int rows, int cols) const;
+
+	private:
+		int scale_ = kDefaultScale;
+		cv::Size surface_size_;
+
+		// Scratch buffers kept between builds
+		cv::Mat reduced_surface_;
+		cv::Mat luminosity_;
+
+		// (h+1)x(w+1) tables from cv::integral.
+		cv::Mat sum_;   // CV_32S
+		cv::Mat sqsum_; // CV_64F
+	};
+
+} // namespace glass_surf
+
+#endif // !LUMINOSITY_INDEX_H_
@@ -14,12 +14,33 @@
 #endif
 
 #include "settings/settings_manager.h"
+#include "ipc/frame_ring.h"
+#include "allocation_counter.h"
+#include "background_cache.h"
 #include "image_utilities.h"
+#include "frame_source.h"
+#include "geometry_source.h"
+#include "geometry_trace.h"
+#include "http_utilities.h"
+#include "pipeline.h"
+#include "png_encoder.h"
+#include "profile_surfaces.h"
+#include "streaming_server.h"
+#include "surface.h"
+#include "tracer.h"
+#include "wallpaper_watcher.h"
 #include "arguments.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+
 #define __PROGRAM_NAME__ "GlassSurf"
 #define __PROGRAM_VERSION__ "1.0.0 (Beta)"
 #define __PROGRAM_PORT__ 3040
+#define __PROGRAM_STREAM_PORT__ 3041
 
 const std::string default_config_file_name = "config.json";
 
@@ -30,6 +51,12 @@ bool fileExists(const std::string& filename) {
 
 int main(int argc, char const *argv[]) {
 
+    // Startup milestones are reported relative to this
+    const auto start_time = std::chrono::steady_clock::now();
+
+    // Before any cv::Mat exists; a no-op unless allocations are counted
+    glass_surf::InstallMatAllocationHook();
+
     // Argument Parsing
     argparse::ArgumentParser argv_parser(__PROGRAM_NAME__, __PROGRAM_VERSION__);
     glass_surf::arguments::RegistryArguments(argv_parser);
@@ -52,6 +79,51 @@ int main(int argc, char const *argv[]) {
         config_file_path = argv_parser.get<std::string>("--config");
     }
 
+    // Offline rendering instead of the server
+    if (argv_parser.is_subcommand_used(glass_surf::arguments::RenderCommand())) {
+        glass_surf::BatchRenderOptions render_options;
+        if (!glass_surf::arguments::ReadRenderOptions(config_file_path, render_options)) {
+            return 1;
+        }
+
+        return glass_surf::RunBatchRender(render_options);
+    }
+
+    // Load generation against a server started separately
+    if (argv_parser.is_subcommand_used(glass_surf::arguments::ReplayCommand())) {
+        glass_surf::TraceReplayOptions replay_options;
+        glass_surf::arguments::ReadReplayOptions(replay_options);
+        replay_options.port = __PROGRAM_PORT__;
+        replay_options.stream_port = __PROGRAM_STREAM_PORT__;
+
+        return glass_surf::RunTraceReplay(replay_options);
+    }
+
+    // Many user sessions in one process
+    if (argv_parser.is_subcommand_used(glass_surf::arguments::DaemonCommand())) {
+        glass_surf::SessionDaemonOptions daemon_options;
+        glass_surf::arguments::ReadDaemonOptions(daemon_options);
+        daemon_options.config_path = config_file_path;
+        daemon_options.port = __PROGRAM_PORT__;
+        daemon_options.stream_port = __PROGRAM_STREAM_PORT__;
+
+        return glass_surf::RunSessionDaemon(daemon_options);
+    }
+
+    // A user's session on a daemon
+    if (argv_parser.is_subcommand_used(glass_surf::arguments::AgentCommand())) {
+        glass_surf::SessionAgentOptions agent_options;
+        glass_surf::arguments::ReadAgentOptions(agent_options);
+        agent_options.config_path = config_file_path;
+        agent_options.port = __PROGRAM_PORT__;
+        if (!glass_surf::ParseResolution(argv_parser.get<std::string>("--screen"), agent_options.screen)) {
+            std::cerr << "[ERROR]: Invalid --screen, expected WIDTHxHEIGHT" << std::endl;
+            return 1;
+        }
+
+        return glass_surf::RunSessionAgent(agent_options);
+    }
+
     // Read Settings file
     if (!fileExists(config_file_path)) {
         glass_surf::settings::Settings tmp_settings;
@@ -62,92 +134,210 @@ int main(int argc, char const *argv[]) {
     std::cout << "Configuration file loaded!" << std::endl;
     glass_surf::settings::PrintSettings(settings);
 
-    #ifdef _WIN32
+    auto log_startup_milestone = [start_time](const std::string& milestone) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time);
+        std::cout << "[STARTUP]: " << milestone << " after " << elapsed.count() << " ms" << std::endl;
+    };
 
-    // Read Desktop Background Image Path
-    std::wstring desktop_background_image_path_wstring = glass_surf::win::GetDesktopWallPaperPath();
-    std::string desktop_background_image_path_string = std::string(
-        desktop_background_image_path_wstring.begin(), desktop_background_image_path_wstring.end());
+    // A configured wallpaper (file, slideshow directory or animation) overrides the desktop one
+    auto read_wallpaper_path = [&settings]() {
+        if (!settings.wallpaper.empty()) {
+            return settings.wallpaper;
+        }
+
+        #ifdef _WIN32
+        // Read Desktop Background Image Path
+        std::wstring desktop_background_image_path_wstring = glass_surf::win::GetDesktopWallPaperPath();
+        return std::string(desktop_background_image_path_wstring.begin(), desktop_background_image_path_wstring.end());
+        #else
+        return std::string();
+        #endif
+    };
+
+    std::string wallpaper_path = read_wallpaper_path();
 
-    std::cout << "Desktop Background Image Path: " << desktop_background_image_path_string << std::endl;
+    std::cout << "Desktop Background Image Path: " << wallpaper_path << std::endl;
+    if (wallpaper_path.empty()) {
+        std::cerr << "[ERROR]: No wallpaper to render; set \"wallpaper\" in the config file" << std::endl;
+    }
     
     // Get Screen Resolution
     int screen_width, screen_height;
+    #ifdef _WIN32
     glass_surf::win::GetDesktopResolution(screen_width, screen_height);
+    #else
+    cv::Size screen_size;
+    if (!glass_surf::ParseResolution(argv_parser.get<std::string>("--screen"), screen_size)) {
+        std::cerr << "[ERROR]: Invalid --screen, expected WIDTHxHEIGHT" << std::endl;
+        return 1;
+    }
+    screen_width = screen_size.width;
+    screen_height = screen_size.height;
+    #endif
 
     std::cout << "Screen Resolution: " << screen_width << "x" << screen_height << std::endl;
 
-    // Get HWND of Browser Window
-    HWND browser_window = glass_surf::win::FindWindowHandleByTitleSubstring(settings.browser);
+    // Browser window geometry: tracked on Windows, otherwise pushed through /geometry/
+    std::unique_ptr<glass_surf::GeometrySource> window_geometry;
+    glass_surf::PushedGeometrySource* pushed_geometry = nullptr;
+
+    #ifdef _WIN32
+    if (!argv_parser.get<bool>("--pushed-geometry")) {
+        // Get HWND of Browser Window
+        HWND browser_window = glass_surf::win::FindWindowHandleByTitleSubstring(settings.browser);
+        window_geometry = std::make_unique<glass_surf::BrowserWindowGeometrySource>(browser_window);
+    }
+    #endif
+
+    if (!window_geometry) {
+        auto pushed_geometry_source = std::make_unique<glass_surf::PushedGeometrySource>();
+        pushed_geometry = pushed_geometry_source.get();
+        window_geometry = std::move(pushed_geometry_source);
+    }
+
+    // Optional trace of what the server saw, for `replay`
+    glass_surf::GeometryTraceWriter trace_writer;
+    std::unique_ptr<glass_surf::RecordingGeometrySource> recording_geometry;
+    const std::string trace_path = argv_parser.get<std::string>("--record-trace");
+    if (!trace_path.empty() && trace_writer.Open(trace_path, screen_width, screen_height)) {
+        recording_geometry = std::make_unique<glass_surf::RecordingGeometrySource>(*window_geometry, trace_writer);
+        std::cout << "Recording trace: " << trace_path << std::endl;
+    }
+
+    glass_surf::GeometrySource& geometry_source = recording_geometry
+        ? static_cast<glass_surf::GeometrySource&>(*recording_geometry) : *window_geometry;
 
-    // dbi - desktop background image
-    cv::Mat dbi = glass_surf::ReadImage(desktop_background_image_path_string);
-    cv::Mat dbi_with_compress = glass_surf::CompressImage(dbi, screen_width, screen_height);
+    // Spans of the pipeline and of requests, written on exit
+    const std::string trace_events_path = argv_parser.get<std::string>("--trace-events");
+    if (!trace_events_path.empty()) {
+        glass_surf::StartTracing();
+        std::cout << "Recording trace events: " << trace_events_path << std::endl;
+    }
 
     std::cout << "---" << std::endl;
-    
-    cv::Mat dbi_with_tint_blend = dbi_with_compress;
-    if (settings.blendColor != "#000000") {
-        glass_surf::RGB_Tint tint_color = glass_surf::HexStringToRGBTint(settings.blendColor);
-        dbi_with_tint_blend = glass_surf::ApplyTintBlend(dbi_with_compress, tint_color);
+
+    // Processed surfaces: one published, one being rendered
+    glass_surf::SurfaceSwapChain swap_chain(cv::Size(screen_width, screen_height), settings.surfaceStorage);
+    glass_surf::PipelineOptions pipeline_options = glass_surf::MakePipelineOptions(settings, cv::Size(screen_width, screen_height));
+    glass_surf::SurfaceRenderer surface_renderer(swap_chain, pipeline_options);
+
+    // Profiles render from the resized frame of the published surface
+    surface_renderer.KeepResizedBase(!settings.profiles.empty());
+
+    // Requests get a solid placeholder until the renderer publishes a thumbnail, then
+    // the real surface; nothing is decoded before the server listens
+    swap_chain.Publish(glass_surf::MakePlaceholderSurface(pipeline_options));
+    log_startup_milestone("Placeholder surface ready");
+
+    // Raw frames for local consumers, published next to the HTTP API
+    glass_surf::ipc::FrameRingWriter frame_ring;
+    if (!settings.sharedMemoryName.empty()) {
+        frame_ring.Create(settings.sharedMemoryName, static_cast<size_t>(screen_width) * screen_height * 3);
     }
 
-    cv::Mat dbi_with_blur = glass_surf::GausianBlur(dbi_with_tint_blend, settings.blurRadius);
+    // Only full surfaces are BGR8 frames; compact ones still publish their (converted) crops
+    std::once_flag first_surface_flag;
+    surface_renderer.on_publish = [&frame_ring, &first_surface_flag, &log_startup_milestone](const glass_surf::Surface& surface) {
+        std::call_once(first_surface_flag, log_startup_milestone, "Surface ready");
+
+        if (frame_ring.IsOpen() && surface.storage == glass_surf::SurfaceStorage::FULL) {
+            frame_ring.Publish(surface.image.data, surface.image.cols, surface.image.rows, surface.image.step,
+                glass_surf::ipc::PixelFormat::BGR8, glass_surf::ipc::FrameKind::SURFACE);
+        }
+    };
+
+    // Re-render in the background when the wallpaper changes; requests keep using
+    // the old surface until the new one is published
+    auto slideshow_interval = std::chrono::milliseconds(static_cast<int64_t>(settings.slideshowInterval * 1000.0));
+    glass_surf::WallpaperWatcher wallpaper_watcher(read_wallpaper_path,
+        [&surface_renderer, slideshow_interval](const std::string& new_wallpaper_path) {
+            std::cout << "Wallpaper changed: " << new_wallpaper_path << std::endl;
+
+            surface_renderer.Start(glass_surf::CreateFrameSource(new_wallpaper_path, slideshow_interval));
+        });
 
     // Start API Server
     beauty::server http_server;
 
     // Running ...
-    glass_surf::win::WINDOW_INFO window_info = {0, 0, 0, 0, 0};
-    std::string response_img;
-
-    http_server.add_route("/bg/").get([browser_window, &dbi_with_blur, &window_info, &response_img](const auto& req, auto& res) {
-
-        // Set CORS headers
-        res.set_header(boost::beast::http::field::access_control_allow_origin, "*");
-        res.set_header(boost::beast::http::field::access_control_allow_methods, "GET, OPTIONS");
-        res.set_header(boost::beast::http::field::access_control_allow_headers, "Content-Type");
-        res.set_header(boost::beast::http::field::access_control_max_age, "3600");
+    glass_surf::BackgroundCache background_cache(swap_chain);
+
+    // Per-site variants, selected with the `profile` parameter of /bg/ and /state/
+    glass_surf::ProfileSurfaces profile_surfaces(swap_chain, settings, cv::Size(screen_width, screen_height),
+        static_cast<size_t>(settings.profileCacheMegabytes * 1024.0 * 1024.0));
+
+    // The cache of a profile; requests without a known profile get the default one (not owned)
+    auto profile_cache = [&background_cache, &profile_surfaces](const std::string& profile) {
+        std::shared_ptr<glass_surf::BackgroundCache> cache = profile.empty() ? nullptr : profile_surfaces.Cache(profile);
+        return cache ? cache : std::shared_ptr<glass_surf::BackgroundCache>(std::shared_ptr<void>(), &background_cache);
+    };
+
+    // Nothing is rendered while nobody can see the browser window; the polled
+    // routes notice when that changes
+    std::mutex visibility_mutex;
+    bool window_visible = true;
+    auto current_geometry = [&geometry_source, &surface_renderer, &visibility_mutex, &window_visible]() {
+        glass_surf::WindowGeometry geometry = geometry_source.Current();
+
+        std::lock_guard<std::mutex> lock(visibility_mutex);
+        if (geometry.visible() != window_visible) {
+            window_visible = geometry.visible();
+            surface_renderer.SetPaused(!window_visible);
+            std::cout << "Browser window " << glass_surf::VisibilityName(geometry.visibility)
+                << (window_visible ? ", rendering resumed" : ", rendering paused") << std::endl;
+        }
 
+        return geometry;
+    };
 
-        glass_surf::win::WINDOW_INFO tmp_browser_window_info = glass_surf::win::FindWindowInfoByHWND(browser_window);
+    background_cache.on_crop = [&frame_ring](const cv::Mat& crop, const glass_surf::WindowGeometry& geometry) {
+        if (frame_ring.IsOpen()) {
+            frame_ring.Publish(crop.data, crop.cols, crop.rows, crop.step,
+                glass_surf::ipc::PixelFormat::BGR8, glass_surf::ipc::FrameKind::CROP, geometry.x, geometry.y);
+        }
+    };
+
+    std::once_flag first_response_flag;
+    std::once_flag first_full_response_flag;
+    background_cache.on_encoded = [&first_response_flag, &first_full_response_flag, &log_startup_milestone](const glass_surf::Surface& surface) {
+        std::call_once(first_response_flag, log_startup_milestone, "First /bg/ response");
+        if (!surface.placeholder) {
+            std::call_once(first_full_response_flag, log_startup_milestone, "First /bg/ response from the full surface");
+        }
+    };
 
-        if (window_info.height != tmp_browser_window_info.height 
-        || window_info.width != tmp_browser_window_info.width 
-        || window_info.position_x != tmp_browser_window_info.position_x 
-        || window_info.position_y != tmp_browser_window_info.position_y) {
-            window_info = tmp_browser_window_info;
+    http_server.add_route("/bg/").get([&profile_cache, &current_geometry, &trace_writer](const auto& req, auto& res) {
 
-            cv::Mat result_image = glass_surf::CropImage(dbi_with_blur, tmp_browser_window_info.position_x, 
-            tmp_browser_window_info.position_y, tmp_browser_window_info.width, tmp_browser_window_info.height);
+        glass_surf::AllocationScope allocation_scope("/bg/");
+        GLASSSURF_TRACE_SCOPE("GET /bg/");
 
-            std::vector<uchar> img_buffer;
-            cv::imencode(".png", result_image, img_buffer);
+        glass_surf::SetCorsHeaders(res);
+        trace_writer.RecordRequest(glass_surf::TraceRecord::BACKGROUND_REQUEST);
 
-            response_img = std::string(img_buffer.begin(), img_buffer.end());
-        }
-        
         res.set_header(boost::beast::http::field::content_type, "image/png");
-        res.body() = response_img;
+        // The extension requests each image once, under its own URL, then shows it
+        // as the page background from the browser's cache
+        res.set_header(boost::beast::http::field::cache_control, "private, max-age=60");
+        profile_cache(req.a("profile").as_string())->Get(current_geometry(), res.body());
 
     });
 
-    http_server.add_route("/state/").get([browser_window, &window_info](const auto& req, auto& res) {
+    http_server.add_route("/state/").get([&profile_cache, &current_geometry, &trace_writer](const auto& req, auto& res) {
+
+        glass_surf::AllocationScope allocation_scope("/state/");
+        GLASSSURF_TRACE_SCOPE("GET /state/");
 
-        // Set CORS headers
-        res.set_header(boost::beast::http::field::access_control_allow_origin, "*");
-        res.set_header(boost::beast::http::field::access_control_allow_methods, "GET, OPTIONS");
-        res.set_header(boost::beast::http::field::access_control_allow_headers, "Content-Type");
-        res.set_header(boost::beast::http::field::access_control_max_age, "3600");
-        
-        glass_surf::win::WINDOW_INFO tmp_browser_window_info = glass_surf::win::FindWindowInfoByHWND(browser_window);
+        glass_surf::SetCorsHeaders(res);
+        trace_writer.RecordRequest(glass_surf::TraceRecord::STATE_REQUEST);
+
+        glass_surf::WindowGeometry geometry = current_geometry();
+        if (!geometry.visible()) {
+            res.set(glass_surf::kPollIntervalHeader, glass_surf::kHiddenPollInterval);
+        }
 
         // 0 = NOT CHANGED
-        // 1 = CHANGED
-        if (window_info.height != tmp_browser_window_info.height 
-        || window_info.width != tmp_browser_window_info.width 
-        || window_info.position_x != tmp_browser_window_info.position_x 
-        || window_info.position_y != tmp_browser_window_info.position_y) {
+        // 1 = CHANGED (window geometry or wallpaper frame)
+        if (profile_cache(req.a("profile").as_string())->IsStale(geometry)) {
             res.body() = "1";
         }
 
@@ -156,10 +346,201 @@ int main(int argc, char const *argv[]) {
         }
     });
 
+    // Mean and variance of the luminosity behind a rectangle of the browser window.
+    // Parameters (window coordinates, same space as the /bg/ image): x, y, width, height,
+    // and optionally rows, cols to split the rectangle into a grid of cells.
+    http_server.add_route("/contrast/").get([&geometry_source, &swap_chain, &trace_writer](const auto& req, auto& res) {
+
+        glass_surf::AllocationScope allocation_scope("/contrast/");
+        GLASSSURF_TRACE_SCOPE("GET /contrast/");
+
+        glass_surf::SetCorsHeaders(res);
+        trace_writer.RecordRequest(glass_surf::TraceRecord::CONTRAST_REQUEST);
+
+        glass_surf::WindowGeometry tmp_browser_window_info = geometry_source.Current();
+
+        // Any page can ask, so the rectangle is worked out in 64 bits and clipped to
+        // the screen before anything is split or summed
+        int64_t x = glass_surf::GetIntegerParameter(req, "x", 0);
+        int64_t y = glass_surf::GetIntegerParameter(req, "y", 0);
+        constexpr int kMissing = std::numeric_limits<int>::min();
+        int64_t width = glass_surf::GetIntegerParameter(req, "width", kMissing);
+        int64_t height = glass_surf::GetIntegerParameter(req, "height", kMissing);
+        if (width == kMissing) {
+            width = tmp_browser_window_info.width - x;
+        }
+        if (height == kMissing) {
+            height = tmp_browser_window_info.height - y;
+        }
+        int rows = std::clamp(glass_surf::GetIntegerParameter(req, "rows", 1), 1, 64);
+        int cols = std::clamp(glass_surf::GetIntegerParameter(req, "cols", 1), 1, 64);
+
+        nlohmann::json response_json;
+        response_json["rows"] = rows;
+        response_json["cols"] = cols;
+        response_json["cells"] = nlohmann::json::array();
+
+        std::shared_ptr<const glass_surf::Surface> surface = swap_chain.Current();
+        if (surface) {
+            const int64_t left = std::clamp<int64_t>(tmp_browser_window_info.x + x, 0, surface->size.width);
+            const int64_t top = std::clamp<int64_t>(tmp_browser_window_info.y + y, 0, surface->size.height);
+            const int64_t right = std::clamp<int64_t>(tmp_browser_window_info.x + x + width, left, surface->size.width);
+            const int64_t bottom = std::clamp<int64_t>(tmp_browser_window_info.y + y + height, top, surface->size.height);
+            cv::Rect region(static_cast<int>(left), static_cast<int>(top),
+                static_cast<int>(right - left), static_cast<int>(bottom - top));
+
+            for (const glass_surf::LuminosityStats& cell : surface->luminosity.QueryGrid(region, rows, cols)) {
+                response_json["cells"].push_back({ {"mean", cell.mean}, {"variance", cell.variance} });
+            }
+        }
+
+        res.set_header(boost::beast::http::field::content_type, "application/json");
+        res.body() = response_json.dump();
+    });
+
+    // Allocation counts per route and pipeline stage; all zero unless built with
+    // GLASSSURF_COUNT_ALLOCATIONS. For local tools only: no CORS headers, so pages
+    // cannot read it cross-origin, and only requests naming the loopback host.
+    http_server.add_route("/diagnostics/").get([&profile_surfaces](const auto& req, auto& res) {
+
+        if (!glass_surf::IsLoopbackHost(req)) {
+            res.result(boost::beast::http::status::forbidden);
+            return;
+        }
+
+        auto counts_json = [](const glass_surf::AllocationCounts& counts) {
+            return nlohmann::json{ {"allocations", counts.allocations}, {"bytes", counts.bytes},
+                {"mat_allocations", counts.mat_allocations}, {"mat_bytes", counts.mat_bytes} };
+        };
+
+        nlohmann::json response_json;
+        response_json["allocation_counting"] = glass_surf::AllocationCountingEnabled();
+        response_json["process"] = counts_json(glass_surf::ProcessAllocationCounts());
+        response_json["profile_surface_bytes"] = profile_surfaces.ByteSize();
+        response_json["scopes"] = nlohmann::json::object();
+
+        for (const glass_surf::AllocationScopeStats& stats : glass_surf::AllocationScopeSnapshot()) {
+            response_json["scopes"][stats.name] = { {"calls", stats.calls}, {"last", counts_json(stats.last)},
+                {"max", counts_json(stats.max)}, {"total", counts_json(stats.total)} };
+        }
+
+        res.set_header(boost::beast::http::field::content_type, "application/json");
+        res.body() = response_json.dump();
+    });
+
+    // Spans recorded so far as Chrome trace events (load into Perfetto). A PUT with
+    // enable=1 or enable=0 starts or stops recording; each thread that records then
+    // allocates its span buffer. Like /diagnostics/, for local tools only.
+    http_server.add_route("/trace/").get([](const auto& req, auto& res) {
+
+        if (!glass_surf::IsLoopbackHost(req)) {
+            res.result(boost::beast::http::status::forbidden);
+            return;
+        }
+
+        res.set_header(boost::beast::http::field::content_type, "application/json");
+        res.body() = glass_surf::TraceEventsJson();
+    }).put([](const auto& req, auto& res) {
+
+        if (!glass_surf::IsLoopbackHost(req)) {
+            res.result(boost::beast::http::status::forbidden);
+            return;
+        }
+
+        int enable = glass_surf::GetIntegerParameter(req, "enable", -1);
+        if (enable == 1) {
+            glass_surf::StartTracing();
+        }
+        else if (enable == 0) {
+            glass_surf::StopTracing();
+        }
+        else {
+            res.result(boost::beast::http::status::bad_request);
+            res.body() = "Expected enable=1 or enable=0";
+            return;
+        }
+
+        res.body() = "OK";
+    });
+
+    // The time to its first byte is a span on /trace/, and the first one a startup milestone
+    glass_surf::StreamingServer streaming_server;
+    std::once_flag first_stream_byte_flag;
+    streaming_server.AddRoute("/bg/", [&profile_cache, &current_geometry, &trace_writer, &first_stream_byte_flag,
+        &log_startup_milestone](glass_surf::ChunkedResponse& response) {
+        glass_surf::AllocationScope allocation_scope("/bg/ (stream)");
+        GLASSSURF_TRACE_SCOPE("GET /bg/ (stream)");
+        std::optional<glass_surf::TraceScope> first_byte_span(std::in_place, "GET /bg/ (stream) first byte");
+
+        trace_writer.RecordRequest(glass_surf::TraceRecord::BACKGROUND_STREAM_REQUEST);
+        response.SetHeader(boost::beast::http::field::access_control_allow_origin, "*");
+        response.SetHeader(boost::beast::http::field::content_type, "image/png");
+        response.SetHeader(boost::beast::http::field::cache_control, "private, max-age=60");
+
+        bool encoded = profile_cache(response.Parameter("profile"))->Stream(current_geometry(),
+            [&response, &first_byte_span, &first_stream_byte_flag, &log_startup_milestone](const uint8_t* data, size_t size) {
+            response.Write(data, size);
+
+            if (first_byte_span && response.header_sent()) {
+                first_byte_span.reset();
+                std::call_once(first_stream_byte_flag, log_startup_milestone, "First /bg/ stream byte sent");
+            }
+        });
+
+        if (!encoded) {
+            response.Abort();
+        }
+    });
+    streaming_server.Listen(__PROGRAM_STREAM_PORT__);
+
+    // Geometry set by the client, e.g. `replay` feeding a recorded trace.
+    // Parameters: x, y, width, height, visibility (a name such as "minimized");
+    // missing ones keep their value. It changes what every client is served, so
+    // it takes a PUT without CORS headers: pages cannot send one cross-origin.
+    if (pushed_geometry) {
+        http_server.add_route("/geometry/").put([pushed_geometry](const auto& req, auto& res) {
+
+            if (!glass_surf::IsLoopbackHost(req)) {
+                res.result(boost::beast::http::status::forbidden);
+                return;
+            }
+
+            glass_surf::WindowGeometry geometry = pushed_geometry->Current();
+            geometry.x = glass_surf::GetIntegerParameter(req, "x", geometry.x);
+            geometry.y = glass_surf::GetIntegerParameter(req, "y", geometry.y);
+            geometry.width = glass_surf::GetIntegerParameter(req, "width", geometry.width);
+            geometry.height = glass_surf::GetIntegerParameter(req, "height", geometry.height);
+
+            const std::string& visibility = req.a("visibility").as_string();
+            if (!visibility.empty() && !glass_surf::ParseVisibility(visibility, geometry.visibility)) {
+                res.result(boost::beast::http::status::bad_request);
+                res.body() = "Unknown visibility";
+                return;
+            }
+
+            pushed_geometry->Push(geometry);
+
+            res.body() = "OK";
+        });
+    }
+
     http_server.listen(__PROGRAM_PORT__);
+    log_startup_milestone("Listening");
+
+    // The pipeline runs while requests are already answered from the placeholder
+    surface_renderer.Start(glass_surf::CreateFrameSource(wallpaper_path, slideshow_interval), wallpaper_path);
+    wallpaper_watcher.Start();
+
     http_server.wait();
 
-    #endif // _WIN32
+    streaming_server.Stop();
+    wallpaper_watcher.Stop();
+    surface_renderer.Stop();
+    trace_writer.Close();
+
+    if (!trace_events_path.empty()) {
+        glass_surf::WriteTraceEvents(trace_events_path);
+    }
 
     return 0;
 }
@@ -0,0 +1,88 @@
+// noise_layer.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "noise_layer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+#include "tracer.h"
+
+void glass_surf::MakeNoiseTile(uint32_t seed, int amplitude, cv::Mat& tile) {
+    tile.create(kNoiseTileSize, kNoiseTileSize, CV_16SC1);
+
+    // Raw engine output only: the standard distributions differ between libraries
+    std::mt19937 engine(seed);
+    uint32_t range = static_cast<uint32_t>(amplitude) + 1;
+
+    for (int i = 0; i < tile.rows; ++i) {
+        short* row = tile.ptr<short>(i);
+        for (int j = 0; j < tile.cols; ++j) {
+            int first = static_cast<int>(engine() % range);
+            int second = static_cast<int>(engine() % range);
+            row[j] = static_cast<short>(first - second);
+        }
+    }
+}
+
+void glass_surf::NoiseLayer::Prepare(uint32_t seed, int amplitude, int width) {
+    if (seed == seed_ && amplitude == amplitude_ && (amplitude == 0 || lighten_.cols >= width)) {
+        return;
+    }
+
+    seed_ = seed;
+    amplitude_ = amplitude;
+    if (amplitude == 0) {
+        lighten_.release();
+        darken_.release();
+        return;
+    }
+
+    cv::Mat tile;
+    glass_surf::MakeNoiseTile(seed, amplitude, tile);
+
+    lighten_.create(kNoiseTileSize, width, CV_8UC3);
+    darken_.create(kNoiseTileSize, width, CV_8UC3);
+
+    for (int i = 0; i < kNoiseTileSize; ++i) {
+        const short* grain = tile.ptr<short>(i);
+        uchar* lighten = lighten_.ptr<uchar>(i);
+        uchar* darken = darken_.ptr<uchar>(i);
+
+        for (int j = 0; j < width; ++j) {
+            short value = grain[j % kNoiseTileSize];
+            uchar positive = static_cast<uchar>(std::max<short>(value, 0));
+            uchar negative = static_cast<uchar>(std::max<short>(static_cast<short>(-value), 0));
+
+            // Monochrome: the same grain on all channels
+            lighten[3 * j + 0] = lighten[3 * j + 1] = lighten[3 * j + 2] = positive;
+            darken[3 * j + 0] = darken[3 * j + 1] = darken[3 * j + 2] = negative;
+        }
+    }
+}
+
+void glass_surf::NoiseLayer::Composite(cv::Mat& image) const {
+    if (amplitude_ == 0 || image.empty()) {
+        return;
+    }
+
+    if (image.type() != CV_8UC3 || image.cols > lighten_.cols) {
+        std::cerr << "[ERROR]: The noise layer was not prepared for this image" << std::endl;
+        return;
+    }
+
+    GLASSSURF_TRACE_SCOPE("noise");
+
+    for (int y = 0; y < image.rows; y += kNoiseTileSize) {
+        int rows = std::min(kNoiseTileSize, image.rows - y);
+        cv::Mat band = image.rowRange(y, y + rows);
+
+        // OpenCV's 8-bit add and subtract saturate, with SIMD
+        cv::add(band, lighten_(cv::Rect(0, 0, image.cols, rows)), band);
+        cv::subtract(band, darken_(cv::Rect(0, 0, image.cols, rows)), band);
+    }
+}
@@ -0,0 +1,63 @@
+// noise_layer.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef NOISE_LAYER_H_
+#define NOISE_LAYER_H_
+
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief Width and height of the grain tile.
+	 */
+	constexpr int kNoiseTileSize = 64;
+
+	/**
+	 * @brief Fills a kNoiseTileSize square tile (CV_16SC1) with grain in -amplitude..amplitude.
+	 *
+	 * The values are the difference of two uniform draws (triangular, so small
+	 * values dominate) from std::mt19937, whose output is the same on every
+	 * platform; the same seed always gives the same tile. Uncorrelated noise
+	 * tiles without seams.
+	 */
+	void MakeNoiseTile(uint32_t seed, int amplitude, cv::Mat& tile);
+
+	/**
+	 * @brief A grain tile, repeated across the width of the surface and added to it.
+	 */
+	class NoiseLayer {
+	public:
+		/**
+		 * @brief Builds the layer for images up to `width` pixels wide; does nothing
+		 * if it already matches.
+		 */
+		void Prepare(uint32_t seed, int amplitude, int width);
+
+		/**
+		 * @brief Adds the grain to a BGR image in place, saturating at 0 and 255.
+		 *
+		 * Pixel (x, y) always gets tile pixel (x % size, y % size), so the grain is
+		 * part of the surface and crops of it stay valid. Runs as one vectorized
+		 * saturating add and subtract per band of tile rows; allocates nothing.
+		 */
+		void Composite(cv::Mat& image) const;
+
+	private:
+		uint32_t seed_ = 0;
+		int amplitude_ = 0;
+
+		// kNoiseTileSize rows of the tile repeated across the width, BGR: the
+		// positive grain (added) and the negative grain (subtracted)
+		cv::Mat lighten_;
+		cv::Mat darken_;
+	};
+
+} // namespace glass_surf
+
+#endif // !NOISE_LAYER_H_
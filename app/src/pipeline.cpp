@@ -0,0 +1,324 @@
+// pipeline.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "pipeline.h"
+
+#include <iostream>
+
+#include "allocation_counter.h"
+#include "linear_light.h"
+#include "thread_utilities.h"
+#include "tracer.h"
+
+namespace {
+
+    // Sources slower than this do not keep buffers between frames
+    constexpr std::chrono::milliseconds kKeepBuffersInterval(1000);
+
+    // Placeholders are rendered at 1/8 of the screen from an IMREAD_REDUCED_COLOR_8 decode
+    constexpr int kPlaceholderScale = 8;
+
+} // namespace
+
+glass_surf::PipelineOptions glass_surf::MakePipelineOptions(const settings::Settings& settings, cv::Size resolution) {
+    return glass_surf::MakePipelineOptions(settings, settings::BaseProfile(settings), resolution);
+}
+
+glass_surf::PipelineOptions glass_surf::MakePipelineOptions(const settings::Settings& settings,
+    const settings::Profile& profile, cv::Size resolution) {
+    PipelineOptions options;
+
+    options.resolution = resolution;
+    options.tint = profile.blendColor != "#000000";
+    if (options.tint) {
+        options.tint_color = glass_surf::HexStringToRGBTint(profile.blendColor);
+    }
+    options.blur_radius = profile.blurRadius;
+    options.linear_light = profile.linearLight;
+    options.theme = profile.theme;
+    options.noise_seed = profile.noiseSeed;
+    options.storage = settings.surfaceStorage;
+
+    return options;
+}
+
+glass_surf::PipelineOptions glass_surf::StorageRenderOptions(const PipelineOptions& options) {
+    PipelineOptions render_options = options;
+
+    if (options.storage == SurfaceStorage::HALF) {
+        // The blur is relative to the screen, so it shrinks with the resolution
+        render_options.resolution = glass_surf::StorageResolution(options.resolution, SurfaceStorage::HALF);
+        render_options.blur_radius = options.blur_radius / 2.0;
+    }
+
+    return render_options;
+}
+
+void glass_surf::RunPipeline(const cv::Mat& frame, const PipelineOptions& options,
+    PipelineBuffers& buffers, cv::Mat& surface) {
+    {
+        AllocationScope allocation_scope("pipeline.resize");
+        glass_surf::CompressImage(frame, options.resolution.width, options.resolution.height, buffers.resized);
+    }
+
+    glass_surf::ProcessResizedFrame(buffers.resized, options, buffers, surface);
+}
+
+void glass_surf::ProcessResizedFrame(const cv::Mat& resized, const PipelineOptions& options,
+    PipelineBuffers& buffers, cv::Mat& surface) {
+    if (options.linear_light) {
+        // Tint and blur in 16-bit linear light, convert back to sRGB at the end
+        {
+            AllocationScope allocation_scope("pipeline.to_linear");
+            glass_surf::ToLinearLight(resized, buffers.linear);
+        }
+
+        const cv::Mat* linear_tinted = &buffers.linear;
+        if (options.tint) {
+            AllocationScope allocation_scope("pipeline.tint");
+            glass_surf::ApplyTintBlendLinear(buffers.linear, options.tint_color, buffers.linear_tinted);
+            linear_tinted = &buffers.linear_tinted;
+        }
+
+        {
+            AllocationScope allocation_scope("pipeline.blur");
+            glass_surf::GausianBlur(*linear_tinted, options.blur_radius, buffers.linear_blurred);
+        }
+
+        AllocationScope allocation_scope("pipeline.from_linear");
+        glass_surf::FromLinearLight(buffers.linear_blurred, surface);
+    }
+    else {
+        const cv::Mat* tinted = &resized;
+        if (options.tint) {
+            AllocationScope allocation_scope("pipeline.tint");
+            glass_surf::ApplyTintBlend(resized, options.tint_color, buffers.tinted);
+            tinted = &buffers.tinted;
+        }
+
+        AllocationScope allocation_scope("pipeline.blur");
+        glass_surf::GausianBlur(*tinted, options.blur_radius, surface);
+    }
+
+    // After the blur, so the grain stays sharp; in place
+    {
+        AllocationScope allocation_scope("pipeline.theme");
+        glass_surf::ApplyTheme(surface, options.theme, surface);
+    }
+
+    AllocationScope allocation_scope("pipeline.noise");
+    buffers.noise.Prepare(options.noise_seed, glass_surf::GetThemePreset(options.theme).noise_amplitude, surface.cols);
+    buffers.noise.Composite(surface);
+}
+
+std::shared_ptr<glass_surf::Surface> glass_surf::MakePlaceholderSurface(const PipelineOptions& options) {
+    auto surface = std::make_shared<Surface>();
+    surface->storage = SurfaceStorage::HALF;
+    surface->size = options.resolution;
+    surface->placeholder = true;
+
+    const RGB_Tint& color = options.tint_color;
+    surface->image = cv::Mat(1, 1, CV_8UC3, cv::Scalar(color.blue, color.green, color.red));
+    surface->luminosity.Build(surface->image, surface->size);
+
+    return surface;
+}
+
+std::shared_ptr<glass_surf::Surface> glass_surf::MakePlaceholderSurface(const std::string& wallpaper_path,
+    const PipelineOptions& options) {
+    GLASSSURF_TRACE_SCOPE("placeholder thumbnail");
+
+    cv::Mat thumbnail = cv::imread(wallpaper_path, cv::IMREAD_REDUCED_COLOR_8);
+    if (thumbnail.empty()) {
+        return nullptr;
+    }
+
+    auto surface = std::make_shared<Surface>();
+    surface->storage = SurfaceStorage::HALF;
+    surface->size = options.resolution;
+    surface->placeholder = true;
+
+    PipelineOptions thumbnail_options = options;
+    thumbnail_options.resolution = cv::Size(
+        (options.resolution.width + kPlaceholderScale - 1) / kPlaceholderScale,
+        (options.resolution.height + kPlaceholderScale - 1) / kPlaceholderScale);
+    thumbnail_options.blur_radius = options.blur_radius / kPlaceholderScale;
+    thumbnail_options.linear_light = false;
+
+    PipelineBuffers buffers;
+    glass_surf::RunPipeline(thumbnail, thumbnail_options, buffers, surface->image);
+    surface->luminosity.Build(surface->image, surface->size);
+
+    return surface;
+}
+
+glass_surf::SurfaceRenderer::SurfaceRenderer(SurfaceSwapChain& swap_chain, PipelineOptions options)
+    : swap_chain_(swap_chain), options_(options), render_options_(glass_surf::StorageRenderOptions(options)) {}
+
+glass_surf::SurfaceRenderer::~SurfaceRenderer() {
+    Stop();
+}
+
+void glass_surf::SurfaceRenderer::Start(std::unique_ptr<FrameSource> source, std::string startup_wallpaper_path) {
+    Stop();
+
+    source_ = std::move(source);
+    startup_wallpaper_path_ = std::move(startup_wallpaper_path);
+    stop_requested_ = false;
+
+    thread_ = std::thread(&SurfaceRenderer::Run, this);
+}
+
+void glass_surf::SurfaceRenderer::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_requested_ = true;
+    }
+    stop_condition_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void glass_surf::SurfaceRenderer::SetPaused(bool paused) {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        paused_ = paused;
+    }
+    stop_condition_.notify_all();
+}
+
+void glass_surf::SurfaceRenderer::KeepResizedBase(bool keep) {
+    keep_base_ = keep;
+}
+
+bool glass_surf::SurfaceRenderer::RenderNextFrame() {
+    GLASSSURF_TRACE_SCOPE("render frame");
+
+    {
+        AllocationScope allocation_scope("render.decode");
+        if (!source_->NextFrame(frame_)) {
+            return false;
+        }
+    }
+
+    std::shared_ptr<Surface> surface = swap_chain_.AcquireBack();
+    if (!surface) {
+        // Every surface is still being read; drop this frame rather than wait
+        return true;
+    }
+
+    surface->storage = options_.storage;
+    surface->size = options_.resolution;
+
+    if (options_.storage == SurfaceStorage::YCRCB420) {
+        glass_surf::RunPipeline(frame_, render_options_, buffers_, buffers_.surface);
+
+        AllocationScope allocation_scope("render.luminosity_and_store");
+        GLASSSURF_TRACE_SCOPE("luminosity index + ycrcb420");
+        surface->luminosity.Build(buffers_.surface);
+        surface->StoreYCrCb420(buffers_.surface, buffers_.ycrcb);
+    }
+    else {
+        glass_surf::RunPipeline(frame_, render_options_, buffers_, surface->image);
+
+        AllocationScope allocation_scope("render.luminosity");
+        GLASSSURF_TRACE_SCOPE("luminosity index");
+        surface->luminosity.Build(surface->image, options_.resolution);
+    }
+
+    // The surface takes the resized frame over; the next frame resizes into a new one
+    surface->base.reset();
+    if (keep_base_) {
+        surface->base = std::make_shared<const cv::Mat>(buffers_.resized);
+        buffers_.resized = cv::Mat();
+    }
+
+    std::chrono::milliseconds interval = source_->FrameInterval();
+    bool keep_buffers = interval.count() > 0 && interval < kKeepBuffersInterval;
+
+    if (!keep_buffers) {
+        surface->luminosity.ReleaseScratch();
+    }
+
+    swap_chain_.Publish(surface);
+
+    if (on_publish) {
+        on_publish(*surface);
+    }
+
+    if (!keep_buffers) {
+        frame_.release();
+        buffers_ = PipelineBuffers();
+        swap_chain_.ReleaseIdle();
+    }
+
+    return true;
+}
+
+void glass_surf::SurfaceRenderer::Run() {
+    glass_surf::SetTraceThreadName("renderer");
+
+    // Only startup waits on the first frame; a wallpaper change keeps serving the
+    // old surface meanwhile, so it must not compete with the foreground
+    bool startup = !startup_wallpaper_path_.empty();
+    if (!startup) {
+        glass_surf::LowerCurrentThreadPriority();
+    }
+
+    // Unless paused, at once
+    if (!WaitForNextFrame(std::chrono::steady_clock::now())) {
+        return;
+    }
+
+    if (startup) {
+        std::shared_ptr<Surface> thumbnail = glass_surf::MakePlaceholderSurface(startup_wallpaper_path_, options_);
+        if (thumbnail) {
+            swap_chain_.Publish(thumbnail);
+        }
+    }
+
+    if (!RenderNextFrame()) {
+        std::cerr << "[ERROR]: The wallpaper source produced no frame" << std::endl;
+        return;
+    }
+
+    if (source_->FrameInterval().count() == 0) {
+        return;
+    }
+
+    if (startup) {
+        glass_surf::LowerCurrentThreadPriority();
+    }
+
+    auto next_frame_time = std::chrono::steady_clock::now();
+
+    while (true) {
+        next_frame_time += source_->FrameInterval();
+
+        if (!WaitForNextFrame(next_frame_time) || !RenderNextFrame()) {
+            return;
+        }
+
+        // Fell behind (slow decode or blur): skip ahead instead of bursting
+        auto now = std::chrono::steady_clock::now();
+        if (next_frame_time < now) {
+            next_frame_time = now;
+        }
+    }
+}
+
+bool glass_surf::SurfaceRenderer::WaitForNextFrame(std::chrono::steady_clock::time_point next_frame_time) {
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+
+    // Pausing cuts the wait short; the thread then sleeps without a timeout until resumed
+    stop_condition_.wait_until(lock, next_frame_time, [this] { return stop_requested_ || paused_; });
+    stop_condition_.wait(lock, [this] { return stop_requested_ || !paused_; });
+
+    // False if Stop was requested meanwhile
+    return !stop_requested_;
+}
@@ -0,0 +1,212 @@
+// pipeline.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <opencv2/opencv.hpp>
+
+#include "settings/settings_manager.h"
+#include "frame_source.h"
+#include "image_utilities.h"
+#include "noise_layer.h"
+#include "surface.h"
+#include "theme.h"
+
+namespace glass_surf {
+
+	/**
+	 * @brief Parameters of the resize -> tint -> blur -> theme pipeline.
+	 */
+	struct PipelineOptions {
+		cv::Size resolution;
+		bool tint = false;
+		RGB_Tint tint_color = { 0, 0, 0 };
+		double blur_radius = 25.0;
+		bool linear_light = false;
+		Themes theme = Themes::ACRYLIC;
+		uint32_t noise_seed = 0;
+		SurfaceStorage storage = SurfaceStorage::FULL;
+	};
+
+	/**
+	 * @brief Builds pipeline options from the settings and the target resolution.
+	 */
+	PipelineOptions MakePipelineOptions(const settings::Settings& settings, cv::Size resolution);
+
+	/**
+	 * @brief Builds pipeline options with the processing of a profile instead of the top-level one.
+	 */
+	PipelineOptions MakePipelineOptions(const settings::Settings& settings, const settings::Profile& profile,
+		cv::Size resolution);
+
+	/**
+	 * @brief Returns the options the pipeline actually runs with for options.storage:
+	 * HALF halves the resolution and, with it, the blur radius.
+	 */
+	PipelineOptions StorageRenderOptions(const PipelineOptions& options);
+
+	/**
+	 * @brief Intermediate images of the pipeline, kept between runs.
+	 *
+	 * Once every buffer has been allocated by a first run, processing more frames of
+	 * the same size allocates nothing. The renderer drops them between frames of
+	 * sources that rarely produce one.
+	 */
+	struct PipelineBuffers {
+		cv::Mat resized;
+		cv::Mat tinted;
+		cv::Mat linear;
+		cv::Mat linear_tinted;
+		cv::Mat linear_blurred;
+
+		// BGR result and its YCrCb conversion, for SurfaceStorage::YCRCB420 only
+		cv::Mat surface;
+		cv::Mat ycrcb;
+
+		NoiseLayer noise;
+	};
+
+	/**
+	 * @brief Runs one frame through resize, tint, blur and the theme material.
+	 *
+	 * @param frame The decoded wallpaper frame (BGR).
+	 * @param options The pipeline parameters.
+	 * @param buffers Intermediate images, reused between calls.
+	 * @param surface Receives the processed image; reused if it already has the right size.
+	 */
+	void RunPipeline(const cv::Mat& frame, const PipelineOptions& options,
+		PipelineBuffers& buffers, cv::Mat& surface);
+
+	/**
+	 * @brief Runs the stages after the resize (tint, blur, theme, grain) on a resized frame.
+	 *
+	 * @param resized The frame at options.resolution (BGR); not modified, so it can
+	 * be shared by several runs with different options.
+	 * @param options The pipeline parameters.
+	 * @param buffers Intermediate images, reused between calls; `resized` is not used.
+	 * @param surface Receives the processed image; reused if it already has the right size.
+	 */
+	void ProcessResizedFrame(const cv::Mat& resized, const PipelineOptions& options,
+		PipelineBuffers& buffers, cv::Mat& surface);
+
+	/**
+	 * @brief Builds the cheapest surface to serve while the first real frame renders:
+	 * a solid fill of the blend color, stored as a reduced surface so crops and
+	 * luminosity queries work as usual.
+	 *
+	 * @param options The pipeline parameters of the real surface.
+	 * @return A standalone surface with `placeholder` set, for SurfaceSwapChain::Publish.
+	 */
+	std::shared_ptr<Surface> MakePlaceholderSurface(const PipelineOptions& options);
+
+	/**
+	 * @brief Builds a thumbnail of the wallpaper to serve while the first real frame renders.
+	 *
+	 * The wallpaper is decoded at 1/8 resolution (JPEG decoding then skips most of
+	 * its work) and run through the pipeline at that size, so it costs a decode and
+	 * a small pipeline run; SurfaceRenderer builds it on its thread.
+	 *
+	 * @param wallpaper_path The wallpaper the renderer is about to load.
+	 * @param options The pipeline parameters of the real surface.
+	 * @return A standalone surface with `placeholder` set, or nullptr if the wallpaper
+	 * cannot be decoded as a still image (slideshow directory, video).
+	 */
+	std::shared_ptr<Surface> MakePlaceholderSurface(const std::string& wallpaper_path, const PipelineOptions& options);
+
+	/**
+	 * @brief Feeds the frames of a FrameSource through the pipeline into a SurfaceSwapChain.
+	 *
+	 * Surfaces are stored as options.storage asks: HALF renders the whole pipeline at
+	 * half resolution, YCRCB420 renders at full resolution and converts the result.
+	 * For static images and slideshows, the decoded frame, the pipeline buffers and
+	 * the idle back surface are freed after each frame, so only the published
+	 * surface stays resident.
+	 */
+	class SurfaceRenderer {
+	public:
+		SurfaceRenderer(SurfaceSwapChain& swap_chain, PipelineOptions options);
+		~SurfaceRenderer();
+
+		SurfaceRenderer(const SurfaceRenderer&) = delete;
+		SurfaceRenderer& operator=(const SurfaceRenderer&) = delete;
+
+		/**
+		 * @brief Renders and publishes frames of the source on a background thread.
+		 *
+		 * Returns immediately. Calling Start again replaces the source; the published
+		 * surface stays in place until the first frame of the new source is ready. A
+		 * source that produces no frame is reported on stderr.
+		 *
+		 * @param source The frames to render.
+		 * @param startup_wallpaper_path Set for the source rendered at startup, while
+		 * only a placeholder is published: the thread first publishes a thumbnail of
+		 * this wallpaper (see MakePlaceholderSurface), then renders the first frame at
+		 * normal priority. Every other frame, and every frame of a source started
+		 * without it (wallpaper changes), is rendered at low priority.
+		 */
+		void Start(std::unique_ptr<FrameSource> source, std::string startup_wallpaper_path = std::string());
+
+		/**
+		 * @brief Stops the background thread, if any.
+		 */
+		void Stop();
+
+		/**
+		 * @brief Suspends or resumes rendering, e.g. while nobody can see the browser window.
+		 *
+		 * A paused renderer finishes the frame it is rendering and then sleeps
+		 * without waking until it is resumed or stopped; the first frame of a
+		 * source started while paused waits too. On resume the next frame is
+		 * rendered at once. Stays in effect across Start calls.
+		 */
+		void SetPaused(bool paused);
+
+		/**
+		 * @brief Keeps the resized frame of each surface in Surface::base, for
+		 * ProfileSurfaces. Costs one resized frame per surface, and an allocation
+		 * per frame. Call before Start.
+		 */
+		void KeepResizedBase(bool keep);
+
+		/**
+		 * @brief Called on the rendering thread after each published surface.
+		 */
+		std::function<void(const Surface&)> on_publish;
+
+	private:
+		bool RenderNextFrame();
+		void Run();
+		bool WaitForNextFrame(std::chrono::steady_clock::time_point next_frame_time);
+
+		SurfaceSwapChain& swap_chain_;
+		PipelineOptions options_;
+		PipelineOptions render_options_; // options_ at the storage resolution
+		std::unique_ptr<FrameSource> source_;
+		std::string startup_wallpaper_path_; // Empty unless the current source is the startup one
+
+		cv::Mat frame_;
+		PipelineBuffers buffers_;
+
+		std::thread thread_;
+		std::mutex stop_mutex_;
+		std::condition_variable stop_condition_; // Signals changes of stop_requested_ and paused_
+		bool stop_requested_ = false;
+		bool paused_ = false;
+
+		bool keep_base_ = false;
+	};
+
+} // namespace glass_surf
+
+#endif // !PIPELINE_H_
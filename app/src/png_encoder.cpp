@@ -0,0 +1,433 @@
+// png_encoder.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+#include <zlib.h>
+
+namespace {
+
+    constexpr size_t kOutputChunkSize = 64 * 1024;
+    constexpr uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    constexpr uint8_t kPaethFilter = 4;
+
+    // zlib stream header for a 32K window; FLEVEL is 0 because Z_RLE always reports "fastest"
+    constexpr uint8_t kZlibHeader[2] = { 0x78, 0x01 };
+    constexpr size_t kAdlerSize = 4;
+
+    // Below this many pixels the thread handoff costs more than it saves
+    constexpr size_t kParallelMinPixels = 512 * 1024;
+    constexpr int kMinStripeRows = 64;
+
+    // Per-thread buffers and zlib state, reused by every encode on that thread
+    struct PngScratch {
+        std::vector<uint8_t> filtered_row;
+        std::vector<uint8_t> output;
+        z_stream stream = {};
+        bool stream_ready = false;
+        int level = 0;
+
+        ~PngScratch() {
+            if (stream_ready) {
+                deflateEnd(&stream);
+            }
+        }
+
+        // window_bits is 15 for a zlib stream or -15 for a raw deflate stripe
+        bool Reset(int compression_level, int window_bits) {
+            if (stream_ready && level == compression_level) {
+                return deflateReset(&stream) == Z_OK;
+            }
+
+            if (stream_ready) {
+                deflateEnd(&stream);
+            }
+
+            stream = {};
+            // Z_RLE matches cv::imencode's default PNG strategy and is the fastest on filtered rows
+            stream_ready = deflateInit2(&stream, compression_level, Z_DEFLATED, window_bits, 8, Z_RLE) == Z_OK;
+            level = compression_level;
+
+            return stream_ready;
+        }
+    };
+
+    PngScratch& ThreadScratch() {
+        thread_local PngScratch scratch;
+        return scratch;
+    }
+
+    PngScratch& ThreadStripeScratch() {
+        thread_local PngScratch scratch;
+        return scratch;
+    }
+
+    // Compressed stripes of the encode running on this thread, reused between encodes
+    struct StripeOutputs {
+        std::vector<std::vector<uint8_t>> data;
+        std::vector<size_t> sizes;
+        std::vector<uLong> adlers;
+    };
+
+    StripeOutputs& ThreadStripeOutputs() {
+        thread_local StripeOutputs outputs;
+        return outputs;
+    }
+
+    void PutUint32(uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+    }
+
+    void WriteChunk(const glass_surf::PngSink& sink, const char type[4], const uint8_t* data, size_t size) {
+        uint8_t header[8];
+        PutUint32(header, static_cast<uint32_t>(size));
+        std::copy(type, type + 4, header + 4);
+
+        uLong crc = crc32(0, header + 4, 4);
+        if (size > 0) {
+            crc = crc32(crc, data, static_cast<uInt>(size));
+        }
+
+        uint8_t footer[4];
+        PutUint32(footer, static_cast<uint32_t>(crc));
+
+        sink(header, sizeof(header));
+        if (size > 0) {
+            sink(data, size);
+        }
+        sink(footer, sizeof(footer));
+    }
+
+    inline uint8_t Paeth(int a, int b, int c) {
+        int p = a + b - c;
+        int pa = std::abs(p - a);
+        int pb = std::abs(p - b);
+        int pc = std::abs(p - c);
+
+        if (pa <= pb && pa <= pc) {
+            return static_cast<uint8_t>(a);
+        }
+        return static_cast<uint8_t>(pb <= pc ? b : c);
+    }
+
+    // Channel of the source pixel (BGR(A)) that becomes output channel c (RGB(A))
+    template <int kChannels>
+    constexpr int SourceChannel(int c) {
+        return kChannels >= 3 && c < 3 ? 2 - c : c;
+    }
+
+    // Swizzles and Paeth-filters one row straight from the (possibly strided) source.
+    // `previous` is the source row above, or nullptr for the first row.
+    template <int kChannels>
+    void FilterRow(const uint8_t* row, const uint8_t* previous, int width, uint8_t* filtered) {
+        filtered[0] = kPaethFilter;
+        uint8_t* out = filtered + 1;
+
+        if (previous == nullptr) {
+            // Paeth with no row above degenerates to Sub
+            for (int c = 0; c < kChannels; ++c) {
+                out[c] = row[SourceChannel<kChannels>(c)];
+            }
+            for (int x = 1; x < width; ++x) {
+                for (int c = 0; c < kChannels; ++c) {
+                    int s = SourceChannel<kChannels>(c);
+                    out[x * kChannels + c] = static_cast<uint8_t>(row[x * kChannels + s] - row[(x - 1) * kChannels + s]);
+                }
+            }
+            return;
+        }
+
+        for (int c = 0; c < kChannels; ++c) {
+            int s = SourceChannel<kChannels>(c);
+            out[c] = static_cast<uint8_t>(row[s] - previous[s]);
+        }
+        for (int x = 1; x < width; ++x) {
+            for (int c = 0; c < kChannels; ++c) {
+                int s = SourceChannel<kChannels>(c);
+                uint8_t predictor = Paeth(row[(x - 1) * kChannels + s], previous[x * kChannels + s],
+                    previous[(x - 1) * kChannels + s]);
+                out[x * kChannels + c] = static_cast<uint8_t>(row[x * kChannels + s] - predictor);
+            }
+        }
+    }
+
+    void FilterImageRow(const cv::Mat& image, int y, uint8_t* filtered) {
+        const uint8_t* row = image.ptr<uint8_t>(y);
+        const uint8_t* previous = y > 0 ? image.ptr<uint8_t>(y - 1) : nullptr;
+
+        switch (image.channels()) {
+            case 1:
+                FilterRow<1>(row, previous, image.cols, filtered);
+                break;
+            case 3:
+                FilterRow<3>(row, previous, image.cols, filtered);
+                break;
+            case 4:
+                FilterRow<4>(row, previous, image.cols, filtered);
+                break;
+        }
+    }
+
+    uint8_t PngColorType(int channels) {
+        switch (channels) {
+            case 1:
+                return 0; // Grayscale
+            case 3:
+                return 2; // RGB
+            default:
+                return 6; // RGBA
+        }
+    }
+
+    bool IsSupported(const cv::Mat& image) {
+        return !image.empty() && image.depth() == CV_8U
+            && (image.channels() == 1 || image.channels() == 3 || image.channels() == 4);
+    }
+
+    void WriteHeader(const glass_surf::PngSink& sink, const cv::Mat& image) {
+        sink(kPngSignature, sizeof(kPngSignature));
+
+        uint8_t ihdr[13];
+        PutUint32(ihdr, static_cast<uint32_t>(image.cols));
+        PutUint32(ihdr + 4, static_cast<uint32_t>(image.rows));
+        ihdr[8] = 8; // Bit depth
+        ihdr[9] = PngColorType(image.channels());
+        ihdr[10] = 0; // Deflate
+        ihdr[11] = 0; // Adaptive filtering
+        ihdr[12] = 0; // No interlace
+        WriteChunk(sink, "IHDR", ihdr, sizeof(ihdr));
+    }
+
+    // Filters and deflates rows [first_row, last_row) into a raw deflate stripe.
+    // Every stripe but the last ends on a sync flush, so the stripes can be
+    // concatenated byte-wise into one deflate stream.
+    bool DeflateStripe(const cv::Mat& image, int first_row, int last_row, bool last_stripe,
+        int compression_level, size_t offset, std::vector<uint8_t>& output, size_t& produced, uLong& adler) {
+        PngScratch& scratch = ThreadStripeScratch();
+        if (!scratch.Reset(compression_level, -15)) {
+            return false;
+        }
+
+        const size_t row_size = static_cast<size_t>(image.cols) * image.channels() + 1;
+        scratch.filtered_row.resize(row_size);
+
+        z_stream& stream = scratch.stream;
+        size_t bound = offset + deflateBound(&stream, static_cast<uLong>(row_size * (last_row - first_row)))
+            + 16 + kAdlerSize;
+        if (output.size() < bound) {
+            output.resize(bound);
+        }
+
+        stream.next_out = output.data() + offset;
+        stream.avail_out = static_cast<uInt>(output.size() - offset);
+
+        // Only reached if deflateBound was too tight; keeps the bytes written so far
+        auto grow_output = [&]() {
+            size_t used = output.size() - stream.avail_out;
+            output.resize(output.size() * 2);
+            stream.next_out = output.data() + used;
+            stream.avail_out = static_cast<uInt>(output.size() - used);
+        };
+
+        adler = adler32(0, nullptr, 0);
+
+        for (int y = first_row; y < last_row; ++y) {
+            // The row above comes from the source image, so stripes filter independently
+            FilterImageRow(image, y, scratch.filtered_row.data());
+            adler = adler32(adler, scratch.filtered_row.data(), static_cast<uInt>(row_size));
+
+            stream.next_in = scratch.filtered_row.data();
+            stream.avail_in = static_cast<uInt>(row_size);
+
+            while (stream.avail_in > 0) {
+                if (stream.avail_out == 0) {
+                    grow_output();
+                }
+                if (deflate(&stream, Z_NO_FLUSH) == Z_STREAM_ERROR) {
+                    return false;
+                }
+            }
+        }
+
+        const int flush = last_stripe ? Z_FINISH : Z_SYNC_FLUSH;
+        for (;;) {
+            if (stream.avail_out == 0) {
+                grow_output();
+            }
+
+            int status = deflate(&stream, flush);
+            if (status == Z_STREAM_ERROR) {
+                return false;
+            }
+            if (last_stripe ? status == Z_STREAM_END : stream.avail_out > 0) {
+                break;
+            }
+        }
+
+        produced = output.size() - stream.avail_out;
+
+        return true;
+    }
+
+    // Deflates the stripes on cv::parallel_for_ and joins them pigz-style. No preset
+    // dictionary is carried across stripes: Z_RLE only matches at distance 1, so a
+    // stripe loses at most one match at its first byte.
+    bool EncodeStripes(const cv::Mat& image, const glass_surf::PngSink& sink, int compression_level, int stripes) {
+        StripeOutputs& outputs = ThreadStripeOutputs();
+        if (outputs.data.size() < static_cast<size_t>(stripes)) {
+            outputs.data.resize(stripes);
+        }
+        outputs.sizes.assign(stripes, 0);
+        outputs.adlers.assign(stripes, 0);
+
+        auto first_row = [&](int stripe) {
+            return static_cast<int>(static_cast<int64_t>(image.rows) * stripe / stripes);
+        };
+
+        std::atomic<bool> failed = false;
+
+        cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range) {
+            for (int stripe = range.start; stripe < range.end; ++stripe) {
+                // The first stripe leaves room for the zlib header
+                size_t offset = stripe == 0 ? sizeof(kZlibHeader) : 0;
+
+                if (!DeflateStripe(image, first_row(stripe), first_row(stripe + 1), stripe == stripes - 1,
+                    compression_level, offset, outputs.data[stripe], outputs.sizes[stripe], outputs.adlers[stripe])) {
+                    failed = true;
+                }
+            }
+        }, stripes);
+
+        if (failed) {
+            return false;
+        }
+
+        // One zlib stream: header, the concatenated stripes, then the combined checksum
+        const size_t row_size = static_cast<size_t>(image.cols) * image.channels() + 1;
+        uLong adler = outputs.adlers[0];
+        for (int stripe = 1; stripe < stripes; ++stripe) {
+            z_off_t length = static_cast<z_off_t>(row_size * (first_row(stripe + 1) - first_row(stripe)));
+            adler = adler32_combine(adler, outputs.adlers[stripe], length);
+        }
+
+        std::copy(kZlibHeader, kZlibHeader + sizeof(kZlibHeader), outputs.data[0].begin());
+
+        std::vector<uint8_t>& last = outputs.data[stripes - 1];
+        size_t& last_size = outputs.sizes[stripes - 1];
+        if (last.size() < last_size + kAdlerSize) {
+            last.resize(last_size + kAdlerSize);
+        }
+        PutUint32(last.data() + last_size, static_cast<uint32_t>(adler));
+        last_size += kAdlerSize;
+
+        WriteHeader(sink, image);
+
+        for (int stripe = 0; stripe < stripes; ++stripe) {
+            WriteChunk(sink, "IDAT", outputs.data[stripe].data(), outputs.sizes[stripe]);
+        }
+
+        WriteChunk(sink, "IEND", nullptr, 0);
+
+        return true;
+    }
+
+} // namespace
+
+int glass_surf::PngStripeCount(const cv::Mat& image) {
+    if (image.total() < kParallelMinPixels) {
+        return 1;
+    }
+
+    return std::clamp(std::min(cv::getNumThreads(), image.rows / kMinStripeRows), 1, kMaxPngStripes);
+}
+
+bool glass_surf::EncodePng(const cv::Mat& image, const PngSink& sink, int compression_level) {
+    return EncodePngStriped(image, sink, compression_level, PngStripeCount(image));
+}
+
+bool glass_surf::EncodePngStriped(const cv::Mat& image, const PngSink& sink, int compression_level,
+    int stripes) {
+    if (!IsSupported(image)) {
+        return false;
+    }
+
+    stripes = std::clamp(std::min(stripes, image.rows), 1, kMaxPngStripes);
+    if (stripes > 1) {
+        return EncodeStripes(image, sink, compression_level, stripes);
+    }
+
+    PngScratch& scratch = ThreadScratch();
+    if (!scratch.Reset(compression_level, 15)) {
+        return false;
+    }
+
+    const size_t row_size = static_cast<size_t>(image.cols) * image.channels() + 1;
+    scratch.filtered_row.resize(row_size);
+    scratch.output.resize(kOutputChunkSize);
+
+    WriteHeader(sink, image);
+
+    // Image data, one IDAT chunk per filled output buffer
+    z_stream& stream = scratch.stream;
+    stream.next_out = scratch.output.data();
+    stream.avail_out = static_cast<uInt>(scratch.output.size());
+
+    auto flush_output = [&]() {
+        size_t produced = scratch.output.size() - stream.avail_out;
+        if (produced > 0) {
+            WriteChunk(sink, "IDAT", scratch.output.data(), produced);
+        }
+        stream.next_out = scratch.output.data();
+        stream.avail_out = static_cast<uInt>(scratch.output.size());
+    };
+
+    for (int y = 0; y < image.rows; ++y) {
+        FilterImageRow(image, y, scratch.filtered_row.data());
+
+        stream.next_in = scratch.filtered_row.data();
+        stream.avail_in = static_cast<uInt>(row_size);
+
+        while (stream.avail_in > 0) {
+            if (deflate(&stream, Z_NO_FLUSH) == Z_STREAM_ERROR) {
+                return false;
+            }
+            if (stream.avail_out == 0) {
+                flush_output();
+            }
+        }
+    }
+
+    int status;
+    do {
+        status = deflate(&stream, Z_FINISH);
+        if (status == Z_STREAM_ERROR) {
+            return false;
+        }
+        if (stream.avail_out == 0 || status == Z_STREAM_END) {
+            flush_output();
+        }
+    } while (status != Z_STREAM_END);
+
+    WriteChunk(sink, "IEND", nullptr, 0);
+
+    return true;
+}
+
+bool glass_surf::EncodePng(const cv::Mat& image, std::string& png, int compression_level) {
+    png.clear();
+
+    return EncodePng(image, [&png](const uint8_t* data, size_t size) {
+        png.append(reinterpret_cast<const char*>(data), size);
+    }, compression_level);
+}
@@ -0,0 +1,85 @@
+// png_encoder.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef PNG_ENCODER_H_
+#define PNG_ENCODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief Receives encoded PNG bytes in order.
+	 */
+	using PngSink = std::function<void(const uint8_t* data, size_t size)>;
+
+	/**
+	 * @brief Upper bound on the number of stripes a single encode is split into.
+	 */
+	constexpr int kMaxPngStripes = 64;
+
+	/**
+	 * @brief Encodes an 8-bit image (1, 3 or 4 channels, BGR(A) order) as PNG.
+	 *
+	 * The image may be a strided view such as an ROI of a larger surface; it is never
+	 * copied. Each row is converted to RGB(A), Paeth-filtered and handed to deflate in a
+	 * single pass over the pixels. The row and zlib state buffers are kept per thread,
+	 * so steady-state encoding does not allocate.
+	 *
+	 * Large images are split into PngStripeCount() stripes and compressed in parallel
+	 * (see EncodePngStriped); small ones stream IDAT chunks as deflate produces them.
+	 *
+	 * @param image The image or ROI view to encode.
+	 * @param sink Called with consecutive pieces of the PNG stream.
+	 * @param compression_level zlib level, 1 (fastest) to 9.
+	 * @return False if the image type is not supported or deflate failed.
+	 */
+	bool EncodePng(const cv::Mat& image, const PngSink& sink, int compression_level = 1);
+
+	/**
+	 * @brief Encodes an image as PNG, splitting the rows into independently deflated stripes.
+	 *
+	 * Each stripe is filtered and compressed on its own core into a raw deflate
+	 * stream that ends on a sync flush (the last one is finished instead). The
+	 * stripes are concatenated behind one zlib header and closed with the combined
+	 * Adler-32, so the result is a single ordinary PNG stream. Filtering reads the
+	 * row above straight from the image, so stripe boundaries do not change the
+	 * filtered bytes. Output is produced once every stripe is done.
+	 *
+	 * @param image The image or ROI view to encode.
+	 * @param sink Called with consecutive pieces of the PNG stream, on the calling thread.
+	 * @param compression_level zlib level, 1 (fastest) to 9.
+	 * @param stripes Number of stripes; 1 encodes sequentially.
+	 * @return False if the image type is not supported or deflate failed.
+	 */
+	bool EncodePngStriped(const cv::Mat& image, const PngSink& sink, int compression_level, int stripes);
+
+	/**
+	 * @brief Returns the stripe count EncodePng uses for an image.
+	 *
+	 * One stripe below about half a megapixel, otherwise one per OpenCV worker
+	 * thread with at least 64 rows each.
+	 */
+	int PngStripeCount(const cv::Mat& image);
+
+	/**
+	 * @brief Encodes an image as PNG into a string, reusing the string's capacity.
+	 *
+	 * @param image The image or ROI view to encode.
+	 * @param png Receives the PNG stream; previous contents are discarded.
+	 * @param compression_level zlib level, 1 (fastest) to 9.
+	 * @return False if the image type is not supported or deflate failed.
+	 */
+	bool EncodePng(const cv::Mat& image, std::string& png, int compression_level = 1);
+
+} // namespace glass_surf
+
+#endif // !PNG_ENCODER_H_
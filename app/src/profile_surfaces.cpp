@@ -0,0 +1,172 @@
+// profile_surfaces.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "profile_surfaces.h"
+
+#include <exception>
+#include <iostream>
+
+#include "allocation_counter.h"
+#include "tracer.h"
+
+glass_surf::ProfileSurfaces::ProfileSurfaces(const SurfaceSwapChain& swap_chain, const settings::Settings& settings,
+    cv::Size resolution, size_t memory_budget)
+    : swap_chain_(swap_chain), storage_(settings.surfaceStorage), resolution_(resolution),
+    memory_budget_(memory_budget), entries_(settings.profiles.size()) {
+    for (size_t i = 0; i < settings.profiles.size(); ++i) {
+        entries_[i].name = settings.profiles[i].name;
+        entries_[i].options = glass_surf::StorageRenderOptions(
+            glass_surf::MakePipelineOptions(settings, settings.profiles[i], resolution));
+    }
+}
+
+std::shared_ptr<glass_surf::BackgroundCache> glass_surf::ProfileSurfaces::Cache(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        Entry& entry = entries_[i];
+        if (entry.name != name) {
+            continue;
+        }
+
+        if (!entry.cache) {
+            // Staleness is answered from the published generation, which the profile surface follows
+            entry.cache = std::make_shared<BackgroundCache>([this, i]() { return Current(i); },
+                [this]() { return PublishedGeneration(); });
+        }
+        return entry.cache;
+    }
+
+    return nullptr;
+}
+
+size_t glass_surf::ProfileSurfaces::ByteSize() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t bytes = 0;
+    for (const Entry& entry : entries_) {
+        bytes += entry.surface ? entry.surface->ByteSize() : 0;
+    }
+    return bytes;
+}
+
+uint64_t glass_surf::ProfileSurfaces::PublishedGeneration() const {
+    std::shared_ptr<const Surface> published = swap_chain_.Current();
+    return published ? published->generation : 0;
+}
+
+std::shared_ptr<const glass_surf::Surface> glass_surf::ProfileSurfaces::Current(size_t index) {
+    std::shared_ptr<const Surface> published = swap_chain_.Current();
+    if (!published || !published->base) {
+        // Nothing to render from yet (placeholder): the published surface stands in
+        return published;
+    }
+
+    std::promise<std::shared_ptr<const Surface>> rendered;
+    std::shared_future<std::shared_ptr<const Surface>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        Entry& entry = entries_[index];
+        entry.last_used = ++uses_;
+
+        if (entry.surface && entry.surface->generation == published->generation) {
+            return entry.surface;
+        }
+
+        if (entry.pending.valid() && entry.pending_generation == published->generation) {
+            // Another request is rendering this frame already
+            pending = entry.pending;
+        }
+        else {
+            // Readers keep the old surface alive as long as they need it
+            entry.surface.reset();
+            entry.pending = rendered.get_future().share();
+            entry.pending_generation = published->generation;
+        }
+    }
+
+    if (pending.valid()) {
+        GLASSSURF_TRACE_SCOPE("wait profile");
+        std::shared_ptr<const Surface> surface = pending.get();
+        return surface ? surface : published;
+    }
+
+    // Without the lock: other profiles, and caches, stay available while this one renders
+    std::shared_ptr<const Surface> surface;
+    try {
+        surface = Render(entries_[index], *published);
+    }
+    catch (const std::exception& exception) {
+        // Waiting requests get nullptr, and with it the published surface, rather
+        // than a broken promise; the next request tries again
+        std::cerr << "[ERROR]: Rendering profile " << entries_[index].name << " failed: " << exception.what() << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        Entry& entry = entries_[index];
+        if (entry.pending_generation == published->generation) {
+            // Unless a newer frame started rendering meanwhile
+            entry.surface = surface;
+            entry.pending = {};
+            if (surface) {
+                Evict(entry);
+            }
+        }
+    }
+
+    rendered.set_value(surface);
+    return surface ? surface : published;
+}
+
+std::shared_ptr<glass_surf::Surface> glass_surf::ProfileSurfaces::Render(const Entry& entry, const Surface& base_surface) {
+    GLASSSURF_TRACE_SCOPE("render profile");
+    AllocationScope allocation_scope("profile.render");
+
+    auto surface = std::make_shared<Surface>();
+    surface->storage = storage_;
+    surface->size = resolution_;
+    surface->generation = base_surface.generation;
+
+    // Profiles render only when asked for, so nothing is kept between renders
+    PipelineBuffers buffers;
+    if (storage_ == SurfaceStorage::YCRCB420) {
+        glass_surf::ProcessResizedFrame(*base_surface.base, entry.options, buffers, buffers.surface);
+        surface->StoreYCrCb420(buffers.surface, buffers.ycrcb);
+    }
+    else {
+        glass_surf::ProcessResizedFrame(*base_surface.base, entry.options, buffers, surface->image);
+    }
+
+    return surface;
+}
+
+void glass_surf::ProfileSurfaces::Evict(const Entry& keep) {
+    size_t bytes = 0;
+    for (const Entry& entry : entries_) {
+        bytes += entry.surface ? entry.surface->ByteSize() : 0;
+    }
+
+    while (bytes > memory_budget_) {
+        Entry* oldest = nullptr;
+        for (Entry& entry : entries_) {
+            if (entry.surface && &entry != &keep && (!oldest || entry.last_used < oldest->last_used)) {
+                oldest = &entry;
+            }
+        }
+
+        if (!oldest) {
+            // The profile just rendered stays, even alone over the budget
+            break;
+        }
+
+        bytes -= oldest->surface->ByteSize();
+        oldest->surface.reset();
+        // Its encoded images go too; requests still using the cache keep it alive
+        oldest->cache.reset();
+    }
+}
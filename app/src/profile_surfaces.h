@@ -0,0 +1,97 @@
+// profile_surfaces.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef PROFILE_SURFACES_H_
+#define PROFILE_SURFACES_H_
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "settings/settings_manager.h"
+#include "background_cache.h"
+#include "pipeline.h"
+#include "surface.h"
+
+namespace glass_surf {
+
+	/**
+	 * @brief The processed surfaces of the configured profiles, rendered on first use.
+	 *
+	 * A profile's surface is rendered from the resized frame the published surface
+	 * keeps (Surface::base, see SurfaceRenderer::KeepResizedBase), running only the
+	 * stages after the resize with the profile's tint, blur, theme and grain; the
+	 * wallpaper is never decoded or resized again for a profile. It is rendered on
+	 * the request that first needs it, and again once a new frame is published.
+	 * The surfaces take at most `memory_budget` bytes: past that, the least
+	 * recently used profiles are evicted, with their encoded images, and rendered
+	 * again when next asked for. The luminosity (/contrast/) stays that of the
+	 * published surface. Every method may be called from any thread. Renders
+	 * run without the lock held, so profiles render in parallel and Cache()
+	 * never waits for one; requests for a frame a profile is rendering wait for
+	 * that render instead of starting another. Whether a profile's image is
+	 * stale is answered from the published generation, without rendering.
+	 */
+	class ProfileSurfaces {
+	public:
+		/**
+		 * @param swap_chain Publishes the surfaces the profiles are rendered from.
+		 * @param settings The profiles and the storage of the surfaces.
+		 * @param resolution Surface resolution.
+		 * @param memory_budget Bytes of profile surfaces to keep.
+		 */
+		ProfileSurfaces(const SurfaceSwapChain& swap_chain, const settings::Settings& settings,
+			cv::Size resolution, size_t memory_budget);
+
+		ProfileSurfaces(const ProfileSurfaces&) = delete;
+		ProfileSurfaces& operator=(const ProfileSurfaces&) = delete;
+
+		/**
+		 * @brief Returns the cache serving a profile's /bg/ images.
+		 *
+		 * @return nullptr if no profile has this name.
+		 */
+		std::shared_ptr<BackgroundCache> Cache(const std::string& name);
+
+		/**
+		 * @brief Returns the number of bytes held by the profile surfaces.
+		 */
+		size_t ByteSize();
+
+	private:
+		struct Entry {
+			std::string name;
+			PipelineOptions options; // At the storage's render resolution
+			std::shared_ptr<const Surface> surface;
+			std::shared_ptr<BackgroundCache> cache;
+			std::shared_future<std::shared_ptr<const Surface>> pending; // The render in progress, if any
+			uint64_t pending_generation = 0;
+			uint64_t last_used = 0;
+		};
+
+		uint64_t PublishedGeneration() const;
+		std::shared_ptr<const Surface> Current(size_t index);
+		std::shared_ptr<Surface> Render(const Entry& entry, const Surface& base_surface);
+		void Evict(const Entry& keep);
+
+		const SurfaceSwapChain& swap_chain_;
+		SurfaceStorage storage_;
+		cv::Size resolution_;
+		size_t memory_budget_;
+
+		std::mutex mutex_;
+		std::vector<Entry> entries_;
+		uint64_t uses_ = 0;
+	};
+
+} // namespace glass_surf
+
+#endif // !PROFILE_SURFACES_H_
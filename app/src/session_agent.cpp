@@ -0,0 +1,149 @@
+// session_agent.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "session_agent.h"
+
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include <boost/beast/http.hpp>
+
+#ifdef _WIN32
+#include "windows/window_utilities.h"
+#include "windows/background_image.h"
+#endif
+
+#include "settings/settings_manager.h"
+#include "geometry_source.h"
+#include "http_client.h"
+
+namespace {
+
+    namespace http = boost::beast::http;
+
+    // How often the browser window is looked at; the server polled it as often
+    constexpr auto kGeometryInterval = std::chrono::milliseconds(50);
+
+    volatile std::sig_atomic_t stop_requested = 0;
+
+    void RequestStop(int) {
+        stop_requested = 1;
+    }
+
+    // Percent-encodes everything but unreserved characters, for a query value
+    std::string PercentEncode(const std::string& text) {
+        static const char kHexDigits[] = "0123456789ABCDEF";
+
+        std::string encoded;
+        for (unsigned char character : text) {
+            if (std::isalnum(character) || character == '-' || character == '_' || character == '.' || character == '~') {
+                encoded += static_cast<char>(character);
+            }
+            else {
+                encoded += '%';
+                encoded += kHexDigits[character >> 4];
+                encoded += kHexDigits[character & 0x0F];
+            }
+        }
+        return encoded;
+    }
+
+    bool Register(glass_surf::HttpConnection& connection, const std::string& target) {
+        std::string body;
+        unsigned status = connection.Send(http::verb::put, target, body);
+        if (status == 0) {
+            std::cerr << "[ERROR]: Cannot reach the session daemon" << std::endl;
+            return false;
+        }
+        if (status != 200) {
+            std::cerr << "[ERROR]: The session daemon refused the session (" << status << "): " << body << std::endl;
+            return false;
+        }
+
+        std::cout << "Session registered: " << body << std::endl;
+        return true;
+    }
+
+} // namespace
+
+int glass_surf::RunSessionAgent(const SessionAgentOptions& options) {
+    settings::Settings settings;
+    std::string config_path;
+    if (std::ifstream(options.config_path).good()) {
+        settings = settings::ReadSettingsFile(options.config_path);
+        // The daemon resolves paths itself, not from the agent's directory
+        config_path = std::filesystem::absolute(options.config_path).string();
+    }
+
+    std::string wallpaper_path = settings.wallpaper;
+    cv::Size screen = options.screen;
+
+    #ifdef _WIN32
+    if (wallpaper_path.empty()) {
+        std::wstring desktop_wallpaper_path = glass_surf::win::GetDesktopWallPaperPath();
+        wallpaper_path = std::string(desktop_wallpaper_path.begin(), desktop_wallpaper_path.end());
+    }
+    glass_surf::win::GetDesktopResolution(screen.width, screen.height);
+    #endif
+
+    std::string session_target = "/session/?width=" + std::to_string(screen.width)
+        + "&height=" + std::to_string(screen.height);
+    if (!wallpaper_path.empty()) {
+        session_target += "&wallpaper=" + PercentEncode(wallpaper_path);
+    }
+    if (!config_path.empty()) {
+        session_target += "&config=" + PercentEncode(config_path);
+    }
+
+    boost::asio::io_context io_context;
+    glass_surf::HttpConnection connection(io_context, options.host, options.port);
+    if (!Register(connection, session_target)) {
+        return 1;
+    }
+
+    std::signal(SIGINT, RequestStop);
+    std::signal(SIGTERM, RequestStop);
+
+    // Outside Windows the browser window cannot be tracked; the session keeps the daemon's default geometry
+    #ifdef _WIN32
+    HWND browser_window = glass_surf::win::FindWindowHandleByTitleSubstring(settings.browser);
+    glass_surf::BrowserWindowGeometrySource window_geometry(browser_window);
+    bool pushed = false;
+    glass_surf::WindowGeometry pushed_geometry;
+    #endif
+
+    while (!stop_requested) {
+        #ifdef _WIN32
+        glass_surf::WindowGeometry geometry = window_geometry.Current();
+        if (!pushed || geometry != pushed_geometry) {
+            std::string body;
+            unsigned status = connection.Send(http::verb::put, glass_surf::GeometryTarget(geometry), body);
+            if (status == 404) {
+                // The daemon restarted and forgot the session
+                status = Register(connection, session_target)
+                    ? connection.Send(http::verb::put, glass_surf::GeometryTarget(geometry), body) : 0;
+            }
+
+            // Pushed again on the next poll if it failed
+            pushed = status == 200;
+            pushed_geometry = geometry;
+        }
+        #endif
+
+        std::this_thread::sleep_for(kGeometryInterval);
+    }
+
+    std::string body;
+    connection.Send(http::verb::put, "/session/?close=1", body);
+    std::cout << "Session closed" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+// session_agent.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef SESSION_AGENT_H_
+#define SESSION_AGENT_H_
+
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief How the `agent` subcommand registers its user's session.
+	 */
+	struct SessionAgentOptions {
+		std::string config_path;        // Settings of the session, sent to the daemon if the file exists
+		std::string host = "127.0.0.1"; // Address of the daemon
+		unsigned short port = 0;        // Port of the daemon's /session/ and /geometry/
+		cv::Size screen;                // Screen resolution where it cannot be read from the desktop
+	};
+
+	/**
+	 * @brief Runs in a user's desktop session the part of the server a session
+	 * daemon cannot: it registers the session (wallpaper, screen resolution,
+	 * settings file) with a PUT to /session/ and, on Windows, tracks the browser
+	 * window and pushes its geometry to /geometry/ whenever it changes. The
+	 * daemon knows the user from the connection, so the extension needs nothing
+	 * more. Registers again if the daemon restarts, and ends the session when
+	 * interrupted. Blocks until then.
+	 *
+	 * @return 0 once stopped, 1 if the session could not be registered.
+	 */
+	int RunSessionAgent(const SessionAgentOptions& options);
+
+} // namespace glass_surf
+
+#endif // !SESSION_AGENT_H_
@@ -0,0 +1,472 @@
+// session_daemon.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "session_daemon.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio/signal_set.hpp>
+#include <nlohmann/json.hpp>
+
+#include "settings/settings_manager.h"
+#include "allocation_counter.h"
+#include "frame_source.h"
+#include "geometry_source.h"
+#include "http_utilities.h"
+#include "streaming_server.h"
+#include "surface_store.h"
+#include "tracer.h"
+#include "user_identity.h"
+
+namespace {
+
+    // Sessions without a request for this long are dropped when another one registers
+    constexpr auto kSessionTimeout = std::chrono::minutes(10);
+
+    struct Session {
+        glass_surf::PushedGeometrySource geometry;
+
+        std::mutex mutex; // Guards the fields below
+        std::shared_ptr<glass_surf::SharedSurface> surface;
+        bool visible = true; // Counted among the surface's visible sessions while true
+        bool served = false; // /bg/ answered since the session was (re)registered
+        glass_surf::WindowGeometry served_geometry;
+        uint64_t served_generation = 0;
+        std::chrono::steady_clock::time_point last_seen = std::chrono::steady_clock::now();
+
+        ~Session() {
+            if (surface && visible) {
+                surface->SetSessionVisible(false);
+            }
+        }
+
+        // Switches to another surface; returns the previous one, to be released without the lock held
+        std::shared_ptr<glass_surf::SharedSurface> Attach(std::shared_ptr<glass_surf::SharedSurface> new_surface) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (new_surface && visible) {
+                new_surface->SetSessionVisible(true);
+            }
+            if (surface && visible) {
+                surface->SetSessionVisible(false);
+            }
+
+            served = false;
+            surface.swap(new_surface);
+            return new_surface;
+        }
+
+        void SetVisible(bool new_visible) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (new_visible != visible && surface) {
+                surface->SetSessionVisible(new_visible);
+            }
+            visible = new_visible;
+        }
+
+        std::shared_ptr<glass_surf::SharedSurface> Surface() {
+            std::lock_guard<std::mutex> lock(mutex);
+            last_seen = std::chrono::steady_clock::now();
+            return surface;
+        }
+
+        void RecordServed(const glass_surf::WindowGeometry& served_window, uint64_t generation) {
+            std::lock_guard<std::mutex> lock(mutex);
+            served = true;
+            served_geometry = served_window;
+            served_generation = generation;
+        }
+
+        // The /state/ answer for this session: has its image changed since /bg/ last answered?
+        bool IsStale(const glass_surf::WindowGeometry& window) {
+            std::lock_guard<std::mutex> lock(mutex);
+            last_seen = std::chrono::steady_clock::now();
+
+            if (!surface || !window.visible()) {
+                return false;
+            }
+
+            std::shared_ptr<const glass_surf::Surface> current = surface->swap_chain().Current();
+            return !served || !served_geometry.SameRectangle(window)
+                || (current && current->generation != served_generation);
+        }
+
+        bool IsIdle(std::chrono::steady_clock::time_point now) {
+            std::lock_guard<std::mutex> lock(mutex);
+            return now - last_seen > kSessionTimeout;
+        }
+    };
+
+    // Sessions by the user they belong to
+    class SessionTable {
+    public:
+        // Returns nullptr for a user without a session
+        std::shared_ptr<Session> Find(const std::string& user) {
+            if (user.empty()) {
+                return nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = sessions_.find(user);
+            return it != sessions_.end() ? it->second : nullptr;
+        }
+
+        std::shared_ptr<Session> FindOrCreate(const std::string& user) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::shared_ptr<Session>& session = sessions_[user];
+            if (!session) {
+                session = std::make_shared<Session>();
+            }
+            return session;
+        }
+
+        void Remove(const std::string& user) {
+            // Released after the lock: the last session of a surface stops its renderer
+            std::shared_ptr<Session> session;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = sessions_.find(user);
+            if (it != sessions_.end()) {
+                session = std::move(it->second);
+                sessions_.erase(it);
+            }
+        }
+
+        // Returns the number of sessions dropped
+        size_t RemoveIdle() {
+            auto now = std::chrono::steady_clock::now();
+            std::vector<std::shared_ptr<Session>> removed;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = sessions_.begin(); it != sessions_.end();) {
+                if (it->second->IsIdle(now)) {
+                    removed.push_back(std::move(it->second));
+                    it = sessions_.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            return removed.size();
+        }
+
+        size_t size() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return sessions_.size();
+        }
+
+    private:
+        std::mutex mutex_;
+        std::map<std::string, std::shared_ptr<Session>> sessions_;
+    };
+
+    std::string DigestString(uint64_t digest) {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(digest));
+        return text;
+    }
+
+    // The same answer whether a file is missing, unreadable or not the user's,
+    // so /session/ cannot be used to probe other users' files
+    const std::string kUnusableFile = "Cannot use this file";
+
+    // Whether `path`, with links resolved, lies in one of `roots`
+    bool UnderRoot(const std::filesystem::path& path, const std::vector<std::filesystem::path>& roots) {
+        for (const std::filesystem::path& root : roots) {
+            auto mismatch = std::mismatch(root.begin(), root.end(), path.begin(), path.end());
+            if (mismatch.first == root.end()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // True if the daemon may read `path` for `user`: it lies under an allowed
+    // root or belongs to the user, as does every image of a slideshow directory.
+    // Links are resolved first, so a user's link cannot lead to another user's file.
+    // The paths that were checked come back in `resolved_path` and, for a directory,
+    // `resolved_images`; only those may be opened, as the originals can be relinked.
+    bool MayRead(const std::string& path, const std::string& user, const std::vector<std::filesystem::path>& roots,
+        std::string& resolved_path, std::vector<std::string>* resolved_images = nullptr) {
+        auto allowed = [&user, &roots](const std::string& file, std::string& resolved_file) {
+            std::error_code error;
+            std::filesystem::path resolved = std::filesystem::canonical(file, error);
+
+            std::string owner;
+            if (error || !(UnderRoot(resolved, roots) || (glass_surf::FileOwner(resolved, owner) && owner == user))) {
+                return false;
+            }
+
+            resolved_file = resolved.string();
+            return true;
+        };
+
+        if (path.empty() || !allowed(path, resolved_path)) {
+            return false;
+        }
+
+        std::error_code error;
+        if (resolved_images != nullptr && std::filesystem::is_directory(resolved_path, error)) {
+            resolved_images->clear();
+            for (const std::string& image_path : glass_surf::ListStillImages(resolved_path)) {
+                std::string resolved_image;
+                if (!allowed(image_path, resolved_image)) {
+                    return false;
+                }
+                resolved_images->push_back(resolved_image);
+            }
+        }
+
+        return true;
+    }
+
+    int IntegerParameter(const glass_surf::ChunkedResponse& response, const std::string& name, int default_value) {
+        const std::string value = response.Parameter(name);
+
+        int result = default_value;
+        std::from_chars(value.data(), value.data() + value.size(), result);
+
+        return result;
+    }
+
+    void Respond(glass_surf::ChunkedResponse& response, boost::beast::http::status status, const std::string& body,
+        const std::string& content_type = "text/plain") {
+        response.SetStatus(status);
+        response.SetHeader(boost::beast::http::field::content_type, content_type);
+        response.Write(reinterpret_cast<const uint8_t*>(body.data()), body.size());
+    }
+
+    void NotFound(glass_surf::ChunkedResponse& response) {
+        Respond(response, boost::beast::http::status::not_found, "No session for this user; start `GlassSurf agent`");
+    }
+
+} // namespace
+
+int glass_surf::RunSessionDaemon(const SessionDaemonOptions& options) {
+    // Settings of sessions that do not bring their own
+    settings::Settings default_settings;
+    if (std::filesystem::exists(options.config_path)) {
+        default_settings = settings::ReadSettingsFile(options.config_path);
+    }
+
+    // Directories every session may take wallpapers and settings from
+    std::vector<std::filesystem::path> allowed_roots;
+    for (const std::string& root : options.allowed_roots) {
+        std::error_code error;
+        std::filesystem::path resolved = std::filesystem::canonical(root, error);
+        if (error) {
+            std::cerr << "[ERROR]: Allowed root " << root << " does not exist" << std::endl;
+            continue;
+        }
+        allowed_roots.push_back(resolved);
+    }
+
+    SurfaceStore surface_store(options.cache_entries);
+    SessionTable sessions;
+
+    // Registers the session of the connecting user, or moves it to another
+    // configuration. Parameters: wallpaper, width, height, config (settings
+    // file; default: the daemon's), or close=1 to end it. Only the user's own
+    // files and those under the allowed roots are read; the daemon's wallpaper
+    // is the one path taken as is.
+    auto register_session = [&default_settings, &allowed_roots, &surface_store, &sessions](ChunkedResponse& response) {
+        const std::string& user = response.peer_user();
+        if (user.empty()) {
+            Respond(response, boost::beast::http::status::forbidden, "Cannot tell which user is connecting");
+            return;
+        }
+
+        if (response.Parameter("close") == "1") {
+            sessions.Remove(user);
+            Respond(response, boost::beast::http::status::ok, "OK");
+            return;
+        }
+
+        settings::Settings session_settings = default_settings;
+        const std::string config_path = response.Parameter("config");
+        if (!config_path.empty()) {
+            std::string resolved_config_path;
+            if (!MayRead(config_path, user, allowed_roots, resolved_config_path)) {
+                Respond(response, boost::beast::http::status::forbidden, kUnusableFile);
+                return;
+            }
+            session_settings = settings::ReadSettingsFile(resolved_config_path);
+        }
+
+        cv::Size resolution(IntegerParameter(response, "width", 0), IntegerParameter(response, "height", 0));
+        if (resolution.width <= 0 || resolution.height <= 0) {
+            Respond(response, boost::beast::http::status::bad_request, "Missing screen width or height");
+            return;
+        }
+
+        SurfaceConfiguration configuration;
+        configuration.wallpaper_path = response.Parameter("wallpaper");
+        if (configuration.wallpaper_path.empty()) {
+            configuration.wallpaper_path = session_settings.wallpaper;
+        }
+        if (configuration.wallpaper_path.empty()) {
+            Respond(response, boost::beast::http::status::bad_request, "Missing wallpaper");
+            return;
+        }
+        if (configuration.wallpaper_path != default_settings.wallpaper) {
+            std::string resolved_wallpaper_path;
+            if (!MayRead(configuration.wallpaper_path, user, allowed_roots, resolved_wallpaper_path,
+                &configuration.image_paths)) {
+                Respond(response, boost::beast::http::status::forbidden, kUnusableFile);
+                return;
+            }
+            configuration.wallpaper_path = resolved_wallpaper_path;
+        }
+        configuration.options = glass_surf::MakePipelineOptions(session_settings, resolution);
+        configuration.slideshow_interval = std::chrono::milliseconds(static_cast<int64_t>(session_settings.slideshowInterval * 1000.0));
+
+        std::shared_ptr<SharedSurface> surface = surface_store.Acquire(configuration);
+        if (!surface) {
+            Respond(response, boost::beast::http::status::forbidden, kUnusableFile);
+            return;
+        }
+
+        sessions.FindOrCreate(user)->Attach(surface);
+
+        size_t idle = sessions.RemoveIdle();
+        if (idle > 0) {
+            std::cout << "Dropped " << idle << " idle session(s)" << std::endl;
+        }
+
+        nlohmann::json response_json;
+        response_json["configuration"] = DigestString(surface->digest());
+
+        std::cout << "Session of user " << user << ": " << configuration.wallpaper_path << " at " << resolution.width
+            << "x" << resolution.height << ", configuration " << DigestString(surface->digest()) << " ("
+            << surface_store.size() << " for " << sessions.size() << " sessions)" << std::endl;
+
+        Respond(response, boost::beast::http::status::ok, response_json.dump(), "application/json");
+    };
+
+    // The browser window of the connecting user's session. Parameters: x, y,
+    // width, height, visibility (a name such as "minimized"); missing ones keep
+    // their value.
+    auto push_geometry = [&sessions](ChunkedResponse& response) {
+        std::shared_ptr<Session> session = sessions.Find(response.peer_user());
+        if (!session) {
+            NotFound(response);
+            return;
+        }
+
+        glass_surf::WindowGeometry geometry = session->geometry.Current();
+        geometry.x = IntegerParameter(response, "x", geometry.x);
+        geometry.y = IntegerParameter(response, "y", geometry.y);
+        geometry.width = IntegerParameter(response, "width", geometry.width);
+        geometry.height = IntegerParameter(response, "height", geometry.height);
+
+        const std::string visibility = response.Parameter("visibility");
+        if (!visibility.empty() && !glass_surf::ParseVisibility(visibility, geometry.visibility)) {
+            Respond(response, boost::beast::http::status::bad_request, "Unknown visibility");
+            return;
+        }
+
+        session->geometry.Push(geometry);
+        session->SetVisible(geometry.visible());
+
+        Respond(response, boost::beast::http::status::ok, "OK");
+    };
+
+    auto get_state = [&sessions](ChunkedResponse& response) {
+        glass_surf::AllocationScope allocation_scope("/state/");
+        GLASSSURF_TRACE_SCOPE("GET /state/");
+
+        // Polled by the extension from every page
+        response.SetHeader(boost::beast::http::field::access_control_allow_origin, "*");
+        response.SetHeader(boost::beast::http::field::access_control_expose_headers, glass_surf::kPollIntervalHeader);
+
+        std::shared_ptr<Session> session = sessions.Find(response.peer_user());
+        if (!session) {
+            NotFound(response);
+            return;
+        }
+
+        glass_surf::WindowGeometry geometry = session->geometry.Current();
+        if (!geometry.visible()) {
+            response.SetHeader(glass_surf::kPollIntervalHeader, glass_surf::kHiddenPollInterval);
+        }
+
+        // 0 = NOT CHANGED
+        // 1 = CHANGED (window geometry or wallpaper frame)
+        Respond(response, boost::beast::http::status::ok, session->IsStale(geometry) ? "1" : "0");
+    };
+
+    // Streamed while it is encoded
+    auto get_background = [&sessions](ChunkedResponse& response) {
+        glass_surf::AllocationScope allocation_scope("/bg/ (stream)");
+        GLASSSURF_TRACE_SCOPE("GET /bg/ (stream)");
+
+        response.SetHeader(boost::beast::http::field::access_control_allow_origin, "*");
+
+        std::shared_ptr<Session> session = sessions.Find(response.peer_user());
+        std::shared_ptr<SharedSurface> surface = session ? session->Surface() : nullptr;
+        if (!surface) {
+            NotFound(response);
+            return;
+        }
+
+        glass_surf::WindowGeometry geometry = session->geometry.Current();
+        uint64_t generation = 0;
+
+        response.SetHeader(boost::beast::http::field::content_type, "image/png");
+        response.SetHeader(boost::beast::http::field::cache_control, "private, max-age=60");
+        bool encoded = surface->cache().Stream(geometry, [&response](const uint8_t* data, size_t size) {
+            response.Write(data, size);
+        }, &generation);
+
+        if (!encoded) {
+            response.Abort();
+            return;
+        }
+
+        session->RecordServed(geometry, generation);
+    };
+
+    // Both ports the extension knows serve every route; requests are told apart
+    // by the user owning their connection
+    StreamingServer http_server;
+    StreamingServer streaming_server;
+    for (StreamingServer* server : { &http_server, &streaming_server }) {
+        server->IdentifyPeers(true);
+        // Changes state, so no CORS headers: pages cannot send the PUTs cross-origin
+        server->AddRoute("/session/", register_session, boost::beast::http::verb::put);
+        server->AddRoute("/geometry/", push_geometry, boost::beast::http::verb::put);
+        server->AddRoute("/state/", get_state);
+        server->AddRoute("/bg/", get_background);
+    }
+
+    if (!http_server.Listen(options.port) || !streaming_server.Listen(options.stream_port)) {
+        return 1;
+    }
+
+    std::cout << "Serving sessions on ports " << options.port << " and " << options.stream_port << std::endl;
+
+    // Until interrupted
+    boost::asio::io_context signal_context;
+    boost::asio::signal_set signals(signal_context, SIGINT, SIGTERM);
+    signals.async_wait([](const boost::system::error_code&, int) {});
+    signal_context.run();
+
+    streaming_server.Stop();
+    http_server.Stop();
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+// session_daemon.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef SESSION_DAEMON_H_
+#define SESSION_DAEMON_H_
+
+#include <string>
+#include <vector>
+
+namespace glass_surf {
+
+	/**
+	 * @brief How the `daemon` subcommand serves its sessions.
+	 */
+	struct SessionDaemonOptions {
+		std::string config_path;        // Settings of sessions that register without their own
+		unsigned short port = 0;        // Port the extension polls /state/ on
+		unsigned short stream_port = 0; // Port the extension streams /bg/ from
+		size_t cache_entries = 4;       // Encoded images kept per surface, for sessions with different windows
+		std::vector<std::string> allowed_roots; // Directories any session may read wallpapers and settings from
+	};
+
+	/**
+	 * @brief Serves many user sessions (e.g. on a terminal server) from one process.
+	 *
+	 * A session belongs to a user. The daemon finds the user owning every
+	 * loopback connection (LoopbackPeerUser), so a user's browser is served the
+	 * session registered by that user, with no token to pass around, and no
+	 * other user can reach it. A session is registered with a PUT to /session/
+	 * (wallpaper, screen resolution, optionally its own settings file); the
+	 * daemon reads only files owned by the user or under an allowed root. Its
+	 * browser window geometry is pushed with PUTs to /geometry/, and the
+	 * extension polls /state/ and /bg/ on either port as it polls the
+	 * single-user server. Sessions whose wallpaper bytes, resolution and settings
+	 * hash to the same digest share one SharedSurface from a SurfaceStore, and
+	 * with it the rendering and the encoded images. Blocks until interrupted.
+	 *
+	 * @return 0 once stopped, 1 if a port could not be bound.
+	 */
+	int RunSessionDaemon(const SessionDaemonOptions& options);
+
+} // namespace glass_surf
+
+#endif // !SESSION_DAEMON_H_
@@ -15,6 +15,24 @@ void glass_surf::settings::SaveSettingsFile(Settings settings, std::string filen
     file_data["blend_color"] = settings.blendColor;
     file_data["blur_radius"] = settings.blurRadius;
     file_data["browser"] = settings.browser;
+    file_data["linear_light"] = settings.linearLight;
+    file_data["shared_memory_name"] = settings.sharedMemoryName;
+    file_data["wallpaper"] = settings.wallpaper;
+    file_data["slideshow_interval"] = settings.slideshowInterval;
+    file_data["surface_storage"] = settings.surfaceStorage;
+    file_data["noise_seed"] = settings.noiseSeed;
+    file_data["profile_cache_mb"] = settings.profileCacheMegabytes;
+
+    file_data["profiles"] = nlohmann::json::object();
+    for (const Profile& profile : settings.profiles) {
+        file_data["profiles"][profile.name] = {
+            {"theme", profile.theme},
+            {"blend_color", profile.blendColor},
+            {"blur_radius", profile.blurRadius},
+            {"linear_light", profile.linearLight},
+            {"noise_seed", profile.noiseSeed},
+        };
+    }
 
     std::ofstream file(filename);
     file << file_data.dump() << std::endl;
@@ -48,6 +66,54 @@ glass_surf::settings::Settings glass_surf::settings::ReadSettingsFile(std::strin
         if (json_data.contains("browser")) {
             tmp_settings.browser = json_data["browser"];
         }
+        if (json_data.contains("linear_light")) {
+            tmp_settings.linearLight = json_data["linear_light"];
+        }
+        if (json_data.contains("shared_memory_name")) {
+            tmp_settings.sharedMemoryName = json_data["shared_memory_name"];
+        }
+        if (json_data.contains("wallpaper")) {
+            tmp_settings.wallpaper = json_data["wallpaper"];
+        }
+        if (json_data.contains("slideshow_interval")) {
+            tmp_settings.slideshowInterval = json_data["slideshow_interval"];
+        }
+        if (json_data.contains("surface_storage")) {
+            tmp_settings.surfaceStorage = json_data["surface_storage"];
+        }
+        if (json_data.contains("noise_seed")) {
+            tmp_settings.noiseSeed = json_data["noise_seed"];
+        }
+        if (json_data.contains("profile_cache_mb")) {
+            tmp_settings.profileCacheMegabytes = json_data["profile_cache_mb"];
+        }
+
+        // After the top-level keys, which profiles inherit
+        if (json_data.contains("profiles")) {
+            for (const auto& item : json_data["profiles"].items()) {
+                Profile profile = BaseProfile(tmp_settings);
+                profile.name = item.key();
+
+                const nlohmann::json& profile_data = item.value();
+                if (profile_data.contains("theme")) {
+                    profile.theme = profile_data["theme"];
+                }
+                if (profile_data.contains("blend_color")) {
+                    profile.blendColor = profile_data["blend_color"];
+                }
+                if (profile_data.contains("blur_radius")) {
+                    profile.blurRadius = profile_data["blur_radius"];
+                }
+                if (profile_data.contains("linear_light")) {
+                    profile.linearLight = profile_data["linear_light"];
+                }
+                if (profile_data.contains("noise_seed")) {
+                    profile.noiseSeed = profile_data["noise_seed"];
+                }
+
+                tmp_settings.profiles.push_back(profile);
+            }
+        }
     } catch (const nlohmann::json::exception& e) {
         // Handle JSON parsing error
         std::cerr << "Error parsing JSON: " << e.what() << std::endl;
@@ -59,6 +125,18 @@ glass_surf::settings::Settings glass_surf::settings::ReadSettingsFile(std::strin
     return tmp_settings;
 }
 
+glass_surf::settings::Profile glass_surf::settings::BaseProfile(const Settings& settings) {
+    Profile profile;
+
+    profile.theme = settings.theme;
+    profile.blendColor = settings.blendColor;
+    profile.blurRadius = settings.blurRadius;
+    profile.linearLight = settings.linearLight;
+    profile.noiseSeed = settings.noiseSeed;
+
+    return profile;
+}
+
 void glass_surf::settings::PrintSettings(const Settings &settings) {
     std::cout << "Browser: " << settings.browser << std::endl;
     std::cout << "Theme: ";
@@ -79,4 +157,35 @@ void glass_surf::settings::PrintSettings(const Settings &settings) {
 
     std::cout << "Blend Color: " << settings.blendColor << std::endl;
     std::cout << "Blur Radius: " << settings.blurRadius << std::endl;
+    std::cout << "Linear Light: " << (settings.linearLight ? "ON" : "OFF") << std::endl;
+    if (!settings.sharedMemoryName.empty()) {
+        std::cout << "Shared Memory: " << settings.sharedMemoryName << std::endl;
+    }
+    if (!settings.wallpaper.empty()) {
+        std::cout << "Wallpaper: " << settings.wallpaper << std::endl;
+        std::cout << "Slideshow Interval: " << settings.slideshowInterval << std::endl;
+    }
+
+    std::cout << "Surface Storage: ";
+
+    switch (settings.surfaceStorage) {
+        case SurfaceStorage::FULL:
+            std::cout << "FULL";
+            break;
+        case SurfaceStorage::YCRCB420:
+            std::cout << "YCRCB420";
+            break;
+        case SurfaceStorage::HALF:
+            std::cout << "HALF";
+            break;
+    }
+    std::cout << std::endl;
+
+    if (!settings.profiles.empty()) {
+        std::cout << "Profiles:";
+        for (const Profile& profile : settings.profiles) {
+            std::cout << " " << profile.name;
+        }
+        std::cout << " (" << settings.profileCacheMegabytes << " MB)" << std::endl;
+    }
 }
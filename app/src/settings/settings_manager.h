@@ -9,6 +9,7 @@
 
 #include <nlohmann/json.hpp>
 #include <fstream>
+#include <vector>
 
 namespace glass_surf {
     namespace settings {
@@ -21,6 +22,34 @@ namespace glass_surf {
             LIGHT,
         };
 
+        /**
+         * @brief How the processed surface is kept in memory.
+         *
+         * The surface is blurred, so the compact forms lose little: YCRCB420 keeps
+         * full-resolution luma with quarter-resolution chroma (half the memory of
+         * FULL), HALF renders at half resolution (a quarter of the memory).
+         */
+        enum class SurfaceStorage {
+            FULL,
+            YCRCB420,
+            HALF,
+        };
+
+        /**
+         * @brief A named variant of the processing, e.g. a darker tint for one site.
+         *
+         * Read from the "profiles" object of the config file, keyed by name; the
+         * fields it leaves out are the top-level ones.
+         */
+        struct Profile {
+            std::string name;
+            Themes theme = Themes::ACRYLIC;
+            std::string blendColor = "#000000";
+            double blurRadius = 25.0;
+            bool linearLight = false;
+            unsigned int noiseSeed = 0x6e6f6973;
+        };
+
         /**
          * @brief Struct representing configurable settings for the Glass Surf library.
          */
@@ -29,8 +58,21 @@ namespace glass_surf {
             Themes theme = Themes::ACRYLIC;
             std::string blendColor = "#000000";
             double blurRadius = 25.0;
+            bool linearLight = false;
+            std::string sharedMemoryName = ""; // Empty disables the shared memory frame ring
+            std::string wallpaper = "";        // Image, slideshow directory or animation; empty uses the desktop wallpaper
+            double slideshowInterval = 60.0;   // Seconds between slideshow images
+            SurfaceStorage surfaceStorage = SurfaceStorage::FULL;
+            unsigned int noiseSeed = 0x6e6f6973; // Seed of the theme's grain tile
+            std::vector<Profile> profiles;       // Selected with /bg/?profile=
+            double profileCacheMegabytes = 64.0; // Memory for the processed surfaces of profiles
         };
 
+        /**
+         * @brief Returns the top-level processing settings as an unnamed profile.
+         */
+        Profile BaseProfile(const Settings& settings);
+
         /**
          * @brief Save the provided settings to a JSON file.
          * @param settings The settings to be saved.
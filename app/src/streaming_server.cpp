@@ -0,0 +1,412 @@
+// streaming_server.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "streaming_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string_view>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+#include <boost/asio/post.hpp>
+#include <boost/beast/core/buffers_suffix.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+
+#include "http_utilities.h"
+#include "tracer.h"
+#include "user_identity.h"
+
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+
+namespace {
+
+    // Blocking asio writes have no timeout: a client that stops reading would
+    // hold its connection's thread, and anything waiting on it, forever
+    constexpr std::chrono::milliseconds kWriteTimeout(5000);
+
+    bool WaitWritable(tcp::socket& socket, std::chrono::steady_clock::time_point deadline) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return false;
+        }
+
+#ifdef _WIN32
+        WSAPOLLFD descriptor{};
+        descriptor.fd = socket.native_handle();
+        descriptor.events = POLLWRNORM;
+        return WSAPoll(&descriptor, 1, static_cast<INT>(remaining.count())) > 0;
+#else
+        pollfd descriptor{};
+        descriptor.fd = socket.native_handle();
+        descriptor.events = POLLOUT;
+        return poll(&descriptor, 1, static_cast<int>(remaining.count())) > 0;
+#endif
+    }
+
+    int HexDigit(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    // Query parameters as browsers encode them: %XX escapes, '+' for a space
+    std::string PercentDecode(std::string_view text) {
+        std::string decoded;
+        decoded.reserve(text.size());
+
+        for (size_t i = 0; i < text.size(); ++i) {
+            int high = text[i] == '%' && i + 2 < text.size() ? HexDigit(text[i + 1]) : -1;
+            int low = high >= 0 ? HexDigit(text[i + 2]) : -1;
+
+            if (low >= 0) {
+                decoded.push_back(static_cast<char>(high * 16 + low));
+                i += 2;
+            }
+            else {
+                decoded.push_back(text[i] == '+' ? ' ' : text[i]);
+            }
+        }
+
+        return decoded;
+    }
+
+    // Writes all of `buffers` unless the connection fails or the client takes
+    // no bytes for kWriteTimeout
+    template <typename ConstBufferSequence>
+    bool WriteAll(tcp::socket& socket, const ConstBufferSequence& buffers) {
+        auto deadline = std::chrono::steady_clock::now() + kWriteTimeout;
+        boost::beast::buffers_suffix<ConstBufferSequence> remaining(buffers);
+
+        // Non-blocking only while writing: requests are still read blocking
+        boost::system::error_code error;
+        socket.non_blocking(true, error);
+
+        while (!error && net::buffer_size(remaining) > 0) {
+            size_t written = socket.write_some(remaining, error);
+            remaining.consume(written);
+
+            if (error == net::error::would_block) {
+                error = WaitWritable(socket, deadline) ? boost::system::error_code() : net::error::timed_out;
+            }
+        }
+
+        boost::system::error_code mode_error;
+        socket.non_blocking(false, mode_error);
+
+        return !error;
+    }
+
+} // namespace
+
+glass_surf::ChunkedResponse::ChunkedResponse(tcp::socket& socket, unsigned version, bool keep_alive, std::string query,
+    std::string peer_user)
+    : socket_(socket), query_(std::move(query)), peer_user_(std::move(peer_user)), header_(http::status::ok, version) {
+    header_.keep_alive(keep_alive);
+    header_.chunked(true);
+}
+
+std::string glass_surf::ChunkedResponse::Parameter(const std::string& name) const {
+    std::string_view query(query_);
+
+    while (!query.empty()) {
+        std::string_view parameter = query.substr(0, query.find('&'));
+        query.remove_prefix(std::min(parameter.size() + 1, query.size()));
+
+        std::string_view key = parameter.substr(0, parameter.find('='));
+        if (key == name) {
+            return PercentDecode(parameter.substr(std::min(key.size() + 1, parameter.size())));
+        }
+    }
+
+    return std::string();
+}
+
+const std::string& glass_surf::ChunkedResponse::peer_user() const {
+    return peer_user_;
+}
+
+void glass_surf::ChunkedResponse::SetHeader(http::field field, const std::string& value) {
+    if (!header_sent_) {
+        header_.set(field, value);
+    }
+}
+
+void glass_surf::ChunkedResponse::SetHeader(const std::string& name, const std::string& value) {
+    if (!header_sent_) {
+        header_.set(name, value);
+    }
+}
+
+void glass_surf::ChunkedResponse::SetStatus(http::status status) {
+    if (!header_sent_) {
+        header_.result(status);
+    }
+}
+
+bool glass_surf::ChunkedResponse::Write(const uint8_t* data, size_t size) {
+    if (failed_ || size == 0) {
+        return !failed_;
+    }
+
+    if (pending_.empty() && size >= kFlushThreshold) {
+        return SendChunk(data, size);
+    }
+
+    pending_.insert(pending_.end(), data, data + size);
+    if (pending_.size() < kFlushThreshold) {
+        return true;
+    }
+
+    bool sent = SendChunk(pending_.data(), pending_.size());
+    pending_.clear();
+
+    return sent;
+}
+
+bool glass_surf::ChunkedResponse::Finish() {
+    if (!pending_.empty()) {
+        SendChunk(pending_.data(), pending_.size());
+        pending_.clear();
+    }
+
+    if (failed_ || !SendHeader()) {
+        return false;
+    }
+
+    GLASSSURF_TRACE_SCOPE("socket write");
+    failed_ = !WriteAll(socket_, http::make_chunk_last());
+
+    return !failed_;
+}
+
+void glass_surf::ChunkedResponse::Abort() {
+    pending_.clear();
+
+    if (header_sent_) {
+        failed_ = true;
+    }
+    else {
+        header_.result(http::status::internal_server_error);
+    }
+}
+
+bool glass_surf::ChunkedResponse::failed() const {
+    return failed_;
+}
+
+bool glass_surf::ChunkedResponse::header_sent() const {
+    return header_sent_;
+}
+
+bool glass_surf::ChunkedResponse::SendHeader() {
+    if (header_sent_ || failed_) {
+        return !failed_;
+    }
+
+    GLASSSURF_TRACE_SCOPE("socket write");
+    boost::system::error_code error;
+    bool written = true;
+    http::response_serializer<http::empty_body> serializer(header_);
+    serializer.split(true);
+    while (written && !error && !serializer.is_header_done()) {
+        serializer.next(error, [this, &serializer, &written](boost::system::error_code&, const auto& buffers) {
+            written = WriteAll(socket_, buffers);
+            serializer.consume(net::buffer_size(buffers));
+        });
+    }
+
+    header_sent_ = true;
+    failed_ = !written || static_cast<bool>(error);
+
+    return !failed_;
+}
+
+bool glass_surf::ChunkedResponse::SendChunk(const uint8_t* data, size_t size) {
+    if (!SendHeader()) {
+        return false;
+    }
+
+    GLASSSURF_TRACE_SCOPE("socket write");
+    failed_ = !WriteAll(socket_, http::make_chunk(net::const_buffer(data, size)));
+
+    return !failed_;
+}
+
+glass_surf::StreamingServer::StreamingServer() : acceptor_(io_context_) {}
+
+glass_surf::StreamingServer::~StreamingServer() {
+    Stop();
+}
+
+void glass_surf::StreamingServer::AddRoute(const std::string& path, Handler handler, http::verb method) {
+    routes_[path] = Route{ method, std::move(handler) };
+}
+
+void glass_surf::StreamingServer::IdentifyPeers(bool identify) {
+    identify_peers_ = identify;
+}
+
+bool glass_surf::StreamingServer::Listen(unsigned short port) {
+    boost::system::error_code error;
+    tcp::endpoint endpoint(net::ip::address_v4::loopback(), port);
+
+    acceptor_.open(endpoint.protocol(), error);
+    if (!error) {
+        acceptor_.set_option(net::socket_base::reuse_address(true), error);
+        acceptor_.bind(endpoint, error);
+    }
+    if (!error) {
+        acceptor_.listen(net::socket_base::max_listen_connections, error);
+    }
+    if (error) {
+        std::cerr << "[ERROR]: Streaming server could not listen on port " << port << ": "
+            << error.message() << std::endl;
+        acceptor_.close(error);
+        return false;
+    }
+
+    running_ = true;
+    Accept();
+    accept_thread_ = std::thread([this]() { io_context_.run(); });
+
+    return true;
+}
+
+void glass_surf::StreamingServer::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    net::post(io_context_, [this]() {
+        boost::system::error_code error;
+        acceptor_.close(error);
+    });
+
+    if (accept_thread_.joinable()) {
+        accept_thread_.join();
+    }
+
+    // Wakes connection threads blocked in a read or write
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    for (Connection& connection : connections_) {
+        boost::system::error_code error;
+        connection.socket->shutdown(tcp::socket::shutdown_both, error);
+    }
+    for (Connection& connection : connections_) {
+        if (connection.thread.joinable()) {
+            connection.thread.join();
+        }
+    }
+    connections_.clear();
+}
+
+void glass_surf::StreamingServer::Accept() {
+    auto socket = std::make_shared<tcp::socket>(io_context_);
+
+    acceptor_.async_accept(*socket, [this, socket](const boost::system::error_code& error) {
+        if (error || !running_) {
+            return;
+        }
+
+        JoinFinishedConnections();
+
+        // Headers, chunks and the last chunk are separate small writes; with Nagle the
+        // last one would wait for the client's delayed ACK
+        boost::system::error_code option_error;
+        socket->set_option(tcp::no_delay(true), option_error);
+
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            Connection& connection = connections_.emplace_back();
+            connection.socket = socket;
+            connection.thread = std::thread([this, &connection]() { Serve(connection); });
+        }
+
+        Accept();
+    });
+}
+
+void glass_surf::StreamingServer::Serve(Connection& connection) {
+    glass_surf::SetTraceThreadName("stream connection");
+
+    tcp::socket& socket = *connection.socket;
+    boost::beast::flat_buffer buffer;
+
+    // A connection keeps its owner, so it is looked up once
+    std::string peer_user;
+    if (identify_peers_) {
+        glass_surf::LoopbackPeerUser(socket, peer_user);
+    }
+
+    for (;;) {
+        boost::system::error_code error;
+        http::request<http::empty_body> request;
+        http::read(socket, buffer, request, error);
+        if (error) {
+            break;
+        }
+
+        std::string_view target(request.target().data(), request.target().size());
+        size_t query_start = target.find('?');
+        std::string_view query = query_start == std::string_view::npos ? std::string_view() : target.substr(query_start + 1);
+        target = target.substr(0, query_start);
+
+        auto route = routes_.find(std::string(target));
+
+        bool keep_alive = request.keep_alive();
+        ChunkedResponse response(socket, request.version(), keep_alive, std::string(query), peer_user);
+
+        std::string_view host(request[http::field::host].data(), request[http::field::host].size());
+        if (!glass_surf::IsLoopbackHost(host)) {
+            response.SetStatus(http::status::forbidden);
+        }
+        else if (route == routes_.end()) {
+            response.SetStatus(http::status::not_found);
+        }
+        else if (request.method() != route->second.method) {
+            response.SetStatus(http::status::method_not_allowed);
+        }
+        else {
+            route->second.handler(response);
+        }
+
+        if (!response.Finish() || !keep_alive) {
+            break;
+        }
+    }
+
+    boost::system::error_code error;
+    socket.shutdown(tcp::socket::shutdown_send, error);
+
+    connection.done = true;
+}
+
+void glass_surf::StreamingServer::JoinFinishedConnections() {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+
+    for (auto it = connections_.begin(); it != connections_.end();) {
+        if (it->done) {
+            it->thread.join();
+            it = connections_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
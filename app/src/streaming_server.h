@@ -0,0 +1,188 @@
+// streaming_server.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef STREAMING_SERVER_H_
+#define STREAMING_SERVER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/http.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief An HTTP response sent with chunked transfer encoding while it is produced.
+	 *
+	 * The status line and headers go out with the first bytes of the body. Small
+	 * writes are coalesced until kFlushThreshold bytes are pending; larger ones
+	 * are sent as a chunk right away, without copying.
+	 */
+	class ChunkedResponse {
+	public:
+		static constexpr size_t kFlushThreshold = 16 * 1024;
+
+		ChunkedResponse(boost::asio::ip::tcp::socket& socket, unsigned version, bool keep_alive,
+			std::string query = std::string(), std::string peer_user = std::string());
+
+		/**
+		 * @brief Returns the percent-decoded query parameter `name` of the request,
+		 * or an empty string if it is missing.
+		 */
+		std::string Parameter(const std::string& name) const;
+
+		/**
+		 * @brief Returns the user owning the client end of the connection (see
+		 * LoopbackPeerUser), or an empty string unless the server identifies peers.
+		 */
+		const std::string& peer_user() const;
+
+		/**
+		 * @brief Sets a header; ignored once the headers were sent.
+		 */
+		void SetHeader(boost::beast::http::field field, const std::string& value);
+
+		/**
+		 * @brief Sets a header Beast has no field for; ignored once the headers were sent.
+		 */
+		void SetHeader(const std::string& name, const std::string& value);
+
+		/**
+		 * @brief Sets the status; ignored once the headers were sent.
+		 */
+		void SetStatus(boost::beast::http::status status);
+
+		/**
+		 * @brief Appends body bytes, sending them once enough are pending.
+		 *
+		 * @return False if the connection failed.
+		 */
+		bool Write(const uint8_t* data, size_t size);
+
+		/**
+		 * @brief Sends pending bytes and the terminating chunk.
+		 *
+		 * @return False if the connection failed.
+		 */
+		bool Finish();
+
+		/**
+		 * @brief Drops the response. Before the headers went out it becomes an empty
+		 * 500 response; afterwards the connection is closed without the terminating
+		 * chunk, so the client sees a truncated body instead of a complete one.
+		 */
+		void Abort();
+
+		/**
+		 * @brief Returns true if writing to the connection failed or the response was aborted.
+		 */
+		bool failed() const;
+
+		/**
+		 * @brief Returns true once the headers, the first bytes of the response, were sent.
+		 */
+		bool header_sent() const;
+
+	private:
+		bool SendHeader();
+		bool SendChunk(const uint8_t* data, size_t size);
+
+		boost::asio::ip::tcp::socket& socket_;
+		std::string query_; // The request target after '?'
+		std::string peer_user_;
+		boost::beast::http::response<boost::beast::http::empty_body> header_;
+		std::vector<uint8_t> pending_;
+		bool header_sent_ = false;
+		bool failed_ = false;
+	};
+
+	/**
+	 * @brief A minimal HTTP/1.1 server for routes that stream their response.
+	 *
+	 * beauty only sends complete bodies, so routes that benefit from flushing
+	 * bytes as they are produced (the encoded background) are served here. Each
+	 * connection is handled on its own thread with blocking I/O; a write the
+	 * client takes no bytes of for 5 seconds fails the response. The server only
+	 * binds the loopback interface and answers only requests naming it as their
+	 * Host, so a page cannot reach it through a domain rebound to 127.0.0.1.
+	 * Routes set their own CORS headers.
+	 */
+	class StreamingServer {
+	public:
+		using Handler = std::function<void(ChunkedResponse& response)>;
+
+		StreamingServer();
+		~StreamingServer();
+
+		StreamingServer(const StreamingServer&) = delete;
+		StreamingServer& operator=(const StreamingServer&) = delete;
+
+		/**
+		 * @brief Registers the handler for a path; the query string is ignored when
+		 * matching, other methods are answered with 405.
+		 */
+		void AddRoute(const std::string& path, Handler handler,
+			boost::beast::http::verb method = boost::beast::http::verb::get);
+
+		/**
+		 * @brief Looks up the user of every connection's client (LoopbackPeerUser)
+		 * for ChunkedResponse::peer_user; call before Listen.
+		 */
+		void IdentifyPeers(bool identify);
+
+		/**
+		 * @brief Binds 127.0.0.1:port and starts accepting connections on a background thread.
+		 *
+		 * @return False if the port could not be bound.
+		 */
+		bool Listen(unsigned short port);
+
+		/**
+		 * @brief Stops accepting, closes open connections and joins all threads.
+		 */
+		void Stop();
+
+	private:
+		struct Route {
+			boost::beast::http::verb method;
+			Handler handler;
+		};
+
+		struct Connection {
+			std::shared_ptr<boost::asio::ip::tcp::socket> socket;
+			std::thread thread;
+			std::atomic<bool> done{ false };
+		};
+
+		void Accept();
+		void Serve(Connection& connection);
+		void JoinFinishedConnections();
+
+		boost::asio::io_context io_context_;
+		boost::asio::ip::tcp::acceptor acceptor_;
+		std::thread accept_thread_;
+
+		std::map<std::string, Route> routes_;
+		bool identify_peers_ = false;
+
+		std::mutex connections_mutex_;
+		std::list<Connection> connections_;
+		std::atomic<bool> running_{ false };
+	};
+
+} // namespace glass_surf
+
+#endif // !STREAMING_SERVER_H_
@@ -0,0 +1,139 @@
+// surface.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "surface.h"
+
+#include <atomic>
+
+namespace {
+
+    // Resamples the part of `source` that covers `region` of a surface of `surface_size`,
+    // so only the pixels of the crop are interpolated
+    void ResampleRegion(const cv::Mat& source, cv::Size surface_size, const cv::Rect& region, cv::Mat& resampled) {
+        double scale_x = static_cast<double>(source.cols) / surface_size.width;
+        double scale_y = static_cast<double>(source.rows) / surface_size.height;
+
+        // Maps crop pixel centers to source pixel centers
+        cv::Matx23d crop_to_source(
+            scale_x, 0.0, scale_x * (region.x + 0.5) - 0.5,
+            0.0, scale_y, scale_y * (region.y + 0.5) - 0.5);
+
+        cv::warpAffine(source, resampled, crop_to_source, region.size(),
+            cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+    }
+
+} // namespace
+
+cv::Mat glass_surf::Surface::Crop(const cv::Rect& region, SurfaceCropBuffers& buffers) const {
+    cv::Rect clipped = region & cv::Rect(0, 0, size.width, size.height);
+    if (clipped.width <= 0 || clipped.height <= 0 || image.empty()) {
+        return cv::Mat();
+    }
+
+    switch (storage) {
+        case SurfaceStorage::FULL:
+            return image(clipped);
+
+        case SurfaceStorage::HALF:
+            ResampleRegion(image, size, clipped, buffers.bgr);
+            return buffers.bgr;
+
+        case SurfaceStorage::YCRCB420: {
+            ResampleRegion(chroma, size, clipped, buffers.chroma);
+
+            cv::Mat planes[] = { image(clipped), buffers.chroma };
+            cv::merge(planes, 2, buffers.ycrcb);
+            cv::cvtColor(buffers.ycrcb, buffers.bgr, cv::COLOR_YCrCb2BGR);
+
+            return buffers.bgr;
+        }
+    }
+
+    return cv::Mat();
+}
+
+void glass_surf::Surface::StoreYCrCb420(const cv::Mat& bgr, cv::Mat& ycrcb) {
+    cv::cvtColor(bgr, ycrcb, cv::COLOR_BGR2YCrCb);
+
+    image.create(bgr.size(), CV_8UC1);
+    cv::extractChannel(ycrcb, image, 0);
+
+    cv::Mat reduced;
+    cv::resize(ycrcb, reduced, StorageResolution(bgr.size(), SurfaceStorage::HALF), 0, 0, cv::INTER_AREA);
+
+    const int from_to[] = { 1, 0, 2, 1 };
+    chroma.create(reduced.size(), CV_8UC2);
+    cv::mixChannels(&reduced, 1, &chroma, 1, from_to, 2);
+}
+
+size_t glass_surf::Surface::ByteSize() const {
+    return image.total() * image.elemSize() + chroma.total() * chroma.elemSize();
+}
+
+cv::Size glass_surf::StorageResolution(cv::Size size, SurfaceStorage storage) {
+    if (storage == SurfaceStorage::HALF) {
+        return cv::Size((size.width + 1) / 2, (size.height + 1) / 2);
+    }
+
+    return size;
+}
+
+glass_surf::SurfaceSwapChain::SurfaceSwapChain(cv::Size size, SurfaceStorage storage, size_t pool_size) {
+    for (size_t i = 0; i < pool_size; ++i) {
+        auto surface = std::make_shared<Surface>();
+        surface->storage = storage;
+        surface->size = size;
+
+        if (storage == SurfaceStorage::YCRCB420) {
+            surface->image.create(size, CV_8UC1);
+            surface->chroma.create(StorageResolution(size, SurfaceStorage::HALF), CV_8UC2);
+        }
+        else {
+            surface->image.create(StorageResolution(size, storage), CV_8UC3);
+        }
+
+        pool_.push_back(std::move(surface));
+    }
+}
+
+std::shared_ptr<const glass_surf::Surface> glass_surf::SurfaceSwapChain::Current() const {
+    return current_.load(std::memory_order_acquire);
+}
+
+std::shared_ptr<glass_surf::Surface> glass_surf::SurfaceSwapChain::AcquireBack() {
+    // The pool owns one reference; any other one is the front slot or a reader.
+    // Readers only get references from the front slot, so a surface seen with a
+    // single owner cannot be picked up concurrently.
+    for (const std::shared_ptr<Surface>& surface : pool_) {
+        if (surface.use_count() == 1) {
+            // use_count() is a relaxed load; pairs with the release of the last reader's
+            // reference, so its reads of the surface happen before we overwrite it
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return surface;
+        }
+    }
+
+    return nullptr;
+}
+
+void glass_surf::SurfaceSwapChain::Publish(const std::shared_ptr<Surface>& surface) {
+    surface->generation = next_generation_++;
+
+    current_.store(surface, std::memory_order_release);
+}
+
+void glass_surf::SurfaceSwapChain::ReleaseIdle() {
+    // Same ownership and ordering argument as AcquireBack
+    for (const std::shared_ptr<Surface>& surface : pool_) {
+        if (surface.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            surface->image.release();
+            surface->chroma.release();
+            surface->luminosity = LuminosityIndex();
+            surface->base.reset();
+        }
+    }
+}
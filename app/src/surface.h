@@ -0,0 +1,145 @@
+// surface.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef SURFACE_H_
+#define SURFACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "settings/settings_manager.h"
+#include "luminosity_index.h"
+
+namespace glass_surf {
+
+	using settings::SurfaceStorage;
+
+	/**
+	 * @brief Scratch images for converting crops of compact surfaces, reused between crops.
+	 */
+	struct SurfaceCropBuffers {
+		cv::Mat chroma;
+		cv::Mat ycrcb;
+		cv::Mat bgr;
+	};
+
+	/**
+	 * @brief A processed wallpaper frame, ready to be cropped.
+	 *
+	 * Surfaces are written by the renderer only while they are not published;
+	 * once published they are read-only.
+	 */
+	struct Surface {
+		SurfaceStorage storage = SurfaceStorage::FULL;
+		cv::Size size; // Resolution the surface stands for, whatever the storage
+
+		// FULL: BGR at `size`. HALF: BGR at a reduced resolution (half of `size`, less for
+		// placeholders). YCRCB420: the luma plane at `size`.
+		cv::Mat image;
+		// YCRCB420 only: interleaved Cr/Cb at half of `size` (CV_8UC2)
+		cv::Mat chroma;
+
+		LuminosityIndex luminosity;
+
+		// The resized frame before tint and blur, at the storage's render resolution;
+		// only kept for ProfileSurfaces (SurfaceRenderer::KeepResizedBase)
+		std::shared_ptr<const cv::Mat> base;
+
+		// Increases with every publish, used to invalidate encoded crops
+		uint64_t generation = 0;
+
+		// Served during startup until the first real frame is published
+		bool placeholder = false;
+
+		/**
+		 * @brief Returns the BGR pixels of a rectangle in surface coordinates.
+		 *
+		 * The rectangle is clipped to the surface. FULL storage returns a view into
+		 * the surface; compact storage is converted into `buffers.bgr` on the fly.
+		 *
+		 * @param region The rectangle in surface pixel coordinates.
+		 * @param buffers Conversion scratch, reused between calls.
+		 * @return The crop (CV_8UC3), empty if the rectangle is outside the surface.
+		 */
+		cv::Mat Crop(const cv::Rect& region, SurfaceCropBuffers& buffers) const;
+
+		/**
+		 * @brief Stores a processed full-resolution BGR frame as luma plus half-resolution chroma.
+		 *
+		 * @param bgr The processed frame, at `size`.
+		 * @param ycrcb Conversion scratch.
+		 */
+		void StoreYCrCb420(const cv::Mat& bgr, cv::Mat& ycrcb);
+
+		/**
+		 * @brief Returns the number of bytes held by the pixel planes.
+		 */
+		size_t ByteSize() const;
+	};
+
+	/**
+	 * @brief Returns the resolution the pipeline renders at for a storage mode.
+	 */
+	cv::Size StorageResolution(cv::Size size, SurfaceStorage storage);
+
+	/**
+	 * @brief A fixed pool of surfaces with one published ("front") surface.
+	 *
+	 * Readers take a reference to the front surface with Current() and keep it for
+	 * as long as they use it. The renderer writes into a pooled surface no reader
+	 * holds and publishes it with an atomic swap, so requests never wait for a frame
+	 * and no surface memory is allocated after construction.
+	 */
+	class SurfaceSwapChain {
+	public:
+		/**
+		 * @param size Surface resolution; the images are allocated up front.
+		 * @param storage How the surfaces keep their pixels.
+		 * @param pool_size Number of surfaces, two for double buffering.
+		 */
+		SurfaceSwapChain(cv::Size size, SurfaceStorage storage = SurfaceStorage::FULL, size_t pool_size = 2);
+
+		/**
+		 * @brief Returns the published surface, or nullptr before the first Publish.
+		 */
+		std::shared_ptr<const Surface> Current() const;
+
+		/**
+		 * @brief Returns a pooled surface that is neither published nor held by a reader.
+		 *
+		 * @return nullptr if every surface is in use; the caller should drop the frame.
+		 */
+		std::shared_ptr<Surface> AcquireBack();
+
+		/**
+		 * @brief Publishes a surface obtained from AcquireBack, or a standalone one
+		 * such as a placeholder (which is never reused by AcquireBack).
+		 */
+		void Publish(const std::shared_ptr<Surface>& surface);
+
+		/**
+		 * @brief Frees the pixels and luminosity tables of every surface that is neither
+		 * published nor held by a reader.
+		 *
+		 * For sources that rarely produce a frame, so the back surface does not keep a
+		 * full frame resident in between. The next AcquireBack user reallocates it.
+		 * Must be called from the thread that calls AcquireBack.
+		 */
+		void ReleaseIdle();
+
+	private:
+		std::vector<std::shared_ptr<Surface>> pool_;
+		std::atomic<std::shared_ptr<const Surface>> current_;
+		uint64_t next_generation_ = 1;
+	};
+
+} // namespace glass_surf
+
+#endif // !SURFACE_H_
@@ -0,0 +1,303 @@
+// surface_store.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "surface_store.h"
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "tracer.h"
+
+namespace {
+
+    constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+    constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+    void Hash(uint64_t& digest, const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            digest = (digest ^ bytes[i]) * kFnvPrime;
+        }
+    }
+
+    template <typename T>
+    void HashValue(uint64_t& digest, const T& value) {
+        Hash(digest, &value, sizeof(value));
+    }
+
+    bool ReadFile(const std::string& path, std::vector<uint8_t>& bytes) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        std::streamoff size = file.tellg();
+        if (size < 0) {
+            return false;
+        }
+        bytes.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(bytes.data()), size);
+
+        return file.gcount() == size;
+    }
+
+    uint64_t HashBytes(const std::vector<uint8_t>& bytes) {
+        uint64_t digest = kFnvOffsetBasis;
+        Hash(digest, bytes.data(), bytes.size());
+
+        return digest;
+    }
+
+    // A still image of a wallpaper, with the digest of its bytes when they were read
+    struct PinnedImage {
+        std::string path;
+        uint64_t digest = 0;
+        std::vector<uint8_t> bytes; // Kept for a single image, so it is never read again
+    };
+
+    // Decodes exactly the bytes the configuration digest was computed from: a single
+    // image from the bytes read for the digest, slideshow images from bytes hashed as
+    // they are read again, skipping any that changed since
+    class PinnedImageSource : public glass_surf::FrameSource {
+    public:
+        PinnedImageSource(std::vector<PinnedImage> images, std::chrono::milliseconds interval)
+            : images_(std::move(images)), interval_(interval) {}
+
+        bool NextFrame(cv::Mat& frame) override {
+            // Skip unreadable or changed files, but give up after one full round
+            for (size_t attempt = 0; attempt < images_.size(); ++attempt) {
+                PinnedImage& image = images_[next_index_];
+                next_index_ = (next_index_ + 1) % images_.size();
+
+                std::vector<uint8_t> bytes = std::move(image.bytes);
+                image.bytes.clear();
+                if (bytes.empty() && !ReadFile(image.path, bytes)) {
+                    std::cerr << "[ERROR]: Reading " << image.path << " failed!" << std::endl;
+                    continue;
+                }
+                if (HashBytes(bytes) != image.digest) {
+                    std::cerr << "[ERROR]: " << image.path << " changed since its surface was shared; skipped" << std::endl;
+                    continue;
+                }
+
+                GLASSSURF_TRACE_SCOPE("decode");
+                frame = cv::imdecode(bytes, cv::IMREAD_COLOR);
+                if (!frame.empty()) {
+                    return true;
+                }
+                std::cerr << "[ERROR]: Decoding " << image.path << " failed!" << std::endl;
+            }
+
+            return false;
+        }
+
+        std::chrono::milliseconds FrameInterval() const override {
+            // A single image never changes
+            return images_.size() > 1 ? interval_ : std::chrono::milliseconds(0);
+        }
+
+    private:
+        std::vector<PinnedImage> images_;
+        std::chrono::milliseconds interval_;
+        size_t next_index_ = 0;
+    };
+
+    // Reads the wallpaper for its digest. Still images come back in `images`, to be
+    // decoded by a PinnedImageSource; `images` stays empty for a frame sequence.
+    bool ReadWallpaper(const glass_surf::SurfaceConfiguration& configuration, uint64_t& digest,
+        std::vector<PinnedImage>& images) {
+        digest = kFnvOffsetBasis;
+        images.clear();
+
+        std::error_code error;
+        if (std::filesystem::is_directory(configuration.wallpaper_path, error)) {
+            // A slideshow is its images in order, read again while it plays: only
+            // sessions naming the same files share it
+            std::vector<std::string> image_paths = configuration.image_paths.empty()
+                ? glass_surf::ListStillImages(configuration.wallpaper_path) : configuration.image_paths;
+            if (image_paths.empty()) {
+                std::cerr << "[ERROR]: No images in " << configuration.wallpaper_path << std::endl;
+                return false;
+            }
+
+            for (const std::string& image_path : image_paths) {
+                PinnedImage image;
+                image.path = image_path;
+                std::vector<uint8_t> bytes;
+                if (!ReadFile(image_path, bytes)) {
+                    std::cerr << "[ERROR]: Reading " << image_path << " failed!" << std::endl;
+                    return false;
+                }
+                image.digest = HashBytes(bytes);
+                if (image_paths.size() == 1) {
+                    image.bytes = std::move(bytes);
+                }
+
+                Hash(digest, image_path.data(), image_path.size());
+                HashValue(digest, image.digest);
+                images.push_back(std::move(image));
+            }
+            HashValue(digest, configuration.slideshow_interval.count());
+        }
+        else if (glass_surf::IsFrameSequence(configuration.wallpaper_path)) {
+            // Decoded from the file while it plays
+            std::vector<uint8_t> bytes;
+            if (!ReadFile(configuration.wallpaper_path, bytes)) {
+                std::cerr << "[ERROR]: Reading " << configuration.wallpaper_path << " failed!" << std::endl;
+                return false;
+            }
+            Hash(digest, configuration.wallpaper_path.data(), configuration.wallpaper_path.size());
+            HashValue(digest, HashBytes(bytes));
+        }
+        else {
+            PinnedImage image;
+            image.path = configuration.wallpaper_path;
+            if (!ReadFile(image.path, image.bytes)) {
+                std::cerr << "[ERROR]: Reading " << image.path << " failed!" << std::endl;
+                return false;
+            }
+            image.digest = HashBytes(image.bytes);
+
+            HashValue(digest, image.digest);
+            images.push_back(std::move(image));
+        }
+
+        // Field by field, so padding bytes stay out of the digest
+        const glass_surf::PipelineOptions& options = configuration.options;
+        HashValue(digest, options.resolution.width);
+        HashValue(digest, options.resolution.height);
+        HashValue(digest, options.tint);
+        HashValue(digest, options.tint_color.red);
+        HashValue(digest, options.tint_color.green);
+        HashValue(digest, options.tint_color.blue);
+        HashValue(digest, options.blur_radius);
+        HashValue(digest, options.linear_light);
+        HashValue(digest, options.theme);
+        HashValue(digest, options.noise_seed);
+        HashValue(digest, options.storage);
+
+        return true;
+    }
+
+} // namespace
+
+bool glass_surf::ConfigurationDigest(const SurfaceConfiguration& configuration, uint64_t& digest) {
+    std::vector<PinnedImage> images;
+    return ReadWallpaper(configuration, digest, images);
+}
+
+glass_surf::SharedSurface::SharedSurface(const SurfaceConfiguration& configuration, std::unique_ptr<FrameSource> source,
+    uint64_t digest, size_t cache_entries)
+    : digest_(digest), swap_chain_(configuration.options.resolution, configuration.options.storage),
+    cache_(swap_chain_, cache_entries), renderer_(swap_chain_, configuration.options) {
+    // Paused until a session that can see its window attaches
+    renderer_.SetPaused(true);
+
+    // The thumbnail and the first frame are built on the renderer thread
+    swap_chain_.Publish(glass_surf::MakePlaceholderSurface(configuration.options));
+    renderer_.Start(std::move(source), configuration.wallpaper_path);
+}
+
+uint64_t glass_surf::SharedSurface::digest() const {
+    return digest_;
+}
+
+const glass_surf::SurfaceSwapChain& glass_surf::SharedSurface::swap_chain() const {
+    return swap_chain_;
+}
+
+glass_surf::BackgroundCache& glass_surf::SharedSurface::cache() {
+    return cache_;
+}
+
+void glass_surf::SharedSurface::SetSessionVisible(bool visible) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    bool was_paused = visible_sessions_ == 0;
+    visible_sessions_ = visible ? visible_sessions_ + 1 : visible_sessions_ - 1;
+
+    if (was_paused != (visible_sessions_ == 0)) {
+        renderer_.SetPaused(visible_sessions_ == 0);
+    }
+}
+
+glass_surf::SurfaceStore::SurfaceStore(size_t cache_entries) : cache_entries_(cache_entries) {}
+
+std::shared_ptr<glass_surf::SharedSurface> glass_surf::SurfaceStore::Acquire(const SurfaceConfiguration& configuration) {
+    uint64_t digest;
+    std::vector<PinnedImage> images;
+    if (!ReadWallpaper(configuration, digest, images)) {
+        return nullptr;
+    }
+
+    // Building a surface starts a renderer: the first caller builds it unlocked,
+    // later callers with the same digest wait for it
+    std::promise<std::shared_ptr<SharedSurface>> promise;
+    std::shared_future<std::shared_ptr<SharedSurface>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // Drop the entries of surfaces no session holds any more
+        for (auto it = surfaces_.begin(); it != surfaces_.end();) {
+            bool unused = it->second.surface.expired() && !it->second.pending.valid();
+            it = unused ? surfaces_.erase(it) : std::next(it);
+        }
+
+        Entry& entry = surfaces_[digest];
+        if (std::shared_ptr<SharedSurface> surface = entry.surface.lock()) {
+            return surface;
+        }
+
+        if (!entry.pending.valid()) {
+            entry.pending = promise.get_future().share();
+        }
+        else {
+            pending = entry.pending;
+        }
+    }
+
+    if (pending.valid()) {
+        return pending.get();
+    }
+
+    std::unique_ptr<FrameSource> source = images.empty()
+        ? glass_surf::CreateFrameSource(configuration.wallpaper_path, configuration.slideshow_interval)
+        : std::make_unique<PinnedImageSource>(std::move(images), configuration.slideshow_interval);
+
+    std::shared_ptr<SharedSurface> surface;
+    try {
+        surface = std::make_shared<SharedSurface>(configuration, std::move(source), digest, cache_entries_);
+    }
+    catch (const std::exception& exception) {
+        // Waiting callers get nullptr rather than a broken promise
+        std::cerr << "[ERROR]: Starting a shared surface failed: " << exception.what() << std::endl;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        Entry& entry = surfaces_[digest];
+        entry.surface = surface;
+        entry.pending = std::shared_future<std::shared_ptr<SharedSurface>>();
+    }
+    promise.set_value(surface);
+
+    return surface;
+}
+
+size_t glass_surf::SurfaceStore::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t alive = 0;
+    for (const auto& surface : surfaces_) {
+        alive += surface.second.surface.expired() ? 0 : 1;
+    }
+    return alive;
+}
@@ -0,0 +1,130 @@
+// surface_store.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef SURFACE_STORE_H_
+#define SURFACE_STORE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "background_cache.h"
+#include "frame_source.h"
+#include "pipeline.h"
+#include "surface.h"
+
+namespace glass_surf {
+
+	/**
+	 * @brief Everything a processed surface depends on.
+	 */
+	struct SurfaceConfiguration {
+		std::string wallpaper_path; // Image, slideshow directory or animation
+		std::vector<std::string> image_paths; // Slideshow images as the caller checked them; empty: listed from wallpaper_path
+		PipelineOptions options;
+		std::chrono::milliseconds slideshow_interval{ 0 };
+	};
+
+	/**
+	 * @brief Hashes the wallpaper bytes (of every image, for a slideshow
+	 * directory), the resolution and the pipeline options into a digest
+	 * identifying the surface they produce.
+	 *
+	 * For a still image the path is left out, so the same wallpaper copied into
+	 * every user profile has one digest; the surface is decoded from the very
+	 * bytes hashed. Slideshows and animations are read again while they play, so
+	 * their path is part of the digest: only sessions naming the same files share
+	 * them. 64-bit FNV-1a: fine for telling configurations apart, not meant to
+	 * withstand crafted collisions.
+	 *
+	 * @return False if the wallpaper cannot be read.
+	 */
+	bool ConfigurationDigest(const SurfaceConfiguration& configuration, uint64_t& digest);
+
+	/**
+	 * @brief A surface rendered once for every session with the same configuration,
+	 * with the encoded-image cache those sessions share.
+	 *
+	 * The renderer is paused while no attached session can see its browser window.
+	 */
+	class SharedSurface {
+	public:
+		/**
+		 * @param source The frames of the configuration's wallpaper.
+		 */
+		SharedSurface(const SurfaceConfiguration& configuration, std::unique_ptr<FrameSource> source,
+			uint64_t digest, size_t cache_entries);
+
+		SharedSurface(const SharedSurface&) = delete;
+		SharedSurface& operator=(const SharedSurface&) = delete;
+
+		uint64_t digest() const;
+
+		const SurfaceSwapChain& swap_chain() const;
+
+		BackgroundCache& cache();
+
+		/**
+		 * @brief Counts a session's browser window in (true) or out (false) of the visible ones.
+		 */
+		void SetSessionVisible(bool visible);
+
+	private:
+		uint64_t digest_;
+		SurfaceSwapChain swap_chain_;
+		BackgroundCache cache_;
+		SurfaceRenderer renderer_; // Declared last: stopped before the rest goes away
+
+		std::mutex mutex_;
+		size_t visible_sessions_ = 0;
+	};
+
+	/**
+	 * @brief Content-addressed SharedSurfaces: sessions whose configurations have
+	 * the same digest get the same surface.
+	 *
+	 * A surface lives as long as a session holds it; the store only keeps weak
+	 * references. Memory and rendering so grow with the number of distinct
+	 * configurations in use, not with the number of sessions. May be called
+	 * from any thread; surfaces are built outside the store's lock, and callers
+	 * asking for one being built wait for it.
+	 */
+	class SurfaceStore {
+	public:
+		explicit SurfaceStore(size_t cache_entries);
+
+		/**
+		 * @brief Returns the surface of a configuration, creating and starting it if no session holds it.
+		 *
+		 * @return nullptr if the wallpaper cannot be read.
+		 */
+		std::shared_ptr<SharedSurface> Acquire(const SurfaceConfiguration& configuration);
+
+		/**
+		 * @brief Returns the number of surfaces held by sessions.
+		 */
+		size_t size();
+
+	private:
+		size_t cache_entries_;
+
+		struct Entry {
+			std::weak_ptr<SharedSurface> surface;
+			std::shared_future<std::shared_ptr<SharedSurface>> pending; // Valid while the surface is built
+		};
+
+		std::mutex mutex_;
+		std::map<uint64_t, Entry> surfaces_;
+	};
+
+} // namespace glass_surf
+
+#endif // !SURFACE_STORE_H_
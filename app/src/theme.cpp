@@ -0,0 +1,94 @@
+// theme.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "theme.h"
+
+#include <algorithm>
+
+#include "tracer.h"
+
+namespace {
+
+    using glass_surf::Themes;
+
+    // Mixes `value` towards `target` by opacity/256
+    template <int opacity>
+    inline int Mix(int value, int target) {
+        return value + (((target - value) * opacity) >> 8);
+    }
+
+    template <Themes theme>
+    void ThemeKernel(const cv::Mat& image, cv::Mat& themed_image) {
+        constexpr glass_surf::ThemePreset preset = glass_surf::ThemeTraits<theme>::preset;
+
+        for (int i = 0; i < image.rows; ++i) {
+            const uchar* src = image.ptr<uchar>(i);
+            uchar* dst = themed_image.ptr<uchar>(i);
+
+            for (int j = 0; j < image.cols; ++j) {
+                int b = src[3 * j + 0];
+                int g = src[3 * j + 1];
+                int r = src[3 * j + 2];
+
+                if constexpr (preset.luminosity_opacity > 0) {
+                    // Shifting all channels by the same amount moves the (BT.601) luma and keeps the chroma
+                    int luma = (29 * b + 150 * g + 77 * r) >> 8;
+                    int shift = Mix<preset.luminosity_opacity>(luma, preset.luminosity) - luma;
+                    b = std::clamp(b + shift, 0, 255);
+                    g = std::clamp(g + shift, 0, 255);
+                    r = std::clamp(r + shift, 0, 255);
+                }
+
+                if constexpr (preset.tint_opacity > 0) {
+                    b = Mix<preset.tint_opacity>(b, preset.tint_color[0]);
+                    g = Mix<preset.tint_opacity>(g, preset.tint_color[1]);
+                    r = Mix<preset.tint_opacity>(r, preset.tint_color[2]);
+                }
+
+                if constexpr (preset.exclusion_opacity > 0) {
+                    // Exclusion with white is 255 - c
+                    b = Mix<preset.exclusion_opacity>(b, 255 - b);
+                    g = Mix<preset.exclusion_opacity>(g, 255 - g);
+                    r = Mix<preset.exclusion_opacity>(r, 255 - r);
+                }
+
+                dst[3 * j + 0] = cv::saturate_cast<uchar>(b);
+                dst[3 * j + 1] = cv::saturate_cast<uchar>(g);
+                dst[3 * j + 2] = cv::saturate_cast<uchar>(r);
+            }
+        }
+    }
+
+} // namespace
+
+glass_surf::ThemePreset glass_surf::GetThemePreset(Themes theme) {
+    switch (theme) {
+        case Themes::DARK:
+            return ThemeTraits<Themes::DARK>::preset;
+        case Themes::LIGHT:
+            return ThemeTraits<Themes::LIGHT>::preset;
+        default:
+            return ThemeTraits<Themes::ACRYLIC>::preset;
+    }
+}
+
+void glass_surf::ApplyTheme(const cv::Mat& image, Themes theme, cv::Mat& themed_image) {
+    GLASSSURF_TRACE_SCOPE("theme");
+    themed_image.create(image.rows, image.cols, CV_8UC3);
+
+    // One branch per image; each kernel is specialized for its preset
+    switch (theme) {
+        case Themes::DARK:
+            ThemeKernel<Themes::DARK>(image, themed_image);
+            break;
+        case Themes::LIGHT:
+            ThemeKernel<Themes::LIGHT>(image, themed_image);
+            break;
+        default:
+            ThemeKernel<Themes::ACRYLIC>(image, themed_image);
+            break;
+    }
+}
@@ -0,0 +1,79 @@
+// theme.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef THEME_H_
+#define THEME_H_
+
+#include <opencv2/opencv.hpp>
+
+#include "settings/settings_manager.h"
+
+namespace glass_surf {
+
+	using settings::Themes;
+
+	/**
+	 * @brief The material a theme lays over the blurred surface.
+	 *
+	 * Opacities are in 1/256 steps, colors and levels in 8-bit sRGB. The layers
+	 * are applied in member order: the luminosity blend moves each pixel's luma
+	 * towards `luminosity` while keeping its chroma, the tint mixes in
+	 * `tint_color`, and the exclusion blends with white (pulling both ends of
+	 * the range towards the middle). Last, a NoiseLayer adds up to
+	 * `noise_amplitude` levels of monochrome grain.
+	 */
+	struct ThemePreset {
+		int luminosity_opacity;
+		int luminosity;
+		int tint_opacity;
+		uchar tint_color[3]; // BGR
+		int exclusion_opacity;
+		int noise_amplitude;
+	};
+
+	/**
+	 * @brief The preset of each theme, a compile-time constant.
+	 */
+	template <Themes theme>
+	struct ThemeTraits;
+
+	// Flattens the wallpaper towards a neutral mid-grey, as the acrylic recipe does
+	template <>
+	struct ThemeTraits<Themes::ACRYLIC> {
+		static constexpr ThemePreset preset = { 64, 128, 26, { 128, 128, 128 }, 13, 4 };
+	};
+
+	template <>
+	struct ThemeTraits<Themes::DARK> {
+		static constexpr ThemePreset preset = { 128, 40, 64, { 32, 32, 32 }, 0, 3 };
+	};
+
+	template <>
+	struct ThemeTraits<Themes::LIGHT> {
+		static constexpr ThemePreset preset = { 128, 235, 64, { 243, 243, 243 }, 0, 3 };
+	};
+
+	/**
+	 * @brief Returns the preset of a theme, for reports.
+	 */
+	ThemePreset GetThemePreset(Themes theme);
+
+	/**
+	 * @brief Lays a theme's material over a blurred BGR image.
+	 *
+	 * Each theme has its own instantiation of the kernel, with the preset folded
+	 * in as constants: layers a theme does not use are compiled out, and the
+	 * inner loop has no branch per pixel. The grain is left to NoiseLayer.
+	 *
+	 * @param image The blurred surface (CV_8UC3).
+	 * @param theme The theme to apply.
+	 * @param themed_image Receives the result; may be `image` itself.
+	 */
+	void ApplyTheme(const cv::Mat& image, Themes theme, cv::Mat& themed_image);
+
+} // namespace glass_surf
+
+#endif // !THEME_H_
@@ -0,0 +1,142 @@
+// thread_pool.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+namespace {
+
+    // Set on worker threads only
+    thread_local const glass_surf::WorkStealingPool* current_pool = nullptr;
+    thread_local int current_worker = -1;
+
+} // namespace
+
+glass_surf::WorkStealingPool::WorkStealingPool(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back(&WorkStealingPool::Run, this, i);
+    }
+}
+
+glass_surf::WorkStealingPool::~WorkStealingPool() {
+    Wait();
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_condition_.notify_all();
+
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void glass_surf::WorkStealingPool::Submit(Job job) {
+    ++pending_;
+
+    // Jobs submitted by a worker stay local, others are spread round-robin
+    size_t index = current_pool == this ? static_cast<size_t>(current_worker)
+        : next_queue_++ % queues_.size();
+
+    {
+        // Counted before the job is visible, so a worker that pops it never
+        // decrements below zero; under the lock so a worker about to sleep
+        // cannot miss it. A worker woken early finds the deque empty and retries
+        // until the push below.
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        ++queued_;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->jobs.push_back(std::move(job));
+    }
+    wake_condition_.notify_one();
+}
+
+void glass_surf::WorkStealingPool::Wait() {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    idle_condition_.wait(lock, [this] { return pending_ == 0; });
+}
+
+size_t glass_surf::WorkStealingPool::thread_count() const {
+    return threads_.size();
+}
+
+int glass_surf::WorkStealingPool::CurrentWorker() {
+    return current_worker;
+}
+
+void glass_surf::WorkStealingPool::Run(size_t index) {
+    current_pool = this;
+    current_worker = static_cast<int>(index);
+
+    Job job;
+
+    while (true) {
+        if (TryPop(index, job)) {
+            try {
+                job();
+            }
+            catch (const std::exception& e) {
+                std::cerr << "[ERROR]: Job failed: " << e.what() << std::endl;
+            }
+            job = nullptr;
+
+            if (--pending_ == 0) {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                idle_condition_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_condition_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+        if (stopping_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+bool glass_surf::WorkStealingPool::TryPop(size_t index, Job& job) {
+    // Own deque first, newest job
+    {
+        Queue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            --queued_;
+            return true;
+        }
+    }
+
+    // Then steal the oldest job of the next busy worker
+    for (size_t offset = 1; offset < queues_.size(); ++offset) {
+        Queue& victim = *queues_[(index + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            --queued_;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,90 @@
+// thread_pool.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace glass_surf {
+
+	/**
+	 * @brief A fixed set of worker threads with one job deque each.
+	 *
+	 * A worker runs the newest job of its own deque first and, when that is
+	 * empty, steals the oldest job of another worker. Jobs submitted from inside
+	 * a job go to the submitting worker's deque, so a job that fans out into
+	 * smaller ones tends to finish them (depth first) before the worker picks up
+	 * unrelated work, while idle workers take over the rest.
+	 */
+	class WorkStealingPool {
+	public:
+		using Job = std::function<void()>;
+
+		/**
+		 * @param thread_count Number of workers; 0 uses one per hardware thread.
+		 */
+		explicit WorkStealingPool(size_t thread_count = 0);
+
+		/**
+		 * @brief Waits for all jobs, then joins the workers.
+		 */
+		~WorkStealingPool();
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+		/**
+		 * @brief Queues a job. May be called from any thread, including from a job.
+		 *
+		 * Exceptions escaping a job are reported on stderr and otherwise ignored.
+		 */
+		void Submit(Job job);
+
+		/**
+		 * @brief Blocks until every submitted job, and every job they submitted, has finished.
+		 */
+		void Wait();
+
+		size_t thread_count() const;
+
+		/**
+		 * @brief Returns the index of the calling worker in its pool, or -1 outside any pool.
+		 */
+		static int CurrentWorker();
+
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		void Run(size_t index);
+		bool TryPop(size_t index, Job& job);
+
+		std::vector<std::unique_ptr<Queue>> queues_;
+		std::vector<std::thread> threads_;
+
+		std::mutex wake_mutex_;
+		std::condition_variable wake_condition_; // Jobs were queued, or stopping
+		std::condition_variable idle_condition_; // pending_ reached zero
+		std::atomic<size_t> queued_{ 0 };  // In a deque
+		std::atomic<size_t> pending_{ 0 }; // Submitted and not finished
+		std::atomic<size_t> next_queue_{ 0 };
+		bool stopping_ = false;
+	};
+
+} // namespace glass_surf
+
+#endif // !THREAD_POOL_H_
@@ -0,0 +1,22 @@
+// thread_utilities.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef THREAD_UTILITIES_H_
+#define THREAD_UTILITIES_H_
+
+namespace glass_surf {
+
+	/**
+	 * @brief Lowers the scheduling priority of the calling thread.
+	 *
+	 * Used for background work (re-rendering the wallpaper) that must not compete
+	 * with request handling or with the user's foreground applications.
+	 */
+	void LowerCurrentThreadPriority();
+
+} // namespace glass_surf
+
+#endif // !THREAD_UTILITIES_H_
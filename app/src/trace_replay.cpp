@@ -0,0 +1,283 @@
+// trace_replay.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "trace_replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <boost/beast/http.hpp>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "geometry_trace.h"
+#include "http_client.h"
+
+namespace {
+
+    namespace http = boost::beast::http;
+    using Clock = std::chrono::steady_clock;
+
+    constexpr glass_surf::TraceRecord kRequestRecords[] = {
+        glass_surf::TraceRecord::STATE_REQUEST, glass_surf::TraceRecord::BACKGROUND_REQUEST,
+        glass_surf::TraceRecord::BACKGROUND_STREAM_REQUEST, glass_surf::TraceRecord::CONTRAST_REQUEST
+    };
+
+    const char* RecordName(glass_surf::TraceRecord record) {
+        switch (record) {
+        case glass_surf::TraceRecord::STATE_REQUEST: return "/state/";
+        case glass_surf::TraceRecord::BACKGROUND_REQUEST: return "/bg/";
+        case glass_surf::TraceRecord::BACKGROUND_STREAM_REQUEST: return "/bg/ (stream)";
+        case glass_surf::TraceRecord::CONTRAST_REQUEST: return "/contrast/";
+        default: return "geometry";
+        }
+    }
+
+    struct Request {
+        glass_surf::TraceRecord record;
+        Clock::time_point scheduled;
+    };
+
+    struct Sample {
+        glass_surf::TraceRecord record;
+        double latency_ms;
+        size_t bytes;
+        bool succeeded;
+    };
+
+    class RequestQueue {
+    public:
+        void Push(const Request& request) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                requests_.push_back(request);
+            }
+            condition_.notify_one();
+        }
+
+        void Close() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_ = true;
+            }
+            condition_.notify_all();
+        }
+
+        // Returns false once the queue is closed and empty
+        bool Pop(Request& request) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return closed_ || !requests_.empty(); });
+            if (requests_.empty()) {
+                return false;
+            }
+
+            request = requests_.front();
+            requests_.pop_front();
+            return true;
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        std::deque<Request> requests_;
+        bool closed_ = false;
+    };
+
+    // CPU time (user + system) of a process, 0 for this one; negative where it cannot be read
+    double ProcessCpuMilliseconds(int pid) {
+#ifdef __linux__
+        std::ifstream file(pid > 0 ? "/proc/" + std::to_string(pid) + "/stat" : std::string("/proc/self/stat"));
+        std::string stat((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // The command name may contain spaces; the fields after it do not
+        size_t name_end = stat.rfind(')');
+        if (name_end == std::string::npos) {
+            return -1.0;
+        }
+
+        // State is field 3, utime and stime are fields 14 and 15
+        std::istringstream fields(stat.substr(name_end + 2));
+        std::string field;
+        for (int i = 3; i < 14 && fields >> field; ++i) {}
+
+        unsigned long long user_ticks = 0;
+        unsigned long long system_ticks = 0;
+        if (!(fields >> user_ticks >> system_ticks)) {
+            return -1.0;
+        }
+
+        return static_cast<double>(user_ticks + system_ticks) * 1000.0 / static_cast<double>(sysconf(_SC_CLK_TCK));
+#else
+        return -1.0;
+#endif
+    }
+
+    // Nearest-rank percentile of sorted values
+    double Percentile(const std::vector<double>& sorted, double percentile) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+
+        size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    void PrintCpuTime(const char* label, double milliseconds, double wall_ms) {
+        std::cout << label;
+        if (milliseconds < 0.0) {
+            std::cout << "n/a" << std::endl;
+            return;
+        }
+        std::cout << milliseconds << " ms (" << (wall_ms > 0.0 ? 100.0 * milliseconds / wall_ms : 0.0)
+            << "% of one core)" << std::endl;
+    }
+
+} // namespace
+
+int glass_surf::RunTraceReplay(const TraceReplayOptions& options) {
+    GeometryTrace trace;
+    if (!ReadGeometryTrace(options.trace_path, trace)) {
+        return 1;
+    }
+
+    if (trace.events.empty()) {
+        std::cerr << "[ERROR]: The trace " << options.trace_path << " has no records" << std::endl;
+        return 1;
+    }
+
+    double speed = options.speed > 0.0 ? options.speed : 1.0;
+    size_t connections = std::max<size_t>(options.connections, 1);
+    double recorded_s = static_cast<double>(trace.events.back().time_us) / 1e6;
+
+    std::cout << "Replaying " << trace.events.size() << " record(s), " << std::fixed << std::setprecision(1)
+        << recorded_s << " s recorded on a " << trace.screen_width << "x" << trace.screen_height
+        << " screen, at " << speed << "x on " << connections << " connection(s)" << std::endl;
+
+    boost::asio::io_context io_context;
+    glass_surf::HttpConnection control(io_context, options.host, options.port);
+
+    RequestQueue queue;
+    std::vector<std::vector<Sample>> worker_samples(connections);
+    std::vector<std::thread> workers;
+
+    double client_cpu_start = ProcessCpuMilliseconds(0);
+    double server_cpu_start = options.server_pid > 0 ? ProcessCpuMilliseconds(options.server_pid) : -1.0;
+
+    for (size_t i = 0; i < connections; ++i) {
+        workers.emplace_back([&, i]() {
+            glass_surf::HttpConnection connection(io_context, options.host, options.port);
+            glass_surf::HttpConnection stream_connection(io_context, options.host, options.stream_port);
+
+            Request request;
+            std::string body;
+            while (queue.Pop(request)) {
+                unsigned status;
+                switch (request.record) {
+                case TraceRecord::STATE_REQUEST: status = connection.Send(http::verb::get, "/state/", body); break;
+                case TraceRecord::BACKGROUND_REQUEST: status = connection.Send(http::verb::get, "/bg/", body); break;
+                case TraceRecord::BACKGROUND_STREAM_REQUEST: status = stream_connection.Send(http::verb::get, "/bg/", body); break;
+                default: status = connection.Send(http::verb::get, "/contrast/", body); break;
+                }
+
+                double latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - request.scheduled).count();
+                worker_samples[i].push_back(Sample{ request.record, latency_ms, body.size(), status == 200 });
+            }
+        });
+    }
+
+    // Geometry goes out in order on this thread, requests to the workers
+    size_t geometry_updates = 0;
+    size_t geometry_errors = 0;
+    auto start = Clock::now();
+
+    for (const TraceEvent& event : trace.events) {
+        auto scheduled = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::micro>(static_cast<double>(event.time_us) / speed));
+        std::this_thread::sleep_until(scheduled);
+
+        if (event.record != TraceRecord::GEOMETRY) {
+            queue.Push(Request{ event.record, scheduled });
+            continue;
+        }
+
+        std::string body;
+        ++geometry_updates;
+        if (control.Send(http::verb::put, glass_surf::GeometryTarget(event.geometry), body) != 200) {
+            ++geometry_errors;
+            if (geometry_updates == 1) {
+                std::cerr << "[ERROR]: The server did not accept /geometry/; start it with --pushed-geometry" << std::endl;
+            }
+        }
+    }
+
+    queue.Close();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    double client_cpu_ms = client_cpu_start < 0.0 ? -1.0 : ProcessCpuMilliseconds(0) - client_cpu_start;
+    double server_cpu_ms = server_cpu_start < 0.0 ? -1.0 : ProcessCpuMilliseconds(options.server_pid) - server_cpu_start;
+
+    // Report
+    std::cout << std::left << std::setw(16) << "route" << std::right << std::setw(8) << "count"
+        << std::setw(8) << "errors" << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+        << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << std::setw(12) << "avg bytes" << std::endl;
+
+    size_t requests = 0;
+    size_t failed = 0;
+    for (TraceRecord record : kRequestRecords) {
+        std::vector<double> latencies;
+        size_t errors = 0;
+        size_t bytes = 0;
+        for (const std::vector<Sample>& samples : worker_samples) {
+            for (const Sample& sample : samples) {
+                if (sample.record == record) {
+                    latencies.push_back(sample.latency_ms);
+                    errors += sample.succeeded ? 0 : 1;
+                    bytes += sample.bytes;
+                }
+            }
+        }
+
+        if (latencies.empty()) {
+            continue;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        requests += latencies.size();
+        failed += errors;
+
+        std::cout << std::left << std::setw(16) << RecordName(record) << std::right << std::setw(8) << latencies.size()
+            << std::setw(8) << errors << std::setprecision(2) << std::setw(10) << Percentile(latencies, 50.0)
+            << std::setw(10) << Percentile(latencies, 90.0) << std::setw(10) << Percentile(latencies, 99.0)
+            << std::setw(10) << latencies.back() << std::setw(12) << bytes / latencies.size() << std::endl;
+    }
+
+    std::cout << std::setprecision(1) << "Geometry updates: " << geometry_updates << " (" << geometry_errors
+        << " failed)" << std::endl;
+    std::cout << "Throughput: " << (wall_ms > 0.0 ? requests * 1000.0 / wall_ms : 0.0) << " requests/s over "
+        << wall_ms / 1000.0 << " s" << std::endl;
+    PrintCpuTime("Client CPU: ", client_cpu_ms, wall_ms);
+    if (options.server_pid > 0) {
+        PrintCpuTime("Server CPU: ", server_cpu_ms, wall_ms);
+    }
+
+    return failed == 0 && geometry_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+// trace_replay.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef TRACE_REPLAY_H_
+#define TRACE_REPLAY_H_
+
+#include <string>
+
+namespace glass_surf {
+
+	/**
+	 * @brief What the `replay` subcommand plays back, and against which server.
+	 */
+	struct TraceReplayOptions {
+		std::string trace_path;
+		std::string host = "127.0.0.1";
+		unsigned short port = 0;        // beauty server: /state/, /bg/, /contrast/, /geometry/
+		unsigned short stream_port = 0; // Streaming /bg/
+		size_t connections = 4;         // Concurrent request connections
+		double speed = 1.0;             // 2.0 replays twice as fast as recorded
+		int server_pid = 0;             // Reports the server's CPU time too, if set (Linux)
+	};
+
+	/**
+	 * @brief Replays a geometry trace against a running server and prints a latency report.
+	 *
+	 * Geometry records are sent to /geometry/ in order, so the server has to take
+	 * its window geometry from there (--pushed-geometry). Requests are queued at
+	 * their recorded time, scaled by the speed, and sent by `connections` workers
+	 * over keep-alive connections. A request's latency runs from its scheduled time
+	 * to the end of its response body, so time spent waiting for a free connection
+	 * behind slow responses is counted too.
+	 *
+	 * @return 0 if every request succeeded, 1 otherwise.
+	 */
+	int RunTraceReplay(const TraceReplayOptions& options);
+
+} // namespace glass_surf
+
+#endif // !TRACE_REPLAY_H_
@@ -0,0 +1,217 @@
+// tracer.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    // Threads beyond this many record nothing; buffers of exited threads are reused first
+    constexpr size_t kMaxTraceThreads = 256;
+
+    // Fields are relaxed atomics so TraceEventsJson can read a buffer while its thread writes
+    struct TraceEvent {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<uint64_t> start_ns{ 0 };
+        std::atomic<uint64_t> duration_ns{ 0 };
+        std::atomic<uint32_t> thread_id{ 0 };
+    };
+
+    // A ring of spans written by one thread at a time
+    struct ThreadBuffer {
+        std::unique_ptr<TraceEvent[]> events = std::make_unique<TraceEvent[]>(glass_surf::kTraceEventsPerThread);
+        std::atomic<uint64_t> head{ 0 }; // Spans written so far
+    };
+
+    const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers; // Never freed, so spans outlive their thread
+    std::vector<ThreadBuffer*> free_buffers;
+    std::vector<std::pair<uint32_t, const char*>> thread_names;
+    uint32_t next_thread_id = 1;
+
+    // The calling thread's id and buffer; the buffer goes back to the pool when the thread exits
+    struct ThreadState {
+        uint32_t thread_id = 0;
+        ThreadBuffer* buffer = nullptr;
+
+        ~ThreadState() {
+            if (buffer) {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                free_buffers.push_back(buffer);
+            }
+        }
+    };
+
+    thread_local ThreadState thread_state;
+
+    // Call with registry_mutex held
+    uint32_t CurrentThreadId() {
+        if (thread_state.thread_id == 0) {
+            thread_state.thread_id = next_thread_id++;
+        }
+        return thread_state.thread_id;
+    }
+
+    ThreadBuffer* AcquireBuffer() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        CurrentThreadId();
+
+        if (!free_buffers.empty()) {
+            thread_state.buffer = free_buffers.back();
+            free_buffers.pop_back();
+        }
+        else if (buffers.size() < kMaxTraceThreads) {
+            buffers.push_back(std::make_unique<ThreadBuffer>());
+            thread_state.buffer = buffers.back().get();
+        }
+
+        return thread_state.buffer;
+    }
+
+    void AppendEscaped(std::string& json, const char* text) {
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') {
+                json.push_back('\\');
+            }
+            json.push_back(*text);
+        }
+    }
+
+    void AppendMicroseconds(std::string& json, uint64_t nanoseconds) {
+        char number[32];
+        int length = std::snprintf(number, sizeof(number), "%llu.%03llu",
+            static_cast<unsigned long long>(nanoseconds / 1000), static_cast<unsigned long long>(nanoseconds % 1000));
+        json.append(number, static_cast<size_t>(length));
+    }
+
+} // namespace
+
+uint64_t glass_surf::detail::TraceNow() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - trace_epoch).count());
+}
+
+void glass_surf::detail::RecordSpan(const char* name, uint64_t start_ns, uint64_t end_ns) {
+    ThreadBuffer* buffer = thread_state.buffer ? thread_state.buffer : AcquireBuffer();
+    if (!buffer) {
+        return;
+    }
+
+    uint64_t index = buffer->head.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[index % kTraceEventsPerThread];
+
+    // Seqlock-style: a reader that sees any of the stores below also sees the
+    // head published before them, and so knows this slot may be torn
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start_ns.store(start_ns, std::memory_order_relaxed);
+    event.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+    event.thread_id.store(thread_state.thread_id, std::memory_order_relaxed);
+
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+void glass_surf::StartTracing() {
+    detail::tracing_enabled.store(true, std::memory_order_relaxed);
+}
+
+void glass_surf::StopTracing() {
+    detail::tracing_enabled.store(false, std::memory_order_relaxed);
+}
+
+void glass_surf::SetTraceThreadName(const char* name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    uint32_t thread_id = CurrentThreadId();
+
+    for (auto& thread_name : thread_names) {
+        if (thread_name.first == thread_id) {
+            thread_name.second = name;
+            return;
+        }
+    }
+    thread_names.emplace_back(thread_id, name);
+}
+
+std::string glass_surf::TraceEventsJson() {
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    for (const auto& thread_name : thread_names) {
+        json += first ? "" : ",";
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(thread_name.first)
+            + ",\"args\":{\"name\":\"";
+        AppendEscaped(json, thread_name.second);
+        json += "\"}}";
+        first = false;
+    }
+
+    struct Span {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        uint32_t thread_id;
+    };
+    std::vector<Span> spans;
+
+    for (const auto& buffer : buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = head > kTraceEventsPerThread ? head - kTraceEventsPerThread : 0;
+
+        spans.clear();
+        for (uint64_t index = begin; index < head; ++index) {
+            const TraceEvent& event = buffer->events[index % kTraceEventsPerThread];
+            spans.push_back(Span{ event.name.load(std::memory_order_relaxed), event.start_ns.load(std::memory_order_relaxed),
+                event.duration_ns.load(std::memory_order_relaxed), event.thread_id.load(std::memory_order_relaxed) });
+        }
+
+        // Slots the owner thread wrote meanwhile (up to and including the one it is
+        // writing now) may mix two spans; drop them
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t new_head = buffer->head.load(std::memory_order_relaxed);
+        uint64_t valid_begin = new_head + 1 > kTraceEventsPerThread ? new_head + 1 - kTraceEventsPerThread : 0;
+
+        for (uint64_t index = std::max(begin, valid_begin); index < head; ++index) {
+            const Span& span = spans[index - begin];
+
+            json += first ? "{\"name\":\"" : ",{\"name\":\"";
+            AppendEscaped(json, span.name);
+            json += "\",\"cat\":\"glass_surf\",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(span.thread_id) + ",\"ts\":";
+            AppendMicroseconds(json, span.start_ns);
+            json += ",\"dur\":";
+            AppendMicroseconds(json, span.duration_ns);
+            json += "}";
+            first = false;
+        }
+    }
+
+    json += "]}";
+    return json;
+}
+
+bool glass_surf::WriteTraceEvents(const std::string& path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::string json = TraceEventsJson();
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+
+    if (!file) {
+        std::cerr << "[ERROR]: Writing trace events to " << path << " failed!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,106 @@
+// tracer.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace glass_surf {
+
+	namespace detail {
+		inline std::atomic<bool> tracing_enabled{ false };
+
+		uint64_t TraceNow();
+		void RecordSpan(const char* name, uint64_t start_ns, uint64_t end_ns);
+	} // namespace detail
+
+	/**
+	 * @brief Spans recorded per thread before the oldest ones are overwritten.
+	 */
+	constexpr size_t kTraceEventsPerThread = 16 * 1024;
+
+	/**
+	 * @brief Starts recording spans. Spans already recorded are kept.
+	 */
+	void StartTracing();
+
+	/**
+	 * @brief Stops recording spans; they stay available to TraceEventsJson.
+	 */
+	void StopTracing();
+
+	inline bool TracingEnabled() {
+		return detail::tracing_enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Names the calling thread in the trace; `name` must be a string literal.
+	 */
+	void SetTraceThreadName(const char* name);
+
+	/**
+	 * @brief Returns the recorded spans of all threads in Chrome's trace-event
+	 * format, for chrome://tracing or Perfetto.
+	 *
+	 * May be called while other threads record; spans they overwrite meanwhile
+	 * are left out.
+	 */
+	std::string TraceEventsJson();
+
+	/**
+	 * @brief Writes TraceEventsJson to a file.
+	 *
+	 * @return False if the file could not be written.
+	 */
+	bool WriteTraceEvents(const std::string& path);
+
+	/**
+	 * @brief Records the time between its construction and destruction as a span.
+	 *
+	 * Each thread writes its spans into its own ring buffer without locks or
+	 * allocations (the buffer is allocated on the thread's first span). When
+	 * tracing is off, a scope costs one relaxed atomic load. `name` must be a
+	 * string literal.
+	 */
+	class TraceScope {
+	public:
+		explicit TraceScope(const char* name) : name_(TracingEnabled() ? name : nullptr) {
+			if (name_) {
+				start_ns_ = detail::TraceNow();
+			}
+		}
+
+		~TraceScope() {
+			if (name_) {
+				detail::RecordSpan(name_, start_ns_, detail::TraceNow());
+			}
+		}
+
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+
+	private:
+		const char* name_;
+		uint64_t start_ns_ = 0;
+	};
+
+} // namespace glass_surf
+
+#define GLASSSURF_TRACE_CONCAT_(a, b) a##b
+#define GLASSSURF_TRACE_CONCAT(a, b) GLASSSURF_TRACE_CONCAT_(a, b)
+
+/**
+ * @brief Traces the rest of the enclosing block as a span called `name`.
+ */
+#define GLASSSURF_TRACE_SCOPE(name) \
+	::glass_surf::TraceScope GLASSSURF_TRACE_CONCAT(glass_surf_trace_scope_, __LINE__)(name)
+
+#endif // !TRACER_H_
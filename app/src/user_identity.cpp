@@ -0,0 +1,175 @@
+// user_identity.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "user_identity.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <iphlpapi.h>
+#include <aclapi.h>
+#include <sddl.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <fstream>
+#include <sstream>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+
+    bool SidString(PSID sid, std::string& text) {
+        LPSTR sid_text = nullptr;
+        if (!ConvertSidToStringSidA(sid, &sid_text)) {
+            return false;
+        }
+
+        text = sid_text;
+        LocalFree(sid_text);
+        return true;
+    }
+
+    // The process whose TCP socket is bound to `client` and connected to `server`
+    bool ConnectionOwnerProcess(const boost::asio::ip::tcp::endpoint& client,
+        const boost::asio::ip::tcp::endpoint& server, DWORD& process_id) {
+        DWORD client_address;
+        auto client_bytes = client.address().to_v4().to_bytes();
+        std::memcpy(&client_address, client_bytes.data(), sizeof(client_address));
+
+        // Connections come and go between the two calls; the second one may need a larger table
+        std::vector<unsigned char> buffer;
+        DWORD size = 0;
+        DWORD result = ERROR_INSUFFICIENT_BUFFER;
+        for (int attempt = 0; attempt < 3 && result == ERROR_INSUFFICIENT_BUFFER; ++attempt) {
+            buffer.resize(size);
+            result = GetExtendedTcpTable(buffer.empty() ? nullptr : buffer.data(), &size, FALSE, AF_INET,
+                TCP_TABLE_OWNER_PID_CONNECTIONS, 0);
+        }
+        if (result != NO_ERROR) {
+            return false;
+        }
+
+        const auto* table = reinterpret_cast<const MIB_TCPTABLE_OWNER_PID*>(buffer.data());
+        for (DWORD i = 0; i < table->dwNumEntries; ++i) {
+            const MIB_TCPROW_OWNER_PID& row = table->table[i];
+            if (row.dwLocalAddr == client_address
+                && ntohs(static_cast<u_short>(row.dwLocalPort)) == client.port()
+                && ntohs(static_cast<u_short>(row.dwRemotePort)) == server.port()) {
+                process_id = row.dwOwningPid;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool ProcessUser(DWORD process_id, std::string& user) {
+        HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process_id);
+        if (!process) {
+            return false;
+        }
+
+        HANDLE token = nullptr;
+        bool found = false;
+        if (OpenProcessToken(process, TOKEN_QUERY, &token)) {
+            DWORD length = 0;
+            GetTokenInformation(token, TokenUser, nullptr, 0, &length);
+
+            std::vector<unsigned char> information(length);
+            if (length > 0 && GetTokenInformation(token, TokenUser, information.data(), length, &length)) {
+                found = SidString(reinterpret_cast<TOKEN_USER*>(information.data())->User.Sid, user);
+            }
+            CloseHandle(token);
+        }
+
+        CloseHandle(process);
+        return found;
+    }
+
+#elif defined(__linux__)
+
+    // An IPv4 endpoint as /proc/net/tcp prints it: the address as the
+    // native-endian value of its network-order bytes, then the port
+    std::string ProcNetAddress(const boost::asio::ip::tcp::endpoint& endpoint) {
+        uint32_t address;
+        auto bytes = endpoint.address().to_v4().to_bytes();
+        std::memcpy(&address, bytes.data(), sizeof(address));
+
+        char text[16];
+        std::snprintf(text, sizeof(text), "%08X:%04X", address, static_cast<unsigned>(endpoint.port()));
+        return text;
+    }
+
+#endif
+
+} // namespace
+
+bool glass_surf::LoopbackPeerUser(const boost::asio::ip::tcp::socket& socket, std::string& user) {
+    boost::system::error_code error;
+    boost::asio::ip::tcp::endpoint client = socket.remote_endpoint(error);
+    boost::asio::ip::tcp::endpoint server = socket.local_endpoint(error);
+    if (error || !client.address().is_v4() || !client.address().is_loopback()) {
+        return false;
+    }
+
+#ifdef _WIN32
+    DWORD process_id;
+    return ConnectionOwnerProcess(client, server, process_id) && ProcessUser(process_id, user);
+#elif defined(__linux__)
+    // The client's socket: local end `client`, remote end `server`
+    const std::string local_address = ProcNetAddress(client);
+    const std::string remote_address = ProcNetAddress(server);
+
+    std::ifstream table("/proc/net/tcp");
+    std::string line;
+    std::getline(table, line); // Column names
+
+    while (std::getline(table, line)) {
+        std::istringstream fields(line);
+        std::string slot, local, remote, state, queues, timer, retransmits, uid;
+        fields >> slot >> local >> remote >> state >> queues >> timer >> retransmits >> uid;
+
+        if (local == local_address && remote == remote_address && !uid.empty()) {
+            user = uid;
+            return true;
+        }
+    }
+
+    return false;
+#else
+    return false;
+#endif
+}
+
+bool glass_surf::FileOwner(const std::filesystem::path& path, std::string& user) {
+#ifdef _WIN32
+    PSID owner = nullptr;
+    PSECURITY_DESCRIPTOR descriptor = nullptr;
+    if (GetNamedSecurityInfoW(path.c_str(), SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION, &owner, nullptr, nullptr,
+        nullptr, &descriptor) != ERROR_SUCCESS) {
+        return false;
+    }
+
+    bool found = SidString(owner, user);
+    LocalFree(descriptor);
+    return found;
+#else
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0) {
+        return false;
+    }
+
+    user = std::to_string(status.st_uid);
+    return true;
+#endif
+}
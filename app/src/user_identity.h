@@ -0,0 +1,39 @@
+// user_identity.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef USER_IDENTITY_H_
+#define USER_IDENTITY_H_
+
+#include <filesystem>
+#include <string>
+
+#include <boost/asio/ip/tcp.hpp>
+
+namespace glass_surf {
+
+	/**
+	 * @brief Finds the user owning the client end of a loopback connection.
+	 *
+	 * The client socket is looked up in the system's TCP table: its owner's user
+	 * id from /proc/net/tcp on Linux, and on Windows its process's user SID (which
+	 * needs the rights to query other users' processes, e.g. an elevated daemon).
+	 * Users are named as FileOwner names them.
+	 *
+	 * @return False if the connection is not an IPv4 one from this machine or its owner cannot be found.
+	 */
+	bool LoopbackPeerUser(const boost::asio::ip::tcp::socket& socket, std::string& user);
+
+	/**
+	 * @brief Finds the user owning a file or directory: a user id on POSIX
+	 * systems, a SID string on Windows.
+	 *
+	 * @return False if the owner cannot be read, e.g. the file does not exist.
+	 */
+	bool FileOwner(const std::filesystem::path& path, std::string& user);
+
+} // namespace glass_surf
+
+#endif // !USER_IDENTITY_H_
@@ -0,0 +1,228 @@
+// wallpaper_watcher.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#include "wallpaper_watcher.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "thread_utilities.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    constexpr std::chrono::milliseconds kPollInterval(1000);
+    constexpr std::chrono::milliseconds kSettleDelay(500);
+
+#if !defined(__linux__)
+
+    // What identifies one version of the wallpaper on disk
+    struct WallpaperSignature {
+        std::string path;
+        std::filesystem::file_time_type modified;
+        std::uintmax_t size = 0;
+
+        bool operator==(const WallpaperSignature&) const = default;
+    };
+
+    WallpaperSignature ReadSignature(const std::string& path) {
+        WallpaperSignature signature;
+        std::error_code error;
+
+        signature.path = path;
+        signature.modified = std::filesystem::last_write_time(path, error);
+        if (!std::filesystem::is_directory(path, error)) {
+            signature.size = std::filesystem::file_size(path, error);
+        }
+
+        return signature;
+    }
+
+#endif
+
+} // namespace
+
+glass_surf::WallpaperWatcher::WallpaperWatcher(PathProvider path_provider, ChangeCallback on_change)
+    : path_provider_(std::move(path_provider)), on_change_(std::move(on_change)) {}
+
+glass_surf::WallpaperWatcher::~WallpaperWatcher() {
+    Stop();
+}
+
+void glass_surf::WallpaperWatcher::Start() {
+    Stop();
+
+#if defined(__linux__)
+    stop_event_ = eventfd(0, EFD_CLOEXEC);
+#endif
+
+    stop_requested_ = false;
+    thread_ = std::thread(&WallpaperWatcher::Run, this);
+}
+
+void glass_surf::WallpaperWatcher::Stop() {
+    stop_requested_ = true;
+
+#if defined(__linux__)
+    if (stop_event_ >= 0) {
+        uint64_t count = 1;
+        if (write(stop_event_, &count, sizeof(count)) < 0) {
+            std::cerr << "[ERROR]: Waking the wallpaper watcher failed." << std::endl;
+        }
+    }
+#endif
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+#if defined(__linux__)
+    if (stop_event_ >= 0) {
+        close(stop_event_);
+        stop_event_ = -1;
+    }
+#endif
+}
+
+#if defined(__linux__)
+
+void glass_surf::WallpaperWatcher::Run() {
+    glass_surf::LowerCurrentThreadPriority();
+
+    std::string wallpaper_path = path_provider_();
+    std::filesystem::path watched_path(wallpaper_path);
+
+    // Watch the parent directory of a file, so replacing it (rename over it) is seen too
+    std::error_code error;
+    bool watch_directory = std::filesystem::is_directory(watched_path, error);
+    std::string file_name = watched_path.filename().string();
+    if (!watch_directory) {
+        watched_path = watched_path.parent_path().empty() ? "." : watched_path.parent_path();
+    }
+
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 || inotify_add_watch(inotify_fd, watched_path.c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB) < 0) {
+        std::cerr << "[ERROR]: Watching " << watched_path << " for wallpaper changes failed." << std::endl;
+        if (inotify_fd >= 0) {
+            close(inotify_fd);
+        }
+        return;
+    }
+
+    std::vector<char> events(4096);
+    bool change_pending = false;
+    auto last_change = std::chrono::steady_clock::now();
+
+    while (!stop_requested_) {
+        // Sleeps until a change or Stop; only without the stop eventfd does it check back
+        pollfd poll_fds[] = { { inotify_fd, POLLIN, 0 }, { stop_event_, POLLIN, 0 } };
+        int timeout = -1;
+        if (change_pending) {
+            timeout = static_cast<int>(kSettleDelay.count());
+        }
+        else if (stop_event_ < 0) {
+            timeout = static_cast<int>(kPollInterval.count());
+        }
+
+        if (poll(poll_fds, stop_event_ >= 0 ? 2 : 1, timeout) > 0 && (poll_fds[0].revents & POLLIN)) {
+            ssize_t length;
+            while ((length = read(inotify_fd, events.data(), events.size())) > 0) {
+                for (ssize_t offset = 0; offset < length;) {
+                    auto* event = reinterpret_cast<const inotify_event*>(events.data() + offset);
+                    offset += sizeof(inotify_event) + event->len;
+
+                    if (watch_directory || (event->len > 0 && file_name == event->name)) {
+                        change_pending = true;
+                        last_change = std::chrono::steady_clock::now();
+                    }
+                }
+            }
+        }
+
+        if (change_pending && std::chrono::steady_clock::now() - last_change >= kSettleDelay) {
+            change_pending = false;
+            on_change_(wallpaper_path);
+        }
+    }
+
+    close(inotify_fd);
+}
+
+#else
+
+void glass_surf::WallpaperWatcher::Run() {
+    glass_surf::LowerCurrentThreadPriority();
+
+#ifdef _WIN32
+    // Wakes the loop as soon as the wallpaper registry value is written
+    HKEY desktop_key = nullptr;
+    HANDLE registry_event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Control Panel\\Desktop", 0, KEY_NOTIFY, &desktop_key) != ERROR_SUCCESS) {
+        desktop_key = nullptr;
+    }
+    bool registry_armed = false;
+#endif
+
+    WallpaperSignature signature = ReadSignature(path_provider_());
+
+    while (!stop_requested_) {
+#ifdef _WIN32
+        if (desktop_key != nullptr && registry_event != nullptr && !registry_armed) {
+            registry_armed = RegNotifyChangeKeyValue(desktop_key, FALSE, REG_NOTIFY_CHANGE_LAST_SET,
+                registry_event, TRUE) == ERROR_SUCCESS;
+        }
+
+        if (registry_event != nullptr
+            && WaitForSingleObject(registry_event, static_cast<DWORD>(kPollInterval.count())) == WAIT_OBJECT_0) {
+            registry_armed = false;
+        }
+#else
+        std::this_thread::sleep_for(kPollInterval);
+#endif
+
+        if (stop_requested_) {
+            break;
+        }
+
+        WallpaperSignature current_signature = ReadSignature(path_provider_());
+        if (current_signature == signature) {
+            continue;
+        }
+
+        // Let the writer finish before reading the new wallpaper
+        do {
+            signature = current_signature;
+            std::this_thread::sleep_for(kSettleDelay);
+            current_signature = ReadSignature(path_provider_());
+        } while (!stop_requested_ && !(current_signature == signature));
+
+        if (!stop_requested_) {
+            on_change_(signature.path);
+        }
+    }
+
+#ifdef _WIN32
+    if (desktop_key != nullptr) {
+        RegCloseKey(desktop_key);
+    }
+    if (registry_event != nullptr) {
+        CloseHandle(registry_event);
+    }
+#endif
+}
+
+#endif
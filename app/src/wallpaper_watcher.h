@@ -0,0 +1,58 @@
+// wallpaper_watcher.h
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+#ifndef WALLPAPER_WATCHER_H_
+#define WALLPAPER_WATCHER_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace glass_surf {
+
+	/**
+	 * @brief Watches the wallpaper source and reports changes on a background thread.
+	 *
+	 * On Windows it waits for changes of the "Control Panel\Desktop" registry key and
+	 * polls the modification time of the wallpaper file. Elsewhere it uses inotify on
+	 * the wallpaper path (or the directory containing it).
+	 *
+	 * Bursts of changes (an editor saving in several steps, a slideshow directory being
+	 * filled) are reported once, after the source has been quiet for a moment.
+	 */
+	class WallpaperWatcher {
+	public:
+		using PathProvider = std::function<std::string()>;
+		using ChangeCallback = std::function<void(const std::string& wallpaper_path)>;
+
+		/**
+		 * @param path_provider Returns the current wallpaper path; called again after each change.
+		 * @param on_change Called on the watcher thread, which runs at low priority.
+		 */
+		WallpaperWatcher(PathProvider path_provider, ChangeCallback on_change);
+		~WallpaperWatcher();
+
+		WallpaperWatcher(const WallpaperWatcher&) = delete;
+		WallpaperWatcher& operator=(const WallpaperWatcher&) = delete;
+
+		void Start();
+		void Stop();
+
+	private:
+		void Run();
+
+		PathProvider path_provider_;
+		ChangeCallback on_change_;
+
+		std::thread thread_;
+		std::atomic<bool> stop_requested_{ false };
+		int stop_event_ = -1; // Linux: eventfd Stop signals, so Run does not wake up to check
+	};
+
+} // namespace glass_surf
+
+#endif // !WALLPAPER_WATCHER_H_
@@ -0,0 +1,250 @@
+// tests/frame_ring_tests.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+// Checks of the shared memory frame ring from the reader's side, run by CTest:
+//
+//   GlassSurfFrameRingTests
+//
+// Only needs the frame ring library, like the native consumers that link it.
+
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "frame_ring.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    using glass_surf::ipc::FrameKind;
+    using glass_surf::ipc::FrameRingReader;
+    using glass_surf::ipc::FrameRingWriter;
+    using glass_surf::ipc::FrameView;
+    using glass_surf::ipc::PixelFormat;
+
+    constexpr int kWidth = 8;
+    constexpr int kHeight = 4;
+    constexpr size_t kStride = kWidth * 3;
+    constexpr uint32_t kSlotCount = 3;
+
+    struct Results {
+        int passed = 0;
+        int failed = 0;
+
+        void Check(bool condition, const std::string& what) {
+            if (condition) {
+                ++passed;
+            }
+            else {
+                ++failed;
+                std::cerr << "[FAIL]: " << what << std::endl;
+            }
+        }
+
+        int ExitCode() const {
+            std::cout << passed << " passed, " << failed << " failed" << std::endl;
+
+            return failed > 0 ? 1 : 0;
+        }
+    };
+
+    // Per process, so concurrent test runs do not share rings
+    std::string RingName(const std::string& suffix) {
+#ifdef _WIN32
+        return "GlassSurfTest_" + std::to_string(GetCurrentProcessId()) + "_" + suffix;
+#else
+        return "/glass_surf_test_" + std::to_string(getpid()) + "_" + suffix;
+#endif
+    }
+
+    std::vector<uint8_t> Frame(uint8_t value) {
+        return std::vector<uint8_t>(kStride * kHeight, value);
+    }
+
+    bool HasPixels(const uint8_t* pixels, uint8_t value) {
+        for (size_t i = 0; i < kStride * kHeight; ++i) {
+            if (pixels[i] != value) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void CheckEmptyRing(Results& results) {
+        FrameRingWriter writer;
+        results.Check(writer.Create(RingName("empty"), kStride * kHeight, kSlotCount), "empty: create");
+
+        FrameRingReader reader;
+        results.Check(reader.Open(RingName("empty")), "empty: open");
+
+        FrameView frame;
+        results.Check(reader.LatestFrameId() == 0, "empty: no latest frame");
+        results.Check(!reader.Acquire(frame), "empty: nothing to acquire");
+    }
+
+    void CheckAcquire(Results& results) {
+        FrameRingWriter writer;
+        writer.Create(RingName("acquire"), kStride * kHeight, kSlotCount);
+
+        FrameRingReader reader;
+        results.Check(reader.Open(RingName("acquire")), "acquire: open");
+
+        std::vector<uint8_t> pixels = Frame(42);
+        uint64_t frame_id = writer.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGR8, FrameKind::CROP, 5, 6);
+        results.Check(frame_id != 0, "acquire: publish");
+
+        FrameView frame;
+        results.Check(reader.Acquire(frame), "acquire: latest frame");
+        results.Check(frame.frame_id == frame_id && reader.LatestFrameId() == frame_id, "acquire: frame id");
+        results.Check(frame.width == kWidth && frame.height == kHeight && frame.stride == kStride,
+            "acquire: frame size");
+        results.Check(frame.kind == FrameKind::CROP && frame.format == PixelFormat::BGR8 && frame.x == 5 && frame.y == 6,
+            "acquire: frame kind, format and position");
+        results.Check(HasPixels(frame.pixels, 42), "acquire: pixels");
+        results.Check(reader.Validate(frame), "acquire: valid while the slot is untouched");
+
+        // Every other slot is rewritten first, so the frame stays valid until the ring wraps
+        for (uint32_t i = 1; i < kSlotCount; ++i) {
+            pixels = Frame(static_cast<uint8_t>(i));
+            writer.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGR8, FrameKind::SURFACE);
+        }
+        results.Check(reader.Validate(frame), "acquire: valid until its slot is reused");
+
+        pixels = Frame(7);
+        writer.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGR8, FrameKind::SURFACE);
+        results.Check(!reader.Validate(frame), "acquire: invalid after its slot is overwritten");
+    }
+
+    void CheckCopyLatest(Results& results) {
+        FrameRingWriter writer;
+        writer.Create(RingName("copy"), kStride * kHeight, kSlotCount);
+
+        FrameRingReader reader;
+        reader.Open(RingName("copy"));
+
+        std::vector<uint8_t> pixels = Frame(1);
+        writer.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGR8, FrameKind::SURFACE);
+        pixels = Frame(2);
+        uint64_t frame_id = writer.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGR8, FrameKind::SURFACE);
+
+        FrameView frame;
+        std::vector<uint8_t> copy;
+        results.Check(reader.CopyLatest(frame, copy), "copy: latest frame");
+        results.Check(frame.frame_id == frame_id && copy.size() == kStride * kHeight, "copy: frame id and size");
+        results.Check(frame.pixels == copy.data() && HasPixels(copy.data(), 2), "copy: pixels point at the copy");
+
+        // The copy outlives the slot
+        for (uint32_t i = 0; i < kSlotCount; ++i) {
+            pixels = Frame(9);
+            writer.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGR8, FrameKind::SURFACE);
+        }
+        results.Check(HasPixels(copy.data(), 2), "copy: unaffected by later frames");
+    }
+
+    void CheckOversize(Results& results) {
+        FrameRingWriter writer;
+        writer.Create(RingName("oversize"), kStride * kHeight, kSlotCount);
+
+        FrameRingReader reader;
+        reader.Open(RingName("oversize"));
+
+        std::vector<uint8_t> pixels = Frame(3);
+        uint64_t frame_id = writer.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGR8, FrameKind::SURFACE);
+
+        std::vector<uint8_t> large((kStride + 3) * (kHeight + 1), 4);
+        results.Check(writer.Publish(large.data(), kWidth + 1, kHeight + 1, kStride + 3, PixelFormat::BGR8,
+            FrameKind::SURFACE) == 0, "oversize: a frame larger than a slot is rejected");
+        results.Check(writer.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGRA8,
+            FrameKind::SURFACE) == 0, "oversize: 4 bytes per pixel do not fit a BGR8 slot");
+
+        FrameView frame;
+        results.Check(reader.Acquire(frame) && frame.frame_id == frame_id && HasPixels(frame.pixels, 3),
+            "oversize: the previous frame stays the latest");
+    }
+
+    void CheckSecondWriter(Results& results) {
+        FrameRingWriter first;
+        first.Create(RingName("second"), kStride * kHeight, kSlotCount);
+
+        FrameRingReader reader;
+        reader.Open(RingName("second"));
+
+        FrameRingWriter second;
+        results.Check(!second.Create(RingName("second"), kStride * kHeight, kSlotCount),
+            "second writer: a ring in use is not replaced");
+
+        std::vector<uint8_t> pixels = Frame(5);
+        uint64_t frame_id = first.Publish(pixels.data(), kWidth, kHeight, kStride, PixelFormat::BGR8, FrameKind::SURFACE);
+
+        FrameView frame;
+        results.Check(reader.Acquire(frame) && frame.frame_id == frame_id,
+            "second writer: readers keep seeing the first writer");
+    }
+
+    void CheckForeignMemory(Results& results) {
+        glass_surf::ipc::SharedMemory memory;
+        results.Check(memory.Create(RingName("foreign"), 4096), "foreign: create");
+
+        FrameRingReader reader;
+        results.Check(!reader.Open(RingName("foreign")), "foreign: memory without the magic is refused");
+
+        FrameRingWriter writer;
+        results.Check(!writer.Create(RingName("foreign"), kStride * kHeight, kSlotCount),
+            "foreign: memory that is not a ring is not replaced");
+    }
+
+#ifndef _WIN32
+    // A ring whose writer exited without removing it, as after a crash
+    void CheckAbandonedRing(Results& results) {
+        pid_t child = fork();
+        if (child == 0) {
+            _exit(0);
+        }
+        waitpid(child, nullptr, 0);
+
+        glass_surf::ipc::SharedMemory memory;
+        memory.Create(RingName("abandoned"), 4096);
+        auto* header = new (memory.data()) glass_surf::ipc::FrameRingHeader{};
+        header->magic = glass_surf::ipc::kFrameRingMagic;
+        header->version = glass_surf::ipc::kFrameRingVersion;
+        header->owner_pid = static_cast<uint32_t>(child);
+
+        FrameRingWriter writer;
+        results.Check(writer.Create(RingName("abandoned"), kStride * kHeight, kSlotCount),
+            "abandoned: a ring whose writer is gone is replaced");
+
+        FrameRingWriter live;
+        results.Check(!live.Create(RingName("abandoned"), kStride * kHeight, kSlotCount),
+            "abandoned: the replacement is in use");
+    }
+#endif
+
+} // namespace
+
+int main() {
+    Results results;
+
+    CheckEmptyRing(results);
+    CheckAcquire(results);
+    CheckCopyLatest(results);
+    CheckOversize(results);
+    CheckSecondWriter(results);
+    CheckForeignMemory(results);
+#ifndef _WIN32
+    CheckAbandonedRing(results);
+#endif
+
+    return results.ExitCode();
+}
@@ -0,0 +1,843 @@
+// tests/pipeline_tests.cpp
+// -----------------------------------------------------
+// Copyright 2024 The GlassSurf Authors
+// Use of this source code is governed by a MIT-style license that can be
+// found in the LICENSE file.
+
+// Headless checks of the image pipeline, run by CTest one suite at a time:
+//
+//   GlassSurfTests stages      <data dir>  properties of each stage that hold without reference images
+//   GlassSurfTests golden      <data dir>  each stage and the /bg/ crops against <data dir>/golden
+//   GlassSurfTests time        <data dir>  per-stage time budgets at reference resolutions
+//   GlassSurfTests allocations <data dir>  per-stage and per-request allocation budgets
+//   GlassSurfTests update      <data dir>  rewrites the golden images after an intended change
+//
+// The inputs are synthetic wallpapers plus the still images in <data dir>/wallpapers, if any.
+// The golden images are recorded with `update` from an optimized build of this target; a
+// missing one is a failure. CTest runs the golden, time and allocations suites only with
+// GLASSSURF_REFERENCE_TESTS on, once the images and budgets were recorded (see CMakeLists.txt).
+// A suite that cannot run in this build (unoptimized, no allocation counting) exits with
+// kSkipped, which CTest reports as skipped rather than passed.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "allocation_counter.h"
+#include "background_cache.h"
+#include "frame_source.h"
+#include "geometry_source.h"
+#include "image_utilities.h"
+#include "linear_light.h"
+#include "noise_layer.h"
+#include "pipeline.h"
+#include "png_encoder.h"
+#include "profile_surfaces.h"
+#include "surface.h"
+#include "theme.h"
+
+namespace {
+
+    // SKIP_RETURN_CODE of the CTest tests
+    constexpr int kSkipped = 77;
+
+    // Golden images are small, so they stay cheap to keep in the repository
+    const cv::Size kGoldenSize(640, 360);
+    const cv::Size kSourceSize(1000, 700); // A different aspect ratio, so the resize stretches
+
+    constexpr double kBlurRadius = 25.0;
+    const glass_surf::RGB_Tint kTint = { 200, 180, 255 };
+
+    // Per stage: largest difference of any channel, and mean difference, in 8-bit levels.
+    // Loose enough for other OpenCV versions and SIMD paths, tight enough for a wrong formula.
+    constexpr double kGoldenMaxDifference = 3.0;
+    constexpr double kGoldenMeanDifference = 0.5;
+
+    // Each suite counts its checks; a failure is reported and the suite goes on
+    struct Results {
+        int passed = 0;
+        int failed = 0;
+
+        void Check(bool condition, const std::string& what) {
+            if (condition) {
+                ++passed;
+            }
+            else {
+                ++failed;
+                std::cerr << "[FAIL]: " << what << std::endl;
+            }
+        }
+
+        int ExitCode() const {
+            std::cout << passed << " passed, " << failed << " failed" << std::endl;
+
+            return failed > 0 ? 1 : 0;
+        }
+    };
+
+    struct Wallpaper {
+        std::string name;
+        cv::Mat image;
+    };
+
+    // Smooth in both directions, every channel different
+    cv::Mat GradientWallpaper(const cv::Size& size) {
+        cv::Mat wallpaper(size, CV_8UC3);
+
+        for (int i = 0; i < size.height; ++i) {
+            for (int j = 0; j < size.width; ++j) {
+                wallpaper.at<cv::Vec3b>(i, j) = cv::Vec3b(
+                    static_cast<uchar>(j * 255 / (size.width - 1)),
+                    static_cast<uchar>(i * 255 / (size.height - 1)),
+                    static_cast<uchar>((i + j) * 255 / (size.width + size.height - 2)));
+            }
+        }
+
+        return wallpaper;
+    }
+
+    // Hard edges, the worst case for the resize and the chroma subsampling
+    cv::Mat CheckerWallpaper(const cv::Size& size) {
+        const cv::Vec3b colors[] = { cv::Vec3b(30, 90, 220), cv::Vec3b(240, 230, 20) };
+        cv::Mat wallpaper(size, CV_8UC3);
+
+        for (int i = 0; i < size.height; ++i) {
+            for (int j = 0; j < size.width; ++j) {
+                wallpaper.at<cv::Vec3b>(i, j) = colors[(i / 37 + j / 37) % 2];
+            }
+        }
+
+        return wallpaper;
+    }
+
+    // Uniform noise from OpenCV's fixed-seed generator, the same on every platform
+    cv::Mat NoiseWallpaper(const cv::Size& size) {
+        cv::Mat wallpaper(size, CV_8UC3);
+        cv::RNG rng(0x676f6c64);
+        rng.fill(wallpaper, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+
+        return wallpaper;
+    }
+
+    std::vector<Wallpaper> TestWallpapers(const std::filesystem::path& data_path) {
+        std::vector<Wallpaper> wallpapers = {
+            { "gradient", GradientWallpaper(kSourceSize) },
+            { "checker", CheckerWallpaper(kSourceSize) },
+            { "noise", NoiseWallpaper(kSourceSize) },
+        };
+
+        std::error_code error;
+        const std::filesystem::path samples_path = data_path / "wallpapers";
+        if (std::filesystem::is_directory(samples_path, error)) {
+            for (const std::string& image_path : glass_surf::ListStillImages(samples_path.string())) {
+                cv::Mat image = glass_surf::ReadImage(image_path);
+                if (!image.empty()) {
+                    wallpapers.push_back({ std::filesystem::path(image_path).stem().string(), image });
+                }
+            }
+        }
+
+        return wallpapers;
+    }
+
+    glass_surf::PipelineOptions TestPipelineOptions(const cv::Size& size, glass_surf::SurfaceStorage storage) {
+        glass_surf::PipelineOptions options;
+        options.resolution = size;
+        options.tint = true;
+        options.tint_color = kTint;
+        options.blur_radius = kBlurRadius;
+        options.theme = glass_surf::Themes::ACRYLIC;
+        options.noise_seed = 0x6e6f6973;
+        options.storage = storage;
+
+        return options;
+    }
+
+    // A surface as SurfaceRenderer stores it
+    std::shared_ptr<glass_surf::Surface> RenderSurface(const cv::Mat& wallpaper, const cv::Size& size,
+        glass_surf::SurfaceStorage storage) {
+        glass_surf::PipelineOptions options = TestPipelineOptions(size, storage);
+        glass_surf::PipelineBuffers buffers;
+
+        auto surface = std::make_shared<glass_surf::Surface>();
+        surface->storage = storage;
+        surface->size = size;
+
+        if (storage == glass_surf::SurfaceStorage::YCRCB420) {
+            glass_surf::RunPipeline(wallpaper, options, buffers, buffers.surface);
+            surface->StoreYCrCb420(buffers.surface, buffers.ycrcb);
+        }
+        else {
+            glass_surf::RunPipeline(wallpaper, glass_surf::StorageRenderOptions(options), buffers, surface->image);
+        }
+
+        return surface;
+    }
+
+    // Largest and mean absolute difference over every channel
+    void Difference(const cv::Mat& a, const cv::Mat& b, double& max_difference, double& mean_difference) {
+        cv::Mat difference;
+        cv::absdiff(a, b, difference);
+
+        cv::minMaxLoc(difference.reshape(1), nullptr, &max_difference);
+
+        cv::Scalar channel_means = cv::mean(difference);
+        mean_difference = 0.0;
+        for (int c = 0; c < difference.channels(); ++c) {
+            mean_difference += channel_means[c] / difference.channels();
+        }
+    }
+
+    bool IsUniform(const cv::Mat& image, double tolerance) {
+        cv::Scalar mean, deviation;
+        cv::meanStdDev(image, mean, deviation);
+
+        for (int c = 0; c < image.channels(); ++c) {
+            if (deviation[c] > tolerance) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // stages
+
+    void CheckResize(Results& results) {
+        cv::Mat uniform(kSourceSize, CV_8UC3, cv::Scalar(12, 34, 56));
+        cv::Mat resized = glass_surf::CompressImage(uniform, kGoldenSize.width, kGoldenSize.height);
+
+        results.Check(resized.size() == kGoldenSize, "resize: output size");
+        results.Check(cv::norm(resized, cv::Mat(kGoldenSize, CV_8UC3, cv::Scalar(12, 34, 56)), cv::NORM_INF) == 0,
+            "resize: a uniform image stays the same color");
+    }
+
+    void CheckTint(Results& results) {
+        // Multiply blend: each channel scaled by tint / 255
+        const glass_surf::RGB_Tint tint = { 128, 64, 255 };
+        cv::Mat uniform(kGoldenSize, CV_8UC3, cv::Scalar(50, 100, 200)); // BGR
+
+        cv::Mat tinted;
+        glass_surf::ApplyTintBlend(uniform, tint, tinted);
+
+        cv::Mat expected(kGoldenSize, CV_8UC3, cv::Scalar(50 * 255 / 255, 100 * 64 / 255, 200 * 128 / 255));
+        results.Check(cv::norm(tinted, expected, cv::NORM_INF) <= 1, "tint: multiply blend of a uniform image");
+    }
+
+    void CheckBlur(Results& results) {
+        cv::Mat uniform(kGoldenSize, CV_8UC3, cv::Scalar(70, 140, 210));
+        cv::Mat blurred;
+        glass_surf::GausianBlur(uniform, kBlurRadius, blurred);
+        results.Check(cv::norm(blurred, uniform, cv::NORM_INF) <= 1, "blur: a uniform image stays uniform");
+
+        cv::Mat noise = NoiseWallpaper(kGoldenSize);
+        glass_surf::GausianBlur(noise, kBlurRadius, blurred);
+
+        cv::Scalar noise_mean, noise_deviation, blurred_mean, blurred_deviation;
+        cv::meanStdDev(noise, noise_mean, noise_deviation);
+        cv::meanStdDev(blurred, blurred_mean, blurred_deviation);
+
+        for (int c = 0; c < 3; ++c) {
+            results.Check(std::abs(blurred_mean[c] - noise_mean[c]) <= 2.0, "blur: keeps the mean of channel " + std::to_string(c));
+            results.Check(blurred_deviation[c] < noise_deviation[c] / 10.0, "blur: smooths noise in channel " + std::to_string(c));
+        }
+    }
+
+    void CheckLinearLight(Results& results) {
+        cv::Mat gradient = GradientWallpaper(kGoldenSize);
+        cv::Mat round_trip = glass_surf::FromLinearLight(glass_surf::ToLinearLight(gradient));
+
+        results.Check(cv::norm(round_trip, gradient, cv::NORM_INF) <= 1, "linear light: sRGB -> linear -> sRGB round trip");
+
+        // A white tint changes nothing, in any space
+        cv::Mat tinted = glass_surf::FromLinearLight(
+            glass_surf::ApplyTintBlendLinear(glass_surf::ToLinearLight(gradient), glass_surf::RGB_Tint{ 255, 255, 255 }));
+        results.Check(cv::norm(tinted, gradient, cv::NORM_INF) <= 1, "linear light: white tint is the identity");
+    }
+
+    void CheckThemes(Results& results) {
+        const std::pair<glass_surf::Themes, std::string> themes[] = {
+            { glass_surf::Themes::ACRYLIC, "acrylic" },
+            { glass_surf::Themes::DARK, "dark" },
+            { glass_surf::Themes::LIGHT, "light" },
+        };
+
+        cv::Mat black(kGoldenSize, CV_8UC3, cv::Scalar::all(0));
+        cv::Mat white(kGoldenSize, CV_8UC3, cv::Scalar::all(255));
+
+        for (const auto& [theme, name] : themes) {
+            cv::Mat themed_black, themed_white;
+            glass_surf::ApplyTheme(black, theme, themed_black);
+            glass_surf::ApplyTheme(white, theme, themed_white);
+
+            results.Check(IsUniform(themed_black, 0.0) && IsUniform(themed_white, 0.0),
+                "theme " + name + ": a uniform image stays uniform");
+            results.Check(cv::mean(themed_black)[1] <= cv::mean(themed_white)[1],
+                "theme " + name + ": keeps black darker than white");
+        }
+
+        cv::Mat themed;
+        glass_surf::ApplyTheme(black, glass_surf::Themes::LIGHT, themed);
+        results.Check(cv::mean(themed)[1] > 0.0, "theme light: lifts black");
+
+        glass_surf::ApplyTheme(white, glass_surf::Themes::DARK, themed);
+        results.Check(cv::mean(themed)[1] < 255.0, "theme dark: darkens white");
+
+        cv::Mat acrylic_black, acrylic_white;
+        glass_surf::ApplyTheme(black, glass_surf::Themes::ACRYLIC, acrylic_black);
+        glass_surf::ApplyTheme(white, glass_surf::Themes::ACRYLIC, acrylic_white);
+        results.Check(cv::mean(acrylic_black)[1] > 0.0 && cv::mean(acrylic_white)[1] < 255.0,
+            "theme acrylic: pulls both ends towards the middle");
+
+        // In place, as the pipeline runs it
+        cv::Mat in_place = GradientWallpaper(kGoldenSize);
+        cv::Mat copied;
+        glass_surf::ApplyTheme(in_place, glass_surf::Themes::DARK, copied);
+        glass_surf::ApplyTheme(in_place, glass_surf::Themes::DARK, in_place);
+        results.Check(cv::norm(in_place, copied, cv::NORM_INF) == 0, "theme: in place equals out of place");
+    }
+
+    void CheckNoise(Results& results) {
+        const int amplitude = glass_surf::GetThemePreset(glass_surf::Themes::ACRYLIC).noise_amplitude;
+        cv::Mat gray(kGoldenSize, CV_8UC3, cv::Scalar::all(128));
+
+        glass_surf::NoiseLayer noise;
+        noise.Prepare(1, amplitude, gray.cols);
+
+        cv::Mat grained = gray.clone();
+        noise.Composite(grained);
+
+        double max_difference, mean_difference;
+        Difference(grained, gray, max_difference, mean_difference);
+        results.Check(max_difference <= amplitude, "noise: stays within the amplitude");
+        results.Check(max_difference > 0, "noise: adds grain");
+        results.Check(std::abs(cv::mean(grained)[0] - 128.0) <= 0.5, "noise: keeps the mean");
+
+        // Monochrome: the same offset on every channel of a pixel
+        std::vector<cv::Mat> channels;
+        cv::split(grained, channels);
+        results.Check(cv::norm(channels[0], channels[1], cv::NORM_INF) == 0
+            && cv::norm(channels[0], channels[2], cv::NORM_INF) == 0, "noise: monochrome");
+
+        // Same seed, same grain
+        glass_surf::NoiseLayer again;
+        again.Prepare(1, amplitude, gray.cols);
+        cv::Mat grained_again = gray.clone();
+        again.Composite(grained_again);
+        results.Check(cv::norm(grained, grained_again, cv::NORM_INF) == 0, "noise: deterministic for a seed");
+    }
+
+    void CheckCrops(Results& results) {
+        cv::Mat gradient = GradientWallpaper(kGoldenSize);
+
+        cv::Mat crop = glass_surf::CropImage(gradient, 100, 50, 200, 120);
+        results.Check(crop.size() == cv::Size(200, 120)
+            && cv::norm(crop, gradient(cv::Rect(100, 50, 200, 120)), cv::NORM_INF) == 0, "crop: copies the rectangle");
+
+        crop = glass_surf::CropImage(gradient, -40, kGoldenSize.height - 100, 200, 300);
+        results.Check(crop.size() == cv::Size(160, 100), "crop: clipped to the image");
+
+        crop = glass_surf::CropImage(gradient, kGoldenSize.width + 10, 0, 100, 100);
+        results.Check(crop.empty(), "crop: empty outside the image");
+
+        // Compact surfaces convert their crops; on a blurred surface they stay close to FULL
+        cv::Mat wallpaper = CheckerWallpaper(kSourceSize);
+        std::shared_ptr<glass_surf::Surface> full = RenderSurface(wallpaper, kGoldenSize, glass_surf::SurfaceStorage::FULL);
+        const cv::Rect window(120, 60, 320, 200);
+
+        glass_surf::SurfaceCropBuffers crop_buffers;
+        cv::Mat full_crop = full->Crop(window, crop_buffers).clone();
+        results.Check(cv::norm(full_crop, full->image(window), cv::NORM_INF) == 0, "surface FULL: crop is the image");
+
+        const std::pair<glass_surf::SurfaceStorage, std::string> storages[] = {
+            { glass_surf::SurfaceStorage::YCRCB420, "YCRCB420" },
+            { glass_surf::SurfaceStorage::HALF, "HALF" },
+        };
+
+        for (const auto& [storage, name] : storages) {
+            std::shared_ptr<glass_surf::Surface> surface = RenderSurface(wallpaper, kGoldenSize, storage);
+            cv::Mat compact_crop = surface->Crop(window, crop_buffers);
+
+            double max_difference, mean_difference;
+            Difference(compact_crop, full_crop, max_difference, mean_difference);
+            results.Check(compact_crop.size() == full_crop.size(), "surface " + name + ": crop size");
+            results.Check(max_difference <= 12.0 && mean_difference <= 2.0, "surface " + name + ": crop close to FULL");
+        }
+    }
+
+    void CheckPng(Results& results) {
+        cv::Mat surface = glass_surf::GausianBlur(NoiseWallpaper(kGoldenSize), 4.0);
+        cv::Mat view = surface(cv::Rect(33, 17, 401, 211)); // Strided, odd width
+
+        for (int stripes : { 1, 4 }) {
+            std::string png;
+            bool encoded = glass_surf::EncodePngStriped(view, [&png](const uint8_t* data, size_t size) {
+                png.append(reinterpret_cast<const char*>(data), size);
+            }, 1, stripes);
+
+            cv::Mat decoded = cv::imdecode(std::vector<uchar>(png.begin(), png.end()), cv::IMREAD_COLOR);
+            results.Check(encoded && decoded.size() == view.size() && cv::norm(decoded, view, cv::NORM_INF) == 0,
+                "png: lossless round trip with " + std::to_string(stripes) + " stripes");
+        }
+    }
+
+    void CheckProfiles(Results& results) {
+        glass_surf::settings::Settings settings;
+        glass_surf::settings::Profile dark = glass_surf::settings::BaseProfile(settings);
+        dark.name = "dark";
+        dark.theme = glass_surf::Themes::DARK;
+        settings.profiles.push_back(dark);
+
+        glass_surf::SurfaceSwapChain swap_chain(kGoldenSize, glass_surf::SurfaceStorage::FULL);
+        auto publish = [&swap_chain](const cv::Mat& wallpaper) {
+            std::shared_ptr<glass_surf::Surface> surface = RenderSurface(wallpaper, kGoldenSize, glass_surf::SurfaceStorage::FULL);
+            surface->base = std::make_shared<const cv::Mat>(
+                glass_surf::CompressImage(wallpaper, kGoldenSize.width, kGoldenSize.height));
+            swap_chain.Publish(surface);
+        };
+        publish(CheckerWallpaper(kSourceSize));
+
+        glass_surf::ProfileSurfaces profiles(swap_chain, settings, kGoldenSize, 64 << 20);
+        std::shared_ptr<glass_surf::BackgroundCache> cache = profiles.Cache("dark");
+        results.Check(cache != nullptr && profiles.Cache("missing") == nullptr, "profiles: found by name");
+
+        glass_surf::WindowGeometry window;
+        window.width = 320;
+        window.height = 200;
+
+        results.Check(cache->IsStale(window) && profiles.ByteSize() == 0, "profiles: /state/ does not render");
+
+        std::string body;
+        results.Check(cache->Get(window, body) && profiles.ByteSize() > 0 && !cache->IsStale(window),
+            "profiles: /bg/ renders the profile");
+
+        const size_t rendered_bytes = profiles.ByteSize();
+        publish(GradientWallpaper(kSourceSize));
+        results.Check(cache->IsStale(window) && profiles.ByteSize() == rendered_bytes,
+            "profiles: a new frame is stale without rendering");
+    }
+
+    int RunStages() {
+        Results results;
+
+        CheckResize(results);
+        CheckTint(results);
+        CheckBlur(results);
+        CheckLinearLight(results);
+        CheckThemes(results);
+        CheckNoise(results);
+        CheckCrops(results);
+        CheckPng(results);
+        CheckProfiles(results);
+
+        return results.ExitCode();
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // golden
+
+    struct GoldenImage {
+        std::string name;
+        cv::Mat image;
+    };
+
+    // Every stage of the pipeline at kGoldenSize, then the crops /bg/ serves from each storage
+    std::vector<GoldenImage> RenderGoldenImages(const Wallpaper& wallpaper) {
+        std::vector<GoldenImage> images;
+        auto add = [&images, &wallpaper](const std::string& stage, const cv::Mat& image) {
+            images.push_back({ wallpaper.name + "." + stage, image.clone() });
+        };
+
+        cv::Mat resized = glass_surf::CompressImage(wallpaper.image, kGoldenSize.width, kGoldenSize.height);
+        add("resize", resized);
+
+        cv::Mat tinted;
+        glass_surf::ApplyTintBlend(resized, kTint, tinted);
+        add("tint", tinted);
+
+        cv::Mat blurred;
+        glass_surf::GausianBlur(tinted, kBlurRadius, blurred);
+        add("blur", blurred);
+
+        cv::Mat linear_blurred = glass_surf::FromLinearLight(glass_surf::GausianBlur(
+            glass_surf::ApplyTintBlendLinear(glass_surf::ToLinearLight(resized), kTint), kBlurRadius));
+        add("linear_light", linear_blurred);
+
+        const std::pair<glass_surf::Themes, std::string> themes[] = {
+            { glass_surf::Themes::ACRYLIC, "theme_acrylic" },
+            { glass_surf::Themes::DARK, "theme_dark" },
+            { glass_surf::Themes::LIGHT, "theme_light" },
+        };
+        for (const auto& [theme, name] : themes) {
+            cv::Mat themed;
+            glass_surf::ApplyTheme(blurred, theme, themed);
+            add(name, themed);
+        }
+
+        glass_surf::NoiseLayer noise;
+        noise.Prepare(0x6e6f6973, glass_surf::GetThemePreset(glass_surf::Themes::ACRYLIC).noise_amplitude, blurred.cols);
+        cv::Mat grained = blurred.clone();
+        noise.Composite(grained);
+        add("noise", grained);
+
+        const std::pair<glass_surf::SurfaceStorage, std::string> storages[] = {
+            { glass_surf::SurfaceStorage::FULL, "full" },
+            { glass_surf::SurfaceStorage::YCRCB420, "ycrcb420" },
+            { glass_surf::SurfaceStorage::HALF, "half" },
+        };
+        for (const auto& [storage, name] : storages) {
+            std::shared_ptr<glass_surf::Surface> surface = RenderSurface(wallpaper.image, kGoldenSize, storage);
+
+            glass_surf::SurfaceCropBuffers crop_buffers;
+            add("crop_" + name, surface->Crop(cv::Rect(120, 60, 320, 200), crop_buffers));
+            // A window partly off the screen
+            add("crop_" + name + "_clipped", surface->Crop(cv::Rect(-50, 250, 300, 200), crop_buffers));
+        }
+
+        return images;
+    }
+
+    int RunGolden(const std::filesystem::path& data_path, bool update) {
+        const std::filesystem::path golden_path = data_path / "golden";
+        Results results;
+        int missing = 0;
+
+        if (update) {
+            std::error_code error;
+            std::filesystem::create_directories(golden_path, error);
+        }
+
+        for (const Wallpaper& wallpaper : TestWallpapers(data_path)) {
+            for (const GoldenImage& image : RenderGoldenImages(wallpaper)) {
+                const std::string path = (golden_path / (image.name + ".png")).string();
+
+                if (update) {
+                    results.Check(cv::imwrite(path, image.image), "golden: writing " + path);
+                    continue;
+                }
+
+                cv::Mat golden = cv::imread(path, cv::IMREAD_COLOR);
+                if (golden.empty()) {
+                    results.Check(false, image.name + ": no golden image " + path);
+                    ++missing;
+                    continue;
+                }
+
+                if (golden.size() != image.image.size()) {
+                    results.Check(false, image.name + ": size " + std::to_string(image.image.cols) + "x"
+                        + std::to_string(image.image.rows) + " differs from the golden image");
+                    continue;
+                }
+
+                double max_difference, mean_difference;
+                Difference(image.image, golden, max_difference, mean_difference);
+                results.Check(max_difference <= kGoldenMaxDifference && mean_difference <= kGoldenMeanDifference,
+                    image.name + ": differs from the golden image (max " + std::to_string(max_difference)
+                    + ", mean " + std::to_string(mean_difference) + ")");
+            }
+        }
+
+        if (missing > 0) {
+            std::cout << "Record missing golden images with: GlassSurfTests update " << data_path.string() << std::endl;
+        }
+
+        return results.ExitCode();
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // time
+
+    constexpr int kTimedIterations = 5;
+
+    // Runs `body` once to warm up, then kTimedIterations times; returns the median in milliseconds
+    double MedianMilliseconds(const std::function<void()>& body) {
+        body();
+
+        std::vector<double> samples;
+        for (int i = 0; i < kTimedIterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto end = std::chrono::steady_clock::now();
+
+            samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    // Budgets in milliseconds at 1920x1080, scaled with the pixel count for other resolutions.
+    // Provisional: not yet measured with this binary. They are about twice medians taken on a
+    // single core of a Xeon VM from opencv-python for the OpenCV stages and from the loops in
+    // src/ at -O2 (in brackets, the 1920x1080 median). Replace them with twice the medians this
+    // suite prints in an optimized build before enabling GLASSSURF_REFERENCE_TESTS in CI.
+    struct TimeBudget {
+        const char* stage;
+        double milliseconds;
+    };
+
+    constexpr TimeBudget kTimeBudgets[] = {
+        { "resize", 15.0 },                  // (5.9)
+        { "tint", 25.0 },                    // (11.3)
+        { "blur", 600.0 },                   // (238; 3840x2160: 1210)
+        { "linear light tint+blur", 2100.0 }, // (1055)
+        { "theme", 40.0 },                   // (20.5, DARK)
+        { "noise", 15.0 },                   // (1.7; 3840x2160: 28)
+        { "pipeline", 700.0 },               // (288; 3840x2160: 1405)
+    };
+
+    // The /bg/ crop of a 1280x800 window, whatever the screen (61)
+    constexpr double kPngBudget = 120.0;
+
+    double TimeBudgetFor(const std::string& stage, const cv::Size& size, double scale) {
+        for (const TimeBudget& budget : kTimeBudgets) {
+            if (stage == budget.stage) {
+                return budget.milliseconds * scale * size.area() / (1920.0 * 1080.0);
+            }
+        }
+        return 0.0;
+    }
+
+    int RunTime() {
+    #ifndef NDEBUG
+        std::cout << "[SKIP]: Time budgets only apply to optimized builds" << std::endl;
+        return kSkipped;
+    #else
+        // For slow or shared CI machines
+        double scale = 1.0;
+        if (const char* scale_variable = std::getenv("GLASSSURF_TIME_BUDGET_SCALE")) {
+            scale = std::max(std::atof(scale_variable), 0.1);
+        }
+
+        Results results;
+        auto check = [&results](const std::string& stage, const cv::Size& size, double milliseconds, double budget) {
+            std::cout << std::left << std::setw(28) << stage
+                << std::setw(12) << (std::to_string(size.width) + "x" + std::to_string(size.height))
+                << std::right << std::fixed << std::setprecision(2) << std::setw(10) << milliseconds << " ms"
+                << std::setw(10) << budget << " ms budget" << std::endl;
+            results.Check(milliseconds <= budget, stage + " over its time budget");
+        };
+
+        const std::vector<cv::Size> resolutions = { cv::Size(1920, 1080), cv::Size(3840, 2160) };
+
+        for (const cv::Size& size : resolutions) {
+            // Wallpapers are usually larger than the screen
+            cv::Mat wallpaper = NoiseWallpaper(cv::Size(size.width * 3 / 2, size.height * 3 / 2));
+            cv::Mat resized, tinted, blurred, themed, surface;
+
+            check("resize", size, MedianMilliseconds([&] {
+                glass_surf::CompressImage(wallpaper, size.width, size.height, resized);
+            }), TimeBudgetFor("resize", size, scale));
+
+            check("tint", size, MedianMilliseconds([&] {
+                glass_surf::ApplyTintBlend(resized, kTint, tinted);
+            }), TimeBudgetFor("tint", size, scale));
+
+            check("blur", size, MedianMilliseconds([&] {
+                glass_surf::GausianBlur(tinted, kBlurRadius, blurred);
+            }), TimeBudgetFor("blur", size, scale));
+
+            cv::Mat linear, linear_tinted, linear_blurred;
+            check("linear light tint+blur", size, MedianMilliseconds([&] {
+                glass_surf::ToLinearLight(resized, linear);
+                glass_surf::ApplyTintBlendLinear(linear, kTint, linear_tinted);
+                glass_surf::GausianBlur(linear_tinted, kBlurRadius, linear_blurred);
+                glass_surf::FromLinearLight(linear_blurred, themed);
+            }), TimeBudgetFor("linear light tint+blur", size, scale));
+
+            check("theme", size, MedianMilliseconds([&] {
+                glass_surf::ApplyTheme(blurred, glass_surf::Themes::DARK, themed);
+            }), TimeBudgetFor("theme", size, scale));
+
+            glass_surf::NoiseLayer noise;
+            noise.Prepare(1, glass_surf::GetThemePreset(glass_surf::Themes::ACRYLIC).noise_amplitude, size.width);
+            check("noise", size, MedianMilliseconds([&] {
+                noise.Composite(themed);
+            }), TimeBudgetFor("noise", size, scale));
+
+            glass_surf::PipelineOptions options = TestPipelineOptions(size, glass_surf::SurfaceStorage::FULL);
+            glass_surf::PipelineBuffers buffers;
+            check("pipeline", size, MedianMilliseconds([&] {
+                glass_surf::RunPipeline(wallpaper, options, buffers, surface);
+            }), TimeBudgetFor("pipeline", size, scale));
+
+            std::string png;
+            cv::Mat window = surface(cv::Rect(0, 0, std::min(1280, size.width), std::min(800, size.height)));
+            check("png (1280x800 crop)", size, MedianMilliseconds([&] {
+                glass_surf::EncodePng(window, png);
+            }), kPngBudget * scale);
+        }
+
+        return results.ExitCode();
+    #endif
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // allocations
+
+    // Steady state (buffers already allocated by an earlier run of the same size): no
+    // image-sized cv::Mat, and only OpenCV's small per-call scratch (kernels, row buffers)
+    constexpr uint64_t kStageMatBytes = 64 * 1024;
+    constexpr uint64_t kStageAllocations = 64;
+
+    const char* const kPipelineStages[] = {
+        "pipeline.resize", "pipeline.tint", "pipeline.blur", "pipeline.to_linear", "pipeline.from_linear",
+        "pipeline.theme", "pipeline.noise",
+    };
+
+    void CheckPipelineAllocations(Results& results, bool linear_light) {
+        const cv::Size size(1920, 1080);
+        cv::Mat wallpaper = NoiseWallpaper(cv::Size(2560, 1440));
+
+        glass_surf::PipelineOptions options = TestPipelineOptions(size, glass_surf::SurfaceStorage::FULL);
+        options.linear_light = linear_light;
+
+        glass_surf::PipelineBuffers buffers;
+        cv::Mat surface;
+        glass_surf::RunPipeline(wallpaper, options, buffers, surface);
+        glass_surf::RunPipeline(wallpaper, options, buffers, surface);
+
+        // `last` is the second run of each stage
+        const std::string path = linear_light ? " (linear light)" : " (sRGB)";
+        for (const glass_surf::AllocationScopeStats& stats : glass_surf::AllocationScopeSnapshot()) {
+            const char* const* stage = std::find_if(std::begin(kPipelineStages), std::end(kPipelineStages),
+                [&stats](const char* name) { return std::string(name) == stats.name; });
+            if (stage == std::end(kPipelineStages)) {
+                continue;
+            }
+
+            std::cout << std::left << std::setw(24) << stats.name << path << ": " << stats.last.mat_bytes
+                << " Mat bytes, " << stats.last.total_allocations() << " allocations" << std::endl;
+            results.Check(stats.last.mat_bytes <= kStageMatBytes, std::string(stats.name) + path + ": allocates image buffers");
+            results.Check(stats.last.total_allocations() <= kStageAllocations,
+                std::string(stats.name) + path + ": over its allocation budget");
+        }
+    }
+
+    void CheckBackgroundCacheAllocations(Results& results, glass_surf::SurfaceStorage storage, const std::string& name) {
+        const cv::Size size(1920, 1080);
+
+        glass_surf::SurfaceSwapChain swap_chain(size, storage);
+        swap_chain.Publish(RenderSurface(NoiseWallpaper(cv::Size(2560, 1440)), size, storage));
+
+        glass_surf::BackgroundCache cache(swap_chain);
+
+        glass_surf::WindowGeometry window;
+        window.x = 200;
+        window.y = 100;
+        window.width = 1280;
+        window.height = 800;
+
+        glass_surf::WindowGeometry moved = window;
+        moved.x += 16;
+
+        // Warms up the encoder's per-thread state and sizes the body and entry buffers
+        std::string body;
+        cache.Get(window, body);
+        cache.Get(moved, body);
+
+        glass_surf::AllocationCounts miss;
+        {
+            glass_surf::AllocationScope scope;
+            cache.Get(window, body);
+            miss = scope.counts();
+        }
+
+        glass_surf::AllocationCounts hit;
+        {
+            glass_surf::AllocationScope scope;
+            cache.Get(window, body);
+            hit = scope.counts();
+        }
+
+        glass_surf::AllocationCounts state;
+        {
+            glass_surf::AllocationScope scope;
+            cache.IsStale(window);
+            cache.IsStale(moved);
+            state = scope.counts();
+        }
+
+        glass_surf::WindowGeometry hidden = moved;
+        hidden.visibility = glass_surf::WindowVisibility::MINIMIZED;
+        glass_surf::AllocationCounts invisible;
+        {
+            glass_surf::AllocationScope scope;
+            cache.Get(hidden, body);
+            invisible = scope.counts();
+        }
+
+        // FULL crops are views; compact storages convert into per-miss scratch, a few bytes per pixel
+        const uint64_t crop_pixels = static_cast<uint64_t>(window.width) * window.height;
+        const uint64_t miss_mat_bytes = storage == glass_surf::SurfaceStorage::FULL ? 0 : 12 * crop_pixels;
+
+        std::cout << "/bg/ " << name << ": miss " << miss.mat_bytes << " Mat bytes, " << miss.total_allocations()
+            << " allocations; hit " << hit.total_allocations() << "; /state/ " << state.total_allocations() << std::endl;
+
+        results.Check(miss.mat_bytes <= miss_mat_bytes, "/bg/ " + name + " miss: over its Mat budget");
+        results.Check(miss.allocations <= kStageAllocations && miss.bytes <= kStageMatBytes,
+            "/bg/ " + name + " miss: over its heap budget");
+        results.Check(hit.total_allocations() == 0, "/bg/ " + name + " hit: allocates");
+        results.Check(state.total_allocations() == 0, "/state/ " + name + ": allocates");
+        results.Check(invisible.total_allocations() == 0, "/bg/ " + name + " while hidden: allocates");
+    }
+
+    int RunAllocations() {
+        if (!glass_surf::AllocationCountingEnabled()) {
+            std::cout << "[SKIP]: Built without GLASSSURF_COUNT_ALLOCATIONS" << std::endl;
+            return kSkipped;
+        }
+
+        Results results;
+
+        CheckPipelineAllocations(results, false);
+        CheckPipelineAllocations(results, true);
+
+        CheckBackgroundCacheAllocations(results, glass_surf::SurfaceStorage::FULL, "FULL");
+        CheckBackgroundCacheAllocations(results, glass_surf::SurfaceStorage::YCRCB420, "YCRCB420");
+        CheckBackgroundCacheAllocations(results, glass_surf::SurfaceStorage::HALF, "HALF");
+
+        return results.ExitCode();
+    }
+
+} // namespace
+
+int main(int argc, char const* argv[]) {
+    // Before any cv::Mat exists
+    glass_surf::InstallMatAllocationHook();
+
+    if (argc != 3) {
+        std::cerr << "Usage: GlassSurfTests stages|golden|time|allocations|update <data dir>" << std::endl;
+        return 1;
+    }
+
+    const std::string suite = argv[1];
+    const std::filesystem::path data_path = argv[2];
+
+    if (suite == "stages") {
+        return RunStages();
+    }
+    if (suite == "golden") {
+        return RunGolden(data_path, false);
+    }
+    if (suite == "update") {
+        return RunGolden(data_path, true);
+    }
+    if (suite == "time") {
+        return RunTime();
+    }
+    if (suite == "allocations") {
+        return RunAllocations();
+    }
+
+    std::cerr << "[ERROR]: Unknown suite " << suite << std::endl;
+    return 1;
+}
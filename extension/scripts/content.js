@@ -1,48 +1,71 @@
 // content.js
 
 const DEFAULT_PORT = 3040;
+const STREAM_PORT = 3041;
 
-const GLASS_SURF_SERVER_STATE_URL = `http://localhost:${DEFAULT_PORT}/state/`;
-const GLASS_SURF_SERVER_BG_URL = `http://localhost:${DEFAULT_PORT}/bg/`;
+// Sites are matched by host name against the "profiles" of config.json;
+// the server uses its default settings for hosts without a profile
+const GLASS_SURF_PROFILE = `profile=${encodeURIComponent(location.hostname)}`;
+
+const GLASS_SURF_SERVER_STATE_URL = `http://localhost:${DEFAULT_PORT}/state/?${GLASS_SURF_PROFILE}`;
+const GLASS_SURF_SERVER_BG_URL = `http://localhost:${DEFAULT_PORT}/bg/?${GLASS_SURF_PROFILE}`;
+// Same image, streamed while it is encoded
+const GLASS_SURF_SERVER_BG_STREAM_URL = `http://localhost:${STREAM_PORT}/bg/?${GLASS_SURF_PROFILE}`;
 
 const GLASS_SURF_SERVER_LOAD_INTERVAL = 100;
+// Sent by the server instead while the browser window cannot be seen
+const GLASS_SURF_POLL_INTERVAL_HEADER = "X-GlassSurf-Poll-Interval";
 
 const body = document.body;
 body.style.backgroundAttachment = "fixed";
 
-let tmp_background_image_url;
+let background_request = 0;
+let next_poll_delay = GLASS_SURF_SERVER_LOAD_INTERVAL;
+let poll_timeout;
+
+// The image element loads the stream itself, so the browser decodes rows while
+// the server still encodes them; a blob would only exist after the last byte.
+// Every image gets a URL of its own, which the background then takes from the
+// browser's cache (the server allows caching /bg/ for a minute).
+function loadBackground(url) {
+  return new Promise((resolve, reject) => {
+    const img = new Image();
+    img.onload = () => resolve(url);
+    img.onerror = () => reject(new Error(`Could not load ${url}`));
+    img.src = url;
+  });
+}
 
 function updateBackground() {
-  fetch(GLASS_SURF_SERVER_STATE_URL, {
+  return fetch(GLASS_SURF_SERVER_STATE_URL, {
     method: 'GET',
   })
     .then((response) => {
       if (!response.ok) {
         throw new Error(`HTTP error! Status: ${response.status}`);
       }
+
+      const poll_interval = parseInt(response.headers.get(GLASS_SURF_POLL_INTERVAL_HEADER), 10);
+      next_poll_delay = isNaN(poll_interval) ? GLASS_SURF_SERVER_LOAD_INTERVAL : poll_interval;
+
       return response.text();
     })
     .then((state) => {
-      if (state === "1") {
-        if (tmp_background_image_url) {
-          URL.revokeObjectURL(tmp_background_image_url);
-        }
-
-        fetch(GLASS_SURF_SERVER_BG_URL)
-          .then((response) => response.blob())
-          .then((blob) => {
-            tmp_background_image_url = URL.createObjectURL(blob);
-
-            var img = new Image();
-            img.onload = function () {
-              body.style.backgroundImage = "url(" + tmp_background_image_url + ")";
-            };
-            img.src = tmp_background_image_url;
-          })
-          .catch((error) => {
-            console.error("Error fetching background image:", error);
-          });
+      if (state !== "1") {
+        return;
       }
+
+      const request = `&n=${Date.now()}-${++background_request}`;
+
+      // The next poll waits for the image, so an older one never replaces a newer one
+      return loadBackground(GLASS_SURF_SERVER_BG_STREAM_URL + request)
+        .catch(() => loadBackground(GLASS_SURF_SERVER_BG_URL + request))
+        .then((url) => {
+          body.style.backgroundImage = `url("${url}")`;
+        })
+        .catch((error) => {
+          console.error("Error fetching background image:", error);
+        });
     })
     .catch((error) => {
       console.error("Error checking server state:", error);
@@ -53,7 +76,22 @@ function clearConsole() {
   console.clear();
 }
 
-let loadBackgroundImageInterval = setInterval(updateBackground, GLASS_SURF_SERVER_LOAD_INTERVAL);
+// Polls again once the previous poll is done; a hidden tab shows no background,
+// so it does not poll until it is shown again
+function schedulePoll(delay) {
+  clearTimeout(poll_timeout);
+  poll_timeout = undefined;
+
+  if (!document.hidden) {
+    poll_timeout = setTimeout(() => {
+      updateBackground().finally(() => schedulePoll(next_poll_delay));
+    }, delay);
+  }
+}
+
+document.addEventListener("visibilitychange", () => schedulePoll(0));
+
+schedulePoll(0);
 let clearConsoleInterval = setInterval(clearConsole, 1000 * 3600);
 
 function appendStyleToBody(styleContent) {